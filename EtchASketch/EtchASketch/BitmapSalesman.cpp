@@ -0,0 +1,260 @@
+//
+//  BitmapSalesman.cpp
+//  EtchASketch
+//
+
+#include "BitmapSalesman.hpp"
+#include "EASUtils+Private.hpp"
+#include <algorithm>
+#include <initializer_list>
+#include <limits>
+
+using std::vector;
+using etchasketch::EdgeMask;
+using etchasketch::EdgePointBuffer;
+using etchasketch::KDPoint;
+using etchasketch::KDPointCoordinate;
+
+namespace {
+
+/**
+ * Make (@c x, @c y) the best point so far if it's closer to @c query than
+ * @c best, breaking ties with @c KDPoint::operator<().
+ */
+inline void
+considerPoint(size_t x, size_t y, const KDPoint<2> &query,
+			  KDPoint<2> &best, float &bestDist)
+{
+	const KDPoint<2> candidate(static_cast<KDPointCoordinate>(x),
+							   static_cast<KDPointCoordinate>(y));
+	const float dist = query.distanceTo(candidate);
+	if ((dist < bestDist) || ((dist == bestDist) && (candidate < best))) {
+		best = candidate;
+		bestDist = dist;
+	}
+}
+
+/// The distance from @c value to the range [@c first, @c last].
+inline float
+distanceToRange(size_t value, size_t first, size_t last)
+{
+	if (value < first) {
+		return static_cast<float>(first - value);
+	} else if (value > last) {
+		return static_cast<float>(value - last);
+	}
+	return 0.0f;
+}
+
+}
+
+namespace etchasketch {
+namespace salesman {
+
+BitmapSalesman::BitmapSalesman(const EdgePointBuffer &unorderedPoints,
+							   const KDPoint<2> &startPoint)
+	: Salesman(), startPoint(startPoint), unorderedPoints(unorderedPoints)
+{
+}
+
+BitmapSalesman::~BitmapSalesman()
+{
+}
+
+void
+BitmapSalesman::orderPoints()
+{
+	if (!unorderedPoints.contains(startPoint[0], startPoint[1])) {
+		EASLog("Error: unorderedPoints does not contain the starting point");
+		exit(1);
+	}
+	buildLevels();
+	orderedPoints.reserve(unorderedPoints.size());
+	orderedPoints.push_back(startPoint);
+	markVisited(startPoint[0], startPoint[1]);
+
+	KDPoint<2> currPoint;
+	while (findNearestUnvisited(orderedPoints.back()[0],
+								orderedPoints.back()[1], currPoint)) {
+		orderedPoints.push_back(currPoint);
+		markVisited(currPoint[0], currPoint[1]);
+	}
+	// The bitmaps are only needed while ordering.
+	levels.clear();
+}
+
+#pragma mark - Pyramid
+
+void
+BitmapSalesman::buildLevels()
+{
+	levels.clear();
+	levels.push_back(unorderedPoints.copyAsMask());
+	size_t width = levels[0].getWidth(), height = levels[0].getHeight();
+
+	// Halve each level until there's just one bit left.
+	while ((width > 1) || (height > 1)) {
+		const EdgeMask &finer = levels.back();
+		EdgeMask coarser((width + 1) / 2, (height + 1) / 2);
+		for (size_t y = 0; y < height; y++) {
+			const EdgeMask::Word *row = finer.getRow(y);
+			for (size_t wordIndex = 0; wordIndex < finer.getWordsPerRow(); wordIndex++) {
+				// Visit each set bit.
+				EdgeMask::Word word = row[wordIndex];
+				while (0 != word) {
+					const size_t x = wordIndex * EdgeMask::bitsPerWord
+									 + static_cast<size_t>(__builtin_ctzll(word));
+					coarser.set(x / 2, y / 2);
+					word &= word - 1;
+				}
+			}
+		}
+		width = coarser.getWidth();
+		height = coarser.getHeight();
+		levels.push_back(std::move(coarser));
+	}
+}
+
+void
+BitmapSalesman::markVisited(size_t x, size_t y)
+{
+	levels[0].set(x, y, false);
+	// Clear each block up the pyramid that this leaves empty.
+	for (size_t level = 0; level + 1 < levels.size(); level++) {
+		const EdgeMask &mask = levels[level];
+		const size_t left = x & ~static_cast<size_t>(1);
+		const size_t top = y & ~static_cast<size_t>(1);
+		bool isEmpty = !mask.get(left, top) && !mask.get(left + 1, top);
+		if (isEmpty && (top + 1 < mask.getHeight())) {
+			isEmpty = !mask.get(left, top + 1) && !mask.get(left + 1, top + 1);
+		}
+		if (!isEmpty) {
+			return;
+		}
+		x /= 2;
+		y /= 2;
+		levels[level + 1].set(x, y, false);
+	}
+}
+
+#pragma mark - Search
+
+bool
+BitmapSalesman::findNearestUnvisited(size_t x, size_t y,
+									 KDPoint<2> &nearest) const
+{
+	if (!levels.back().get(0, 0)) {
+		// Everything has been visited.
+		return false;
+	}
+	const EdgeMask &pixels = levels[0];
+	const KDPoint<2> query(static_cast<KDPointCoordinate>(x),
+						   static_cast<KDPointCoordinate>(y));
+	KDPoint<2> best;
+	float bestDist = std::numeric_limits<float>::infinity();
+
+	// Spiral out a few rings. Every pixel in ring r is at least r away, so
+	// once that's farther than the best so far, nothing else can beat it.
+	const ptrdiff_t queryX = static_cast<ptrdiff_t>(x);
+	const ptrdiff_t queryY = static_cast<ptrdiff_t>(y);
+	const ptrdiff_t lastX = static_cast<ptrdiff_t>(pixels.getWidth()) - 1;
+	const ptrdiff_t lastY = static_cast<ptrdiff_t>(pixels.getHeight()) - 1;
+	for (ptrdiff_t ring = 0; ring <= static_cast<ptrdiff_t>(spiralRadius); ring++) {
+		if (static_cast<float>(ring * ring) > bestDist) {
+			break;
+		}
+		const ptrdiff_t left = std::max(queryX - ring, static_cast<ptrdiff_t>(0));
+		const ptrdiff_t right = std::min(queryX + ring, lastX);
+		const ptrdiff_t top = std::max(queryY - ring + 1, static_cast<ptrdiff_t>(0));
+		const ptrdiff_t bottom = std::min(queryY + ring - 1, lastY);
+		// The top and bottom edges of the ring, corners included.
+		for (ptrdiff_t ringY : { queryY - ring, queryY + ring }) {
+			if ((ringY >= 0) && (ringY <= lastY)) {
+				for (ptrdiff_t ringX = left; ringX <= right; ringX++) {
+					if (pixels.get(ringX, ringY)) {
+						considerPoint(ringX, ringY, query, best, bestDist);
+					}
+				}
+			}
+			if (0 == ring) {
+				break;
+			}
+		}
+		// The left and right edges, between the corners.
+		for (ptrdiff_t ringX : { queryX - ring, queryX + ring }) {
+			if ((ring > 0) && (ringX >= 0) && (ringX <= lastX)) {
+				for (ptrdiff_t ringY = top; ringY <= bottom; ringY++) {
+					if (pixels.get(ringX, ringY)) {
+						considerPoint(ringX, ringY, query, best, bestDist);
+					}
+				}
+			}
+		}
+	}
+
+	// If the spiral didn't settle it, search the pyramid from the top.
+	const float nextRing = static_cast<float>(spiralRadius + 1);
+	if (!(bestDist < nextRing * nextRing)) {
+		searchBlock(levels.size() - 1, 0, 0, query, best, bestDist);
+	}
+	nearest = best;
+	return true;
+}
+
+void
+BitmapSalesman::searchBlock(size_t level, size_t blockX, size_t blockY,
+							const KDPoint<2> &query,
+							KDPoint<2> &best, // inout
+							float &bestDist) const // inout
+{
+	if (!levels[level].get(blockX, blockY)) {
+		return;
+	}
+	if (0 == level) {
+		considerPoint(blockX, blockY, query, best, bestDist);
+		return;
+	}
+
+	// Visit the unvisited children closest first, skipping any that are
+	// farther than the best so far. Ties still have to be checked.
+	const EdgeMask &children = levels[level - 1];
+	const size_t childSize = static_cast<size_t>(1) << (level - 1);
+	const size_t pixelWidth = levels[0].getWidth();
+	const size_t pixelHeight = levels[0].getHeight();
+	size_t childXs[4], childYs[4];
+	float childDists[4];
+	size_t childCount = 0;
+	for (size_t childY = 2 * blockY; childY < std::min(2 * blockY + 2, children.getHeight()); childY++) {
+		for (size_t childX = 2 * blockX; childX < std::min(2 * blockX + 2, children.getWidth()); childX++) {
+			if (!children.get(childX, childY)) {
+				continue;
+			}
+			const size_t left = childX * childSize;
+			const size_t top = childY * childSize;
+			const size_t right = std::min(left + childSize, pixelWidth) - 1;
+			const size_t bottom = std::min(top + childSize, pixelHeight) - 1;
+			const float dx = distanceToRange(query[0], left, right);
+			const float dy = distanceToRange(query[1], top, bottom);
+			// Insertion sort by distance.
+			size_t i = childCount++;
+			for (; (i > 0) && (childDists[i - 1] > dx * dx + dy * dy); i--) {
+				childXs[i] = childXs[i - 1];
+				childYs[i] = childYs[i - 1];
+				childDists[i] = childDists[i - 1];
+			}
+			childXs[i] = childX;
+			childYs[i] = childY;
+			childDists[i] = dx * dx + dy * dy;
+		}
+	}
+	for (size_t i = 0; i < childCount; i++) {
+		if (childDists[i] > bestDist) {
+			// The rest are farther still.
+			break;
+		}
+		searchBlock(level - 1, childXs[i], childYs[i], query, best, bestDist);
+	}
+}
+
+}
+}
@@ -0,0 +1,90 @@
+//
+//  BitmapSalesman.hpp
+//  EtchASketch
+//
+
+#ifndef BitmapSalesman_hpp
+#define BitmapSalesman_hpp
+
+#include <stddef.h>
+#include <vector>
+#include "Salesman.hpp"
+#include "EdgeMask.hpp"
+#include "EdgePointBuffer.hpp"
+#include "KDPoint.hpp"
+
+namespace etchasketch {
+namespace salesman {
+
+/**
+ * Walks the same greedy nearest neighbor tour as @c NearestNeighborSalesman,
+ * but straight off a bitmap of the unvisited pixels instead of a spatial
+ * index.
+ *
+ * Drawing a pixel clears its bit. The next pixel is usually right next to
+ * the current one, so the search starts with a spiral of a few rings around
+ * it. When that doesn't settle it, the search falls back to a pyramid of
+ * coarser bitmaps, where each bit says whether any pixel in a 2x2 block of
+ * the level below is unvisited, and descends through it toward the closest
+ * blocks that still have something in them. All told, that's about 1.33
+ * bits per pixel, with nothing to build beyond the bitmaps.
+ */
+class BitmapSalesman : public Salesman {
+  public:
+	/**
+	 * The startPoint must be contained within the unorderedPoints, which
+	 * must outlive the salesman.
+	 */
+	BitmapSalesman(const EdgePointBuffer &unorderedPoints,
+				   const KDPoint<2> &startPoint);
+
+	virtual ~BitmapSalesman();
+
+	/// Order the points for the best drawing order.
+	virtual void orderPoints();
+
+  private:
+	/// The point at which we begin drawing.
+	const KDPoint<2> startPoint;
+
+	/// The points to put in order.
+	const EdgePointBuffer &unorderedPoints;
+
+	/**
+	 * The unvisited pixels, finest first. Bit (x, y) of level k is set if
+	 * any of the pixels under it in level 0 is unvisited, so the last level
+	 * is a single bit.
+	 */
+	std::vector<EdgeMask> levels;
+
+	/// The most rings the pixel-level spiral checks before using the pyramid.
+	static constexpr size_t spiralRadius = 3;
+
+	/// Build the pyramid with every point unvisited.
+	void buildLevels();
+
+	/// Mark a pixel visited, clearing any blocks it leaves empty.
+	void markVisited(size_t x, size_t y);
+
+	/**
+	 * Find the closest unvisited pixel to (@c x, @c y), breaking ties with
+	 * @c KDPoint::operator<().
+	 *
+	 * @return @c false if every pixel has been visited.
+	 */
+	bool findNearestUnvisited(size_t x, size_t y, KDPoint<2> &nearest) const;
+
+	/**
+	 * Search the block at (@c blockX, @c blockY) of @c level, and the
+	 * blocks under it, for an unvisited pixel closer than @c best.
+	 */
+	void searchBlock(size_t level, size_t blockX, size_t blockY,
+					 const KDPoint<2> &query,
+					 KDPoint<2> &best, // inout
+					 float &bestDist) const; // inout
+};
+
+}
+}
+
+#endif /* BitmapSalesman_hpp */
@@ -7,81 +7,582 @@
 //
 
 #include "BlurImageFilter.hpp"
-#include <math.h>
+#include "PixelTraversal.hpp"
+#include "SIMDSupport.hpp"
+#include <algorithm>
+#include <cmath>
+#include <string.h>
 
-using etchasketch::Image;
-using Pixel = etchasketch::Image::Pixel;
+using std::vector;
+using etchasketch::GrayImage;
+using etchasketch::edgedetect::RowFilter;
+using etchasketch::edgedetect::BlurMode;
+using Pixel = etchasketch::GrayImage::Pixel;
+using etchasketch::traversal::forEachRow;
+using etchasketch::traversal::forEachRowBand;
 
-etchasketch::edgedetect::BlurImageFilter::BlurImageFilter()
-: etchasketch::edgedetect::ImageFilter()
+/// Box radii are capped so a column of box sums fits in a uint16_t.
+static const uint32_t maxBoxRadius = 127;
+
+#pragma mark - Gaussian kernels
+
+/// Convert a row of 8-bit pixels to float.
+static void
+widenRow(const Pixel *src, float *dst, size_t count)
+{
+	size_t i = 0;
+#if EAS_HAVE_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	for (; i + 16 <= count; i += 16) {
+		const __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+		const __m128i low = _mm_unpacklo_epi8(px, zero);
+		const __m128i high = _mm_unpackhi_epi8(px, zero);
+		_mm_storeu_ps(dst + i,      _mm_cvtepi32_ps(_mm_unpacklo_epi16(low, zero)));
+		_mm_storeu_ps(dst + i + 4,  _mm_cvtepi32_ps(_mm_unpackhi_epi16(low, zero)));
+		_mm_storeu_ps(dst + i + 8,  _mm_cvtepi32_ps(_mm_unpacklo_epi16(high, zero)));
+		_mm_storeu_ps(dst + i + 12, _mm_cvtepi32_ps(_mm_unpackhi_epi16(high, zero)));
+	}
+#elif EAS_HAVE_NEON
+	for (; i + 8 <= count; i += 8) {
+		const uint16x8_t px = vmovl_u8(vld1_u8(src + i));
+		vst1q_f32(dst + i,     vcvtq_f32_u32(vmovl_u16(vget_low_u16(px))));
+		vst1q_f32(dst + i + 4, vcvtq_f32_u32(vmovl_u16(vget_high_u16(px))));
+	}
+#endif
+	for (; i < count; i++) {
+		dst[i] = static_cast<float>(src[i]);
+	}
+}
+
+/**
+ * Convolve a row with the kernel. Reads @c count + @c kernelSize - 1 values
+ * from @c src and writes @c count to @c dst.
+ */
+static void
+blurRowHorizontally(const float *src, float *dst, size_t count,
+					const float *kernel, size_t kernelSize)
+{
+	size_t i = 0;
+#if EAS_HAVE_SSE2
+	for (; i + 4 <= count; i += 4) {
+		__m128 sum = _mm_setzero_ps();
+		for (size_t k = 0; k < kernelSize; k++) {
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(src + i + k),
+											 _mm_set1_ps(kernel[k])));
+		}
+		_mm_storeu_ps(dst + i, sum);
+	}
+#elif EAS_HAVE_NEON
+	for (; i + 4 <= count; i += 4) {
+		float32x4_t sum = vdupq_n_f32(0.0f);
+		for (size_t k = 0; k < kernelSize; k++) {
+			sum = vmlaq_n_f32(sum, vld1q_f32(src + i + k), kernel[k]);
+		}
+		vst1q_f32(dst + i, sum);
+	}
+#endif
+	for (; i < count; i++) {
+		float sum = 0.0f;
+		for (size_t k = 0; k < kernelSize; k++) {
+			sum += src[i + k] * kernel[k];
+		}
+		dst[i] = sum;
+	}
+}
+
+/**
+ * Convolve a column of @c kernelSize horizontally blurred rows with the
+ * kernel, producing one row of output pixels.
+ */
+static void
+blurRowsVertically(const float * const *rows, Pixel *dst, size_t count,
+				   const float *kernel, size_t kernelSize)
+{
+	size_t i = 0;
+#if EAS_HAVE_SSE2
+	for (; i + 16 <= count; i += 16) {
+		__m128i sums[4];
+		for (size_t j = 0; j < 4; j++) {
+			__m128 sum = _mm_setzero_ps();
+			for (size_t k = 0; k < kernelSize; k++) {
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(rows[k] + i + 4 * j),
+												 _mm_set1_ps(kernel[k])));
+			}
+			// Truncate, like the scalar cast.
+			sums[j] = _mm_cvttps_epi32(sum);
+		}
+		const __m128i bytes = _mm_packus_epi16(_mm_packs_epi32(sums[0], sums[1]),
+											   _mm_packs_epi32(sums[2], sums[3]));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), bytes);
+	}
+#elif EAS_HAVE_NEON
+	for (; i + 8 <= count; i += 8) {
+		uint32x4_t sums[2];
+		for (size_t j = 0; j < 2; j++) {
+			float32x4_t sum = vdupq_n_f32(0.0f);
+			for (size_t k = 0; k < kernelSize; k++) {
+				sum = vmlaq_n_f32(sum, vld1q_f32(rows[k] + i + 4 * j), kernel[k]);
+			}
+			sums[j] = vcvtq_u32_f32(sum);
+		}
+		const uint16x8_t words = vcombine_u16(vqmovn_u32(sums[0]),
+											  vqmovn_u32(sums[1]));
+		vst1_u8(dst + i, vqmovn_u16(words));
+	}
+#endif
+	for (; i < count; i++) {
+		float sum = 0.0f;
+		for (size_t k = 0; k < kernelSize; k++) {
+			sum += rows[k][i] * kernel[k];
+		}
+		dst[i] = static_cast<Pixel>(std::min(sum, 255.0f));
+	}
+}
+
+#pragma mark - Box kernels
+
+/*
+ * A box of n pixels sums to at most 255 * n, which, with the rounding term
+ * added, fits in a uint16_t for n <= 255. The average is rounded by dividing
+ * (sum + n/2) by n, which is done as a multiply by m, the reciprocal of n in
+ * 0.16 fixed point. m is rounded up, so for boxes wider than 16 the quotient
+ * can come out one too high; multiplying it back by n catches that. Both
+ * paths do the same, so they agree exactly with each other and with a true
+ * rounded division.
+ */
+
+/// The 0.16 fixed-point reciprocal of a box's width, rounded up.
+static inline uint16_t
+boxReciprocal(size_t boxWidth)
+{
+	return static_cast<uint16_t>((65536 + boxWidth - 1) / boxWidth);
+}
+
+/// The rounded average of a box sum.
+static inline Pixel
+boxAverage(uint32_t sum, size_t boxWidth, uint16_t reciprocal)
+{
+	const uint32_t rounded = sum + boxWidth / 2;
+	uint32_t average = (rounded * reciprocal) >> 16;
+	if (average * boxWidth > rounded) {
+		average--;
+	}
+	return static_cast<Pixel>(average);
+}
+
+/// Box blur along a row. @c dst is 2*radius narrower than @c src.
+static void
+boxBlurRow(const Pixel *src, Pixel *dst, size_t count, size_t boxWidth,
+		   uint16_t reciprocal)
+{
+	uint32_t sum = 0;
+	for (size_t x = 0; x < boxWidth; x++) {
+		sum += src[x];
+	}
+	dst[0] = boxAverage(sum, boxWidth, reciprocal);
+	// Slide the box along the row.
+	for (size_t x = 1; x < count; x++) {
+		sum += src[x + boxWidth - 1];
+		sum -= src[x - 1];
+		dst[x] = boxAverage(sum, boxWidth, reciprocal);
+	}
+}
+
+/// Add a row of pixels into a row of column sums.
+static void
+addRowToSums(const Pixel *row, uint16_t *sums, size_t count)
+{
+	size_t x = 0;
+#if EAS_HAVE_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	for (; x + 8 <= count; x += 8) {
+		const __m128i px = _mm_unpacklo_epi8(
+			_mm_loadl_epi64(reinterpret_cast<const __m128i *>(row + x)), zero);
+		__m128i *sum = reinterpret_cast<__m128i *>(sums + x);
+		_mm_storeu_si128(sum, _mm_add_epi16(_mm_loadu_si128(sum), px));
+	}
+#elif EAS_HAVE_NEON
+	for (; x + 8 <= count; x += 8) {
+		vst1q_u16(sums + x, vaddw_u8(vld1q_u16(sums + x), vld1_u8(row + x)));
+	}
+#endif
+	for (; x < count; x++) {
+		sums[x] = static_cast<uint16_t>(sums[x] + row[x]);
+	}
+}
+
+/// Subtract a row of pixels from a row of column sums.
+static void
+subtractRowFromSums(const Pixel *row, uint16_t *sums, size_t count)
+{
+	size_t x = 0;
+#if EAS_HAVE_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	for (; x + 8 <= count; x += 8) {
+		const __m128i px = _mm_unpacklo_epi8(
+			_mm_loadl_epi64(reinterpret_cast<const __m128i *>(row + x)), zero);
+		__m128i *sum = reinterpret_cast<__m128i *>(sums + x);
+		_mm_storeu_si128(sum, _mm_sub_epi16(_mm_loadu_si128(sum), px));
+	}
+#elif EAS_HAVE_NEON
+	for (; x + 8 <= count; x += 8) {
+		vst1q_u16(sums + x, vsubw_u8(vld1q_u16(sums + x), vld1_u8(row + x)));
+	}
+#endif
+	for (; x < count; x++) {
+		sums[x] = static_cast<uint16_t>(sums[x] - row[x]);
+	}
+}
+
+/// Turn a row of column sums into a row of box averages.
+static void
+averageSums(const uint16_t *sums, Pixel *dst, size_t count, size_t boxWidth,
+			uint16_t reciprocal)
+{
+	size_t x = 0;
+#if EAS_HAVE_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i half = _mm_set1_epi16(static_cast<int16_t>(boxWidth / 2));
+	const __m128i scale = _mm_set1_epi16(static_cast<int16_t>(reciprocal));
+	const __m128i width = _mm_set1_epi16(static_cast<int16_t>(boxWidth));
+	// SSE2 only compares signed words, so flip the sign bits to compare
+	// unsigned ones.
+	const __m128i signBit = _mm_set1_epi16(static_cast<int16_t>(0x8000));
+	for (; x + 8 <= count; x += 8) {
+		const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(sums + x));
+		const __m128i rounded = _mm_add_epi16(s, half);
+		__m128i average = _mm_mulhi_epu16(rounded, scale);
+		// All ones, or -1, wherever the quotient came out one too high.
+		const __m128i isTooHigh = _mm_cmpgt_epi16(
+			_mm_xor_si128(_mm_mullo_epi16(average, width), signBit),
+			_mm_xor_si128(rounded, signBit));
+		average = _mm_add_epi16(average, isTooHigh);
+		_mm_storel_epi64(reinterpret_cast<__m128i *>(dst + x),
+						 _mm_packus_epi16(average, zero));
+	}
+#elif EAS_HAVE_NEON
+	const uint16x8_t half = vdupq_n_u16(static_cast<uint16_t>(boxWidth / 2));
+	for (; x + 8 <= count; x += 8) {
+		const uint16x8_t rounded = vaddq_u16(vld1q_u16(sums + x), half);
+		uint16x8_t average = vcombine_u16(
+			vshrn_n_u32(vmull_n_u16(vget_low_u16(rounded), reciprocal), 16),
+			vshrn_n_u32(vmull_n_u16(vget_high_u16(rounded), reciprocal), 16));
+		// All ones, or -1, wherever the quotient came out one too high.
+		const uint16x8_t isTooHigh = vcgtq_u16(
+			vmulq_n_u16(average, static_cast<uint16_t>(boxWidth)), rounded);
+		average = vaddq_u16(average, isTooHigh);
+		vst1_u8(dst + x, vqmovn_u16(average));
+	}
+#endif
+	for (; x < count; x++) {
+		dst[x] = boxAverage(sums[x], boxWidth, reciprocal);
+	}
+}
+
+#pragma mark - Row filters
+
+namespace {
+
+/**
+ * Streams rows through the separable Gaussian. Horizontally blurred rows are
+ * kept in a ring of kernelSize rows, so each one is computed once and the
+ * vertical pass reads straight from cache.
+ */
+class GaussianRowFilter : public etchasketch::edgedetect::RowFilter {
+public:
+	GaussianRowFilter(size_t width, const vector<float> &kernel)
+	: kernel(kernel),
+	  outputWidth((width > kernel.size() - 1) ? (width - (kernel.size() - 1)) : 0),
+	  widened(width), ring(kernel.size() * outputWidth),
+	  window(kernel.size()), output(outputWidth), rowCount(0)
+	{ }
+
+	virtual size_t getOutputWidth() const
+		{ return outputWidth; }
+
+	virtual size_t getWindowHeight() const
+		{ return kernel.size(); }
+
+	virtual const Pixel *pushRow(const Pixel *row)
+	{
+		const size_t kernelSize = kernel.size();
+		if (0 == outputWidth) {
+			return nullptr;
+		}
+		widenRow(row, widened.data(), widened.size());
+		blurRowHorizontally(widened.data(),
+							&ring[(rowCount % kernelSize) * outputWidth],
+							outputWidth, kernel.data(), kernelSize);
+		rowCount++;
+		if (rowCount < kernelSize) {
+			return nullptr;
+		}
+		// The oldest row in the ring is the next one to be overwritten.
+		for (size_t k = 0; k < kernelSize; k++) {
+			window[k] = &ring[((rowCount + k) % kernelSize) * outputWidth];
+		}
+		blurRowsVertically(window.data(), output.data(), outputWidth,
+						   kernel.data(), kernelSize);
+		return output.data();
+	}
+
+private:
+	const vector<float> &kernel;
+
+	size_t outputWidth;
+
+	/// The current input row, converted to float.
+	vector<float> widened;
+
+	/// The last kernelSize horizontally blurred rows.
+	vector<float> ring;
+
+	/// The rows of @c ring, oldest first.
+	vector<const float *> window;
+
+	vector<Pixel> output;
+
+	/// The number of rows pushed in so far.
+	size_t rowCount;
+};
+
+/**
+ * Streams rows through a single box blur, keeping the last boxWidth
+ * horizontally blurred rows and a running sum down each column of them.
+ *
+ * A box of n pixels sums to at most 255 * n, so with the radius capped the
+ * column sums fit in a uint16_t. They're exact, so the result doesn't depend
+ * on where in the image streaming started.
+ */
+class BoxRowFilter : public etchasketch::edgedetect::RowFilter {
+public:
+	BoxRowFilter(size_t width, size_t radius)
+	: boxWidth(2 * radius + 1), reciprocal(boxReciprocal(boxWidth)),
+	  outputWidth((width > 2 * radius) ? (width - 2 * radius) : 0),
+	  ring(boxWidth * outputWidth), sums(outputWidth, 0),
+	  output(outputWidth), rowCount(0)
+	{ }
+
+	virtual size_t getOutputWidth() const
+		{ return outputWidth; }
+
+	virtual size_t getWindowHeight() const
+		{ return boxWidth; }
+
+	virtual const Pixel *pushRow(const Pixel *row)
+	{
+		if (0 == outputWidth) {
+			return nullptr;
+		}
+		Pixel *entering = &ring[(rowCount % boxWidth) * outputWidth];
+		boxBlurRow(row, entering, outputWidth, boxWidth, reciprocal);
+		addRowToSums(entering, sums.data(), outputWidth);
+		rowCount++;
+		if (rowCount < boxWidth) {
+			return nullptr;
+		}
+		averageSums(sums.data(), output.data(), outputWidth, boxWidth,
+					reciprocal);
+		// Drop the oldest row, which the next row pushed in replaces.
+		subtractRowFromSums(&ring[(rowCount % boxWidth) * outputWidth],
+							sums.data(), outputWidth);
+		return output.data();
+	}
+
+private:
+	size_t boxWidth;
+
+	/// The 0.16 fixed-point reciprocal of @c boxWidth.
+	uint16_t reciprocal;
+
+	size_t outputWidth;
+
+	/// The last boxWidth horizontally blurred rows.
+	vector<Pixel> ring;
+
+	/// The sum of each column of @c ring.
+	vector<uint16_t> sums;
+
+	vector<Pixel> output;
+
+	/// The number of rows pushed in so far.
+	size_t rowCount;
+};
+
+/**
+ * Streams rows through a series of row filters, one after another. With no
+ * stages, rows pass straight through.
+ */
+class RowFilterChain : public etchasketch::edgedetect::RowFilter {
+public:
+	RowFilterChain(size_t width)
+	: inputWidth(width)
+	{ }
+
+	virtual ~RowFilterChain()
+	{
+		for (RowFilter *stage : stages) {
+			delete stage;
+		}
+	}
+
+	/// Add a stage to the end of the chain, taking ownership of it.
+	void addStage(RowFilter *stage)
+		{ stages.push_back(stage); }
+
+	virtual size_t getOutputWidth() const
+		{ return stages.empty() ? inputWidth : stages.back()->getOutputWidth(); }
+
+	virtual size_t getWindowHeight() const
+	{
+		size_t windowHeight = 1;
+		for (const RowFilter *stage : stages) {
+			windowHeight += stage->getWindowHeight() - 1;
+		}
+		return windowHeight;
+	}
+
+	virtual const Pixel *pushRow(const Pixel *row)
+	{
+		for (RowFilter *stage : stages) {
+			row = stage->pushRow(row);
+			if (nullptr == row) {
+				return nullptr;
+			}
+		}
+		return row;
+	}
+
+private:
+	size_t inputWidth;
+
+	vector<RowFilter *> stages;
+};
+
+}
+
+#pragma mark -
+
+etchasketch::edgedetect::BlurImageFilter::BlurImageFilter(float sigma,
+														  uint32_t radius,
+														  BlurMode mode)
+: etchasketch::edgedetect::ImageFilter(),
+  sigma(sigma), mode(mode), radius(radius)
 {
 	// Precompute our kernel.
 	initKernel();
+	initBoxes();
+}
+
+uint32_t
+etchasketch::edgedetect::BlurImageFilter::radiusForSigma(float sigma)
+{
+	return static_cast<uint32_t>(ceil(4.0f * sigma));
+}
+
+uint32_t
+etchasketch::edgedetect::BlurImageFilter::getRadius() const
+{
+	if (BlurMode::TripleBox == mode) {
+		return boxRadii[0] + boxRadii[1] + boxRadii[2];
+	}
+	return radius;
 }
 
 void
 etchasketch::edgedetect::BlurImageFilter::initKernel()
 {
 	// Based on http://stackoverflow.com/questions/8204645/implementing-gaussian-blur-how-to-calculate-convolution-matrix-kernel
-	float sigma = 1.0f;
-	float mean = kernelSize / 2;
+	// The 2-D Gaussian is the outer product of two of these.
+	const uint32_t kernelSize = 2*radius + 1;
+	const float mean = kernelSize / 2;
 	float sum = 0.0f; // For accumulating the kernel values
-	for (uint32_t x = 0; x < kernelSize; x++)
-		for (uint32_t y = 0; y < kernelSize; y++) {
-			kernel[x][y] = (float)( exp( -0.5 * (pow((x-mean)/sigma, 2.0) + pow((y-mean)/sigma,2.0)) )
-			/ (2 * M_PI * sigma * sigma) );
-			
-			// Accumulate the kernel values
-			sum += kernel[x][y];
-		}
-	
+	kernel.resize(kernelSize);
+	for (uint32_t x = 0; x < kernelSize; x++) {
+		kernel[x] = static_cast<float>(exp(-0.5 * pow((x-mean)/sigma, 2.0)));
+		sum += kernel[x];
+	}
+
 	// Normalize the kernel
 	for (uint32_t x = 0; x < kernelSize; x++) {
-		for (uint32_t y = 0; y < kernelSize; y++) {
-			kernel[x][y] /= sum;
-		}
+		kernel[x] /= sum;
 	}
 }
 
-Image *
-etchasketch::edgedetect::BlurImageFilter::apply(const Image &originalImage) const
+void
+etchasketch::edgedetect::BlurImageFilter::initBoxes()
 {
-	// Create the image into which we'll write our blurred image.
-	Image *blurredImage = new Image(originalImage.getWidth() - 2*radius,
-									originalImage.getHeight() - 2*radius);
-	
-	// Blur each pixel.
-	for (int x = radius; x < originalImage.getWidth() - radius; x++) {
-		for (int y = radius; y < originalImage.getHeight() - radius; y++) {
-			const KDPoint<2> destPt(x - radius, y - radius);
-			(*blurredImage)[destPt] = blurredPixel(originalImage, x, y);
-		}
+	// Pick three box widths whose combined variance best matches sigma^2.
+	// See Kovesi, "Fast Almost-Gaussian Filtering" (2010).
+	const double boxCount = 3.0;
+	const double variance = static_cast<double>(sigma) * sigma;
+	const double idealWidth = sqrt(12.0 * variance / boxCount + 1.0);
+	int lowerWidth = static_cast<int>(floor(idealWidth));
+	if (lowerWidth % 2 == 0) {
+		lowerWidth--;
+	}
+	lowerWidth = std::max(lowerWidth, 1);
+	const int upperWidth = lowerWidth + 2;
+	const double idealLowerCount = (12.0 * variance
+									- boxCount * lowerWidth * lowerWidth
+									- 4.0 * boxCount * lowerWidth
+									- 3.0 * boxCount)
+								   / (-4.0 * lowerWidth - 4.0);
+	const int lowerCount = static_cast<int>(round(idealLowerCount));
+	for (int i = 0; i < 3; i++) {
+		const int width = (i < lowerCount) ? lowerWidth : upperWidth;
+		boxRadii[i] = std::min(static_cast<uint32_t>(width / 2), maxBoxRadius);
+	}
+}
+
+GrayImage *
+etchasketch::edgedetect::BlurImageFilter::apply(const GrayImage &originalImage) const
+{
+	const size_t inset = 2 * getRadius();
+	if (originalImage.getWidth() <= inset || originalImage.getHeight() <= inset) {
+		// There's no pixel with a whole neighborhood inside the image.
+		return new GrayImage(0, 0);
 	}
-	
+
+	// Create the image into which we'll write our blurred image.
+	GrayImage *blurredImage = new GrayImage(originalImage.getWidth() - inset,
+											originalImage.getHeight() - inset);
+	const size_t width = blurredImage->getWidth();
+
+	// Stream each band through its own row filter, starting with the halo of
+	// rows above its first output row.
+	forEachRowBand(threadPool, 0, blurredImage->getHeight(),
+				   [&](size_t firstRow, size_t lastRow) {
+		RowFilter *rowFilter = newRowFilter(originalImage.getWidth());
+		const size_t windowHeight = rowFilter->getWindowHeight();
+		size_t y = firstRow;
+		forEachRow(firstRow, lastRow + windowHeight - 1, [&](size_t inputRow) {
+			const Pixel *row = rowFilter->pushRow(originalImage.getRow(inputRow));
+			if (row) {
+				memcpy(blurredImage->getRow(y++), row, width * sizeof(Pixel));
+			}
+		});
+		delete rowFilter;
+	});
+
 	return blurredImage;
 }
 
-Pixel
-etchasketch::edgedetect::BlurImageFilter::blurredPixel(const Image &img,
-													   int x, int y) const
-{
-	// Perform convolution to combine the region of the image with the kernel.
-	float sum = 0.0f;
-	int dx;
-	for (dx = -radius; dx <= (int)radius; dx++) {
-		for (int dy = -radius; dy <= (int)radius; dy++) {
-			const KDPoint<2> pt(x + dx, y + dy);
-			const float kernelVal = kernel[dx+radius][dy+radius];
-			const Pixel pix = (img[pt] >> 8) & 0xFF;
-			const float pixVal = static_cast<float>(pix);
-			sum += pixVal * kernelVal;
+etchasketch::edgedetect::RowFilter *
+etchasketch::edgedetect::BlurImageFilter::newRowFilter(size_t width) const
+{
+	if (BlurMode::Gaussian == mode) {
+		return new GaussianRowFilter(width, kernel);
+	}
+
+	RowFilterChain *chain = new RowFilterChain(width);
+	for (const uint32_t boxRadius : boxRadii) {
+		if (0 == boxRadius) {
+			// A single-pixel box changes nothing.
+			continue;
 		}
+		chain->addStage(new BoxRowFilter(width, boxRadius));
+		width -= std::min<size_t>(width, 2 * boxRadius);
 	}
-	// Turn it back into a Pixel.
-	uint8_t channel = static_cast<uint8_t>(sum);
-	Pixel retVal = (channel << 24) |
-				   (channel << 16) |
-				   (channel <<  8) |
-				   0xFF;
-	return retVal;
+	return chain;
 }
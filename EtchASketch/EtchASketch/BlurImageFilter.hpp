@@ -9,42 +9,94 @@
 #ifndef BlurImageFilter_hpp
 #define BlurImageFilter_hpp
 
+#include <vector>
 #include "ImageFilter.hpp"
 
 namespace etchasketch {
 	namespace edgedetect {
-		
+
+		/// How @c BlurImageFilter blurs an image.
+		enum class BlurMode {
+			/**
+			 * A true Gaussian, applied as a horizontal pass followed by a
+			 * vertical pass. Costs O(radius) per pixel.
+			 */
+			Gaussian,
+
+			/**
+			 * Three successive box blurs sized to approximate the Gaussian.
+			 * Costs O(1) per pixel whatever the sigma, so it's the better
+			 * choice for large sigmas.
+			 */
+			TripleBox,
+		};
+
 		/// An image filter that applies a blur.
 		class BlurImageFilter : public etchasketch::edgedetect::ImageFilter {
 		public:
-			/// The radius of the blur.
-			static const uint32_t radius = 4;
-			
-			BlurImageFilter();
-			
+			/**
+			 * Create a new blur filter.
+			 *
+			 * @param sigma The standard deviation of the Gaussian, in pixels.
+			 * @param radius How far the Gaussian kernel reaches on each side
+			 * of a pixel. Ignored in @c BlurMode::TripleBox mode, where the
+			 * box sizes follow from @c sigma.
+			 * @param mode How to blur.
+			 */
+			BlurImageFilter(float sigma = 1.0f, uint32_t radius = 4,
+							BlurMode mode = BlurMode::Gaussian);
+
 			virtual ~BlurImageFilter() { };
-			
+
+			/// A kernel radius that covers a Gaussian out to 4 sigma.
+			static uint32_t radiusForSigma(float sigma);
+
+			/// The standard deviation of the blur, in pixels.
+			inline float getSigma() const
+				{ return sigma; }
+
+			/// How the blur is computed.
+			inline BlurMode getMode() const
+				{ return mode; }
+
 			/**
-			 * Apply a Gaussian blur to the image, copying the result into a
-			 * newly allocated image.
+			 * The number of pixels trimmed from each side of the image. Only
+			 * pixels whose whole neighborhood lies within the original image
+			 * are output, so the result is smaller by twice this in each
+			 * dimension.
 			 */
-			virtual etchasketch::Image *
-			apply(const etchasketch::Image &originalImage) const;
-			
-		private:
-			static const uint32_t kernelSize = 2*radius + 1;
-			float kernel[kernelSize][kernelSize];
-			
-			void initKernel();
-			
+			uint32_t getRadius() const;
+
 			/**
-			 * Compute the blurred version of a pixel by examining the 
-			 * surrounding pixels.
+			 * Blur the image, copying the result into a newly allocated
+			 * image.
 			 */
-			etchasketch::Image::Pixel
-			blurredPixel(const etchasketch::Image &img, int x, int y) const;
+			virtual etchasketch::GrayImage *
+			apply(const etchasketch::GrayImage &originalImage) const;
+
+			/// Create a row filter that blurs an image of the given width.
+			virtual etchasketch::edgedetect::RowFilter *
+			newRowFilter(size_t width) const;
+
+		private:
+			float sigma;
+
+			BlurMode mode;
+
+			/// The Gaussian kernel radius.
+			uint32_t radius;
+
+			/// The normalized 1-D Gaussian weights, 2*radius + 1 of them.
+			std::vector<float> kernel;
+
+			/// The radius of each box in @c BlurMode::TripleBox mode.
+			uint32_t boxRadii[3];
+
+			void initKernel();
+
+			void initBoxes();
 		};
-		
+
 	}
 }
 
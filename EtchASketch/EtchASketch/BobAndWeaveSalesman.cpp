@@ -8,15 +8,19 @@
 
 #include "BobAndWeaveSalesman.hpp"
 #include "EASUtils+Private.hpp"
+#include "PixelTraversal.hpp"
+#include <algorithm>
 #include <cmath>
+#include <stdint.h>
 
+using std::vector;
+using etchasketch::traversal::forEachRowBand;
 
 namespace etchasketch {
 namespace salesman {
 
-BobAndWeaveSalesman::BobAndWeaveSalesman(const Image &grayscaleImage,
-										 const Image &edgeImage)
-	: Salesman(), grayscaleImage(grayscaleImage), edgeImage(edgeImage)
+BobAndWeaveSalesman::BobAndWeaveSalesman(const GrayImage &grayscaleImage)
+	: Salesman(), grayscaleImage(grayscaleImage), threadPool(nullptr)
 {
 }
 
@@ -27,54 +31,68 @@ BobAndWeaveSalesman::~BobAndWeaveSalesman()
 void
 BobAndWeaveSalesman::orderPoints()
 {
-	// TODO: parallelize this
-	for (KDPointCoordinate y = 0; y < grayscaleImage.getHeight(); y += lineSeparation) {
-		// First go left to right…
-		for (KDPointCoordinate x = 0; x < grayscaleImage.getWidth(); ++x) {
-			orderedPoints.push_back(offsetPointAt(x, y));
-		}
-
-		// Then go right to left.
-		y += lineSeparation;
-		if (y >= grayscaleImage.getHeight()) {
-			break;
-		}
+	const size_t width = grayscaleImage.getWidth();
+	const size_t height = grayscaleImage.getHeight();
+	const size_t lineCount = (height + lineSeparation - 1) / lineSeparation;
+	orderedPoints.assign(lineCount * width, KDPoint<2>());
 
-		// Then go right to left.
-		for (KDPointCoordinate x = static_cast<int>(grayscaleImage.getWidth()) - 1;
-		     x >= 0; --x) {
-			orderedPoints.push_back(offsetPointAt(x, y));
-		}
+	// The wave only depends on the column, so work it out once per column
+	// rather than once per point.
+	vector<double> sines(width);
+	for (size_t x = 0; x < width; x++) {
+		sines[x] = sin(static_cast<double>(x));
 	}
+
+	forEachRowBand(threadPool, 0, lineCount, [&](size_t firstLine, size_t lastLine) {
+		generateLines(firstLine, lastLine, sines);
+	});
 }
 
-KDPoint<2>
-BobAndWeaveSalesman::offsetPointAt(const KDPointCoordinate x,
-								   const KDPointCoordinate y) const
+void
+BobAndWeaveSalesman::generateLines(size_t firstLine, size_t lastLine,
+								   const vector<double> &sines)
 {
-	uint32_t totalBrightness = 0;
-	uint32_t numPixelsSearched = 0;
-	// Search within the square radius.
-	for (KDPointCoordinate xi = MAX(x - pointSearchRadius, 0);
-	     xi < MIN(x + pointSearchRadius, grayscaleImage.getWidth()); ++xi) {
-		for (KDPointCoordinate yi = MAX(y - pointSearchRadius, 0);
-		     yi < MIN(y + pointSearchRadius, grayscaleImage.getHeight()); ++yi) {
-			// Check if this pixel is part of an edge.
-			const KDPoint<2> pt(xi, yi);
-			const Image::Pixel px = grayscaleImage[pt];
-			uint8_t brightness = (px >> 8) & 0xFF;
-			totalBrightness += brightness;
-			
-			++numPixelsSearched;
+	const KDPointCoordinate width = static_cast<KDPointCoordinate>(grayscaleImage.getWidth());
+	const KDPointCoordinate height = static_cast<KDPointCoordinate>(grayscaleImage.getHeight());
+	// windowSums[x] is the total brightness of the columns left of x, over
+	// the rows the current line's windows cover.
+	vector<uint32_t> columnSums(width);
+	vector<uint32_t> windowSums(width + 1);
+	for (size_t line = firstLine; line < lastLine; line++) {
+		const KDPointCoordinate y = static_cast<KDPointCoordinate>(line * lineSeparation);
+		// Search within the square radius, clipped to the image.
+		const KDPointCoordinate top = MAX(y - pointSearchRadius, 0);
+		const KDPointCoordinate bottom = MIN(y + pointSearchRadius, height);
+		std::fill(columnSums.begin(), columnSums.end(), 0);
+		for (KDPointCoordinate row = top; row < bottom; row++) {
+			const GrayImage::Pixel *pixels = grayscaleImage.getRow(row);
+			for (KDPointCoordinate x = 0; x < width; x++) {
+				columnSums[x] += pixels[x];
+			}
+		}
+		windowSums[0] = 0;
+		for (KDPointCoordinate x = 0; x < width; x++) {
+			windowSums[x + 1] = windowSums[x] + columnSums[x];
+		}
+
+		// Even lines go left to right, odd lines right to left.
+		KDPoint<2> *points = orderedPoints.data() + line * width;
+		const bool isLeftToRight = (0 == line % 2);
+		for (KDPointCoordinate i = 0; i < width; i++) {
+			const KDPointCoordinate x = isLeftToRight ? i : (width - 1 - i);
+			const KDPointCoordinate left = MAX(x - pointSearchRadius, 0);
+			const KDPointCoordinate right = MIN(x + pointSearchRadius, width);
+			const uint32_t totalBrightness = windowSums[right] - windowSums[left];
+			const uint32_t numPixelsSearched = (right - left) * (bottom - top);
+			double avgBrightness = static_cast<double>(totalBrightness) / numPixelsSearched / 255.0;
+			double verticalDisplacement = sines[x] * avgBrightness * lineSeparation / 2 * k_grav;
+
+			// Add the vertical displacement to the point.
+			KDPointCoordinate dy = static_cast<KDPointCoordinate>(verticalDisplacement);
+			KDPointCoordinate ydy = MIN(MAX(y + dy, 0), height - 1);
+			points[i] = KDPoint<2>(x, ydy);
 		}
 	}
-	double avgBrightness = static_cast<double>(totalBrightness) / numPixelsSearched / 255.0;
-	double verticalDisplacement = sin(x) * avgBrightness * lineSeparation / 2 * k_grav;
-	
-	// Add the vertical displacement to the point and return it.
-	KDPointCoordinate dy = static_cast<KDPointCoordinate>(verticalDisplacement);
-	KDPointCoordinate ydy = MIN(MAX(y + dy, 0), static_cast<KDPointCoordinate>(grayscaleImage.getHeight() - 1));
-	return KDPoint<2>(x, ydy);
 }
 
 } // namespace salesman
@@ -9,9 +9,12 @@
 #ifndef BobAndWeaveSalesman_hpp
 #define BobAndWeaveSalesman_hpp
 
+#include <stddef.h>
+#include <vector>
 #include "Salesman.hpp"
 #include "Image.hpp"
 #include "KDPoint.hpp"
+#include "ThreadPool.hpp"
 
 namespace etchasketch {
 namespace salesman {
@@ -19,29 +22,38 @@ namespace salesman {
 /**
  * Create a salesman that draws periodic horizontal lines which are perturbed to
  * follow the edges in the input image.
+ *
+ * Every line has exactly one point per column, so each line's points have a
+ * known place in the output and the lines are generated in parallel. The
+ * brightness around each point comes from a summed-area table of the rows
+ * the line passes through, so a window average is two lookups.
  */
 class BobAndWeaveSalesman : public Salesman {
   public:
 	/**
 	 * @param grayscaleImage The image produced by converting the original image
 	 * to grayscale.
-	 * @param edgeImage The image produced by edge detection.
-	 * @param lineSeparation The vertical distance between each horizontal line
-	 * drawn, in pixels.
 	 */
-	BobAndWeaveSalesman(const Image &grayscaleImage, const Image &edgeImage);
+	BobAndWeaveSalesman(const GrayImage &grayscaleImage);
 
 	virtual ~BobAndWeaveSalesman();
 
 	/// Put the points in the order in which they should be drawn.
 	void orderPoints();
 
+	/**
+	 * Generate the lines on the threads of @c pool, or on the calling thread
+	 * if it's @c nullptr. The pool isn't owned, and must outlive its use
+	 * here.
+	 */
+	inline void setThreadPool(etchasketch::ThreadPool *pool)
+		{ threadPool = pool; }
+
   private:
 	/// The grayscale image.
-	const Image &grayscaleImage;
+	const GrayImage &grayscaleImage;
 
-	/// The edge-detected image.
-	const Image &edgeImage;
+	etchasketch::ThreadPool *threadPool;
 
 	/// The vertical distance between each horizontal line drawn, in pixels.
 	static constexpr size_t lineSeparation = 4;
@@ -53,14 +65,17 @@ class BobAndWeaveSalesman : public Salesman {
 	static constexpr float k_grav = 4.0f;
 
 	/**
-	 * Get the vertical displacement for the cursor at the given point within
-	 * the image.
+	 * Fill in @c orderedPoints for the lines [@c firstLine, @c lastLine).
+	 *
+	 * Each point is displaced up or down by the average brightness within a
+	 * radius of @c pointSearchRadius around it, performing "gravitational
+	 * attraction" to draw the cursor up or down to better conform to the
+	 * detected lines.
 	 *
-	 * Search within a radius of @c pointSearchRadius around the given point,
-	 * performing "gravitational attraction" to draw the cursor up or down to
-	 * better conform to the detected lines.
+	 * @param sines @c sin(x) for each column x.
 	 */
-	KDPoint<2> offsetPointAt(const KDPointCoordinate x, const KDPointCoordinate y) const;
+	void generateLines(size_t firstLine, size_t lastLine,
+					   const std::vector<double> &sines);
 };
 }
 }
@@ -0,0 +1,176 @@
+//
+//  ChainSalesman.cpp
+//  EtchASketch
+//
+
+#include "ChainSalesman.hpp"
+#include "EASUtils+Private.hpp"
+#include "GridIndex.hpp"
+#include "PointLookup.hpp"
+#include <algorithm>
+#include <iterator>
+
+using std::vector;
+using etchasketch::EdgeMask;
+using etchasketch::EdgePointBuffer;
+using etchasketch::GridIndex;
+using etchasketch::KDPoint;
+using etchasketch::PointLookup;
+
+namespace {
+
+/**
+ * The offsets to each of a pixel's 8 neighbors, in the order they're
+ * followed. Straight neighbors come first, so a chain only cuts a corner
+ * when it has to.
+ */
+const int neighborOffsets[8][2] = {
+	{ 1, 0 }, { 0, 1 }, { -1, 0 }, { 0, -1 },
+	{ 1, 1 }, { -1, 1 }, { -1, -1 }, { 1, -1 },
+};
+
+}
+
+namespace etchasketch {
+namespace salesman {
+
+ChainSalesman::ChainSalesman(const EdgePointBuffer &unorderedPoints,
+							 const KDPoint<2> &startPoint)
+	: Salesman(), startPoint(startPoint), unorderedPoints(unorderedPoints)
+{
+}
+
+ChainSalesman::~ChainSalesman()
+{
+}
+
+void
+ChainSalesman::orderPoints()
+{
+	if (!unorderedPoints.contains(startPoint[0], startPoint[1])) {
+		EASLog("Error: unorderedPoints does not contain the starting point");
+		exit(1);
+	}
+	extractChains();
+	orderChains();
+}
+
+#pragma mark - Chain extraction
+
+void
+ChainSalesman::extractChains()
+{
+	EdgeMask unvisited = unorderedPoints.copyAsMask();
+	chainPoints.clear();
+	chainPoints.reserve(unorderedPoints.size());
+	chainStarts.assign(1, 0);
+
+	// The first chain only goes forward, so the drawing starts at the start
+	// point.
+	unvisited.set(startPoint[0], startPoint[1], false);
+	chainPoints.push_back(startPoint);
+	traceFrom(startPoint[0], startPoint[1], unvisited);
+	chainStarts.push_back(static_cast<uint32_t>(chainPoints.size()));
+
+	for (size_t y = 0; y < unvisited.getHeight(); y++) {
+		const EdgeMask::Word *row = unvisited.getRow(y);
+		for (size_t wordIndex = 0; wordIndex < unvisited.getWordsPerRow(); wordIndex++) {
+			// Tracing clears bits as it goes, so reload the word each time.
+			while (0 != row[wordIndex]) {
+				const size_t x = wordIndex * EdgeMask::bitsPerWord
+								 + static_cast<size_t>(__builtin_ctzll(row[wordIndex]));
+				const size_t chainStart = chainPoints.size();
+				unvisited.set(x, y, false);
+				chainPoints.push_back(KDPoint<2>(static_cast<KDPointCoordinate>(x),
+												 static_cast<KDPointCoordinate>(y)));
+				traceFrom(x, y, unvisited);
+				// The seed may be in the middle of an edge, so trace the other
+				// way too, and put that half in front, reversed.
+				const size_t forwardEnd = chainPoints.size();
+				traceFrom(x, y, unvisited);
+				std::reverse(chainPoints.begin() + forwardEnd, chainPoints.end());
+				std::rotate(chainPoints.begin() + chainStart,
+							chainPoints.begin() + forwardEnd, chainPoints.end());
+				chainStarts.push_back(static_cast<uint32_t>(chainPoints.size()));
+			}
+		}
+	}
+}
+
+void
+ChainSalesman::traceFrom(size_t x, size_t y, EdgeMask &unvisited)
+{
+	const ptrdiff_t width = static_cast<ptrdiff_t>(unvisited.getWidth());
+	const ptrdiff_t height = static_cast<ptrdiff_t>(unvisited.getHeight());
+	ptrdiff_t currX = static_cast<ptrdiff_t>(x), currY = static_cast<ptrdiff_t>(y);
+	bool isFollowing = true;
+	while (isFollowing) {
+		isFollowing = false;
+		for (const int *offset : neighborOffsets) {
+			const ptrdiff_t nextX = currX + offset[0], nextY = currY + offset[1];
+			if ((nextX < 0) || (nextY < 0) || (nextX >= width) || (nextY >= height)
+				|| !unvisited.get(nextX, nextY)) {
+				continue;
+			}
+			unvisited.set(nextX, nextY, false);
+			chainPoints.push_back(KDPoint<2>(static_cast<KDPointCoordinate>(nextX),
+											 static_cast<KDPointCoordinate>(nextY)));
+			currX = nextX;
+			currY = nextY;
+			isFollowing = true;
+			break;
+		}
+	}
+}
+
+#pragma mark - Chain ordering
+
+void
+ChainSalesman::orderChains()
+{
+	const size_t chainCount = getChainCount();
+	orderedPoints.clear();
+	orderedPoints.reserve(chainPoints.size());
+	// Draw the first chain from the start point.
+	orderedPoints.insert(orderedPoints.end(), chainPoints.begin(),
+						 chainPoints.begin() + chainStarts[1]);
+
+	// Index the endpoints of the rest, and remember which chain each is on.
+	// Every pixel is on exactly one chain, so no two chains share one.
+	vector<KDPoint<2>> endpoints;
+	PointLookup chainForEndpoint;
+	endpoints.reserve(2 * chainCount);
+	chainForEndpoint.reserve(2 * chainCount);
+	for (size_t chain = 1; chain < chainCount; chain++) {
+		const KDPoint<2> &first = chainPoints[chainStarts[chain]];
+		const KDPoint<2> &last = chainPoints[chainStarts[chain + 1] - 1];
+		endpoints.push_back(first);
+		chainForEndpoint.add(first, static_cast<uint32_t>(chain));
+		if (first != last) {
+			endpoints.push_back(last);
+			chainForEndpoint.add(last, static_cast<uint32_t>(chain));
+		}
+	}
+	chainForEndpoint.sort();
+	GridIndex endpointIndex(endpoints);
+
+	KDPoint<2> endpoint;
+	while (endpointIndex.findNearestNeighbor(orderedPoints.back(), endpoint)) {
+		const size_t chain = chainForEndpoint.find(endpoint);
+		auto first = chainPoints.begin() + chainStarts[chain];
+		auto last = chainPoints.begin() + chainStarts[chain + 1];
+		// Draw it from whichever end is closer.
+		if (*first == endpoint) {
+			orderedPoints.insert(orderedPoints.end(), first, last);
+		} else {
+			orderedPoints.insert(orderedPoints.end(),
+								 std::reverse_iterator<decltype(last)>(last),
+								 std::reverse_iterator<decltype(first)>(first));
+		}
+		endpointIndex.remove(*first);
+		endpointIndex.remove(*(last - 1));
+	}
+}
+
+}
+}
@@ -0,0 +1,86 @@
+//
+//  ChainSalesman.hpp
+//  EtchASketch
+//
+
+#ifndef ChainSalesman_hpp
+#define ChainSalesman_hpp
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "Salesman.hpp"
+#include "EdgeMask.hpp"
+#include "EdgePointBuffer.hpp"
+#include "KDPoint.hpp"
+
+namespace etchasketch {
+namespace salesman {
+
+/**
+ * Traces each edge as a whole before jumping to the next one.
+ *
+ * A single scan of the edge bitmap breaks the edges into chains: starting
+ * from the first unvisited pixel it finds, it follows 8-connected unvisited
+ * neighbors forward as far as they go, then backward from the start, and
+ * the two halves make one polyline. Then only the chains' endpoints need
+ * ordering. From the end of each chain, the salesman jumps to the closest
+ * endpoint of a chain it hasn't drawn and draws that chain from there.
+ *
+ * Following the edges keeps the pen on them instead of zigzagging between
+ * neighbors the way a point-by-point tour can, and there are far fewer
+ * endpoints than points to search.
+ */
+class ChainSalesman : public Salesman {
+  public:
+	/**
+	 * The startPoint must be contained within the unorderedPoints, which
+	 * must outlive the salesman. The drawing starts with the chain that
+	 * begins at startPoint.
+	 */
+	ChainSalesman(const EdgePointBuffer &unorderedPoints,
+				  const KDPoint<2> &startPoint);
+
+	virtual ~ChainSalesman();
+
+	/// Order the points for the best drawing order.
+	virtual void orderPoints();
+
+	/// The number of chains the edges were broken into.
+	inline size_t getChainCount() const
+		{ return chainStarts.empty() ? 0 : chainStarts.size() - 1; }
+
+  private:
+	/// The point at which we begin drawing.
+	const KDPoint<2> startPoint;
+
+	/// The points to put in order.
+	const EdgePointBuffer &unorderedPoints;
+
+	/// The points of every chain, one after another.
+	std::vector<KDPoint<2>> chainPoints;
+
+	/**
+	 * Where each chain starts in @c chainPoints, plus one past the end. Chain
+	 * @c i is [@c chainStarts[i], @c chainStarts[i + 1]).
+	 */
+	std::vector<uint32_t> chainStarts;
+
+	/// Break the edges into chains, with the first one starting at startPoint.
+	void extractChains();
+
+	/**
+	 * Follow unvisited pixels from (@c x, @c y), clearing them from
+	 * @c unvisited and adding them to @c chainPoints, until there are none
+	 * left next to the last one.
+	 */
+	void traceFrom(size_t x, size_t y, EdgeMask &unvisited);
+
+	/// Order the chains, and copy their points out in drawing order.
+	void orderChains();
+};
+
+}
+}
+
+#endif /* ChainSalesman_hpp */
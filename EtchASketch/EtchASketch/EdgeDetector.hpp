@@ -9,24 +9,100 @@
 #ifndef EdgeDetector_hpp
 #define EdgeDetector_hpp
 
+#include <functional>
 #include "Image.hpp"
+#include "EdgeMask.hpp"
+#include "StrategyRegistry.hpp"
+#include "ThreadPool.hpp"
 
 namespace etchasketch {
 	namespace edgedetect {
 		
+		/**
+		 * Detects edges one row at a time, keeping only the rows it still
+		 * needs. @c RowEdgeDetector is an abstract superclass; get one from
+		 * @c EdgeDetector::newRowDetector().
+		 *
+		 * Like a @c RowFilter, each mask row is computed from a window of
+		 * consecutive input rows, so the first mask row comes out with the
+		 * @c getWindowHeight() th input row and each one after that with the
+		 * next input row.
+		 */
+		class RowEdgeDetector {
+		public:
+			virtual ~RowEdgeDetector() { };
+			
+			/// The width of the mask @c EdgeDetector::detectEdges() would make.
+			virtual size_t getMaskWidth() const = 0;
+			
+			/**
+			 * The height of the mask @c EdgeDetector::detectEdges() would
+			 * make. Some of its bottom rows may never be pushed out.
+			 */
+			virtual size_t getMaskHeight() const = 0;
+			
+			/// The number of input rows that go into each mask row.
+			virtual size_t getWindowHeight() const = 0;
+			
+			/**
+			 * Feed in the next input row.
+			 *
+			 * @return The next row of the mask, or @c nullptr if the window
+			 * isn't full yet. The row is only valid until the next call.
+			 */
+			virtual const etchasketch::EdgeMask::Word *
+			pushRow(const etchasketch::GrayImage::Pixel *row) = 0;
+		};
+		
 		/**
 		 * Finds edges within an image. @c EdgeDetector is an abstract
 		 * superclass; do not attempt to instantiate it.
 		 */
 		class EdgeDetector {
 		public:
+			EdgeDetector() : threadPool(nullptr) { };
+			
 			virtual ~EdgeDetector() { };
 			
-			/// Detect edges in an image.
-			virtual etchasketch::Image *
-			detectEdges(const etchasketch::Image &grayscaleImage) const = 0;
+			/**
+			 * Run on the threads of @c pool, or on the calling thread if it's
+			 * @c nullptr. The pool isn't owned, and must outlive its use here.
+			 */
+			void setThreadPool(etchasketch::ThreadPool *pool)
+				{ threadPool = pool; }
+			
+			/// Detect edges in an image, marking each edge pixel in a mask.
+			virtual etchasketch::EdgeMask *
+			detectEdges(const etchasketch::GrayImage &grayscaleImage) const = 0;
+			
+			/**
+			 * Create a row detector for an image of the given size, for
+			 * streaming an image through without holding all of it. The
+			 * caller owns the returned detector, which mustn't outlive this
+			 * one.
+			 */
+			virtual etchasketch::edgedetect::RowEdgeDetector *
+			newRowDetector(size_t width, size_t height) const = 0;
+			
+		protected:
+			/// The pool to run on, or @c nullptr to run on the calling thread.
+			etchasketch::ThreadPool *threadPool;
 		};
 		
+		/**
+		 * Makes an edge detector with the given parameters, all of them
+		 * filled in. The caller owns it.
+		 */
+		typedef std::function<EdgeDetector *(const etchasketch::StrategyParameters &parameters)>
+			EdgeDetectorFactory;
+		
+		/**
+		 * The ways @c ImageFlow can detect edges:
+		 *
+		 * - sobel: @c SobelEdgeDetector. The default.
+		 */
+		etchasketch::StrategyRegistry<EdgeDetectorFactory> & edgeDetectors();
+		
 	}
 }
 
@@ -0,0 +1,22 @@
+//
+//  EdgeMask.cpp
+//  EtchASketch
+//
+
+#include "EdgeMask.hpp"
+
+etchasketch::EdgeMask::EdgeMask(size_t width, size_t height)
+: width(width), height(height),
+  wordsPerRow((width + bitsPerWord - 1) / bitsPerWord),
+  words(wordsPerRow * height, 0)
+{ }
+
+size_t
+etchasketch::EdgeMask::getEdgeCount() const
+{
+	size_t count = 0;
+	for (const Word word : words) {
+		count += __builtin_popcountll(word);
+	}
+	return count;
+}
@@ -0,0 +1,88 @@
+//
+//  EdgeMask.hpp
+//  EtchASketch
+//
+
+#ifndef EdgeMask_hpp
+#define EdgeMask_hpp
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace etchasketch {
+
+/**
+ * A 1-bit-per-pixel image marking which pixels lie on an edge.
+ *
+ * Bits are packed into 64-bit words, least significant bit first, so bit
+ * @c (x % 64) of word @c (x / 64) in a row is pixel @c x. Every row starts
+ * on a word boundary, and the padding bits past the right edge are always
+ * zero, so a whole row can be scanned a word at a time.
+ */
+class EdgeMask {
+public:
+	/// The unit that bits are packed into.
+	typedef uint64_t Word;
+
+	/// The number of pixels in each @c Word.
+	static const size_t bitsPerWord = 64;
+
+	/// Create an empty (all clear) mask.
+	EdgeMask(size_t width = 0, size_t height = 0);
+
+	/// Whether the mask has any pixels.
+	inline bool isValid() const
+		{ return (width > 0) && (height > 0); }
+
+	/// The width of the mask, in pixels.
+	inline size_t getWidth() const
+		{ return width; }
+
+	/// The height of the mask, in pixels.
+	inline size_t getHeight() const
+		{ return height; }
+
+	/// The number of words in each row.
+	inline size_t getWordsPerRow() const
+		{ return wordsPerRow; }
+
+	/// Get a pointer to the first word of row @c y. Unchecked.
+	inline const Word *getRow(size_t y) const
+		{ return words.data() + (y * wordsPerRow); }
+
+	/// Get a pointer to the first word of row @c y. Unchecked.
+	inline Word *getRow(size_t y)
+		{ return words.data() + (y * wordsPerRow); }
+
+	/// Whether the pixel at (@c x, @c y) is an edge. Unchecked.
+	inline bool get(size_t x, size_t y) const
+		{ return (getRow(y)[x / bitsPerWord] >> (x % bitsPerWord)) & 1; }
+
+	/// Mark or clear the pixel at (@c x, @c y). Unchecked.
+	inline void set(size_t x, size_t y, bool isEdge = true) {
+		const Word bit = static_cast<Word>(1) << (x % bitsPerWord);
+		Word &word = getRow(y)[x / bitsPerWord];
+		word = isEdge ? (word | bit) : (word & ~bit);
+	}
+
+	/// Count the pixels marked as edges.
+	size_t getEdgeCount() const;
+
+private:
+	/// The width of the mask, in pixels.
+	size_t width;
+
+	/// The height of the mask, in pixels.
+	size_t height;
+
+	/// The number of words in each row.
+	size_t wordsPerRow;
+
+	/// The packed bits, row by row.
+	std::vector<Word> words;
+};
+
+}
+
+#endif /* EdgeMask_hpp */
@@ -0,0 +1,132 @@
+//
+//  EdgePointBuffer.cpp
+//  EtchASketch
+//
+
+#include "EdgePointBuffer.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+using std::invalid_argument;
+using std::out_of_range;
+using std::vector;
+using etchasketch::KDPoint;
+using Coordinate = etchasketch::EdgePointBuffer::Coordinate;
+
+etchasketch::EdgePointBuffer::EdgePointBuffer()
+: xs(), ys()
+{ }
+
+void
+etchasketch::EdgePointBuffer::reserve(size_t count)
+{
+	xs.reserve(count);
+	ys.reserve(count);
+}
+
+void
+etchasketch::EdgePointBuffer::append(size_t x, size_t y)
+{
+	validateCoordinates(x, y);
+	if (!empty() && ((y < ys.back()) || ((y == ys.back()) && (x <= xs.back())))) {
+		invalid_argument e("Edge points must be appended in row-major order");
+		throw e;
+	}
+	xs.push_back(static_cast<Coordinate>(x));
+	ys.push_back(static_cast<Coordinate>(y));
+}
+
+void
+etchasketch::EdgePointBuffer::append(const EdgePointBuffer &other)
+{
+	if (other.empty()) {
+		return;
+	}
+	if (!empty()) {
+		const Coordinate x = other.xs.front(), y = other.ys.front();
+		if ((y < ys.back()) || ((y == ys.back()) && (x <= xs.back()))) {
+			invalid_argument e("Edge points must be appended in row-major order");
+			throw e;
+		}
+	}
+	xs.insert(xs.end(), other.xs.begin(), other.xs.end());
+	ys.insert(ys.end(), other.ys.begin(), other.ys.end());
+}
+
+bool
+etchasketch::EdgePointBuffer::insert(size_t x, size_t y)
+{
+	validateCoordinates(x, y);
+	const size_t i = lowerBound(static_cast<Coordinate>(x),
+								static_cast<Coordinate>(y));
+	if ((i < size()) && (xs[i] == x) && (ys[i] == y)) {
+		return false;
+	}
+	xs.insert(xs.begin() + i, static_cast<Coordinate>(x));
+	ys.insert(ys.begin() + i, static_cast<Coordinate>(y));
+	return true;
+}
+
+bool
+etchasketch::EdgePointBuffer::contains(size_t x, size_t y) const
+{
+	if ((x > maxCoordinate) || (y > maxCoordinate)) {
+		return false;
+	}
+	const size_t i = lowerBound(static_cast<Coordinate>(x),
+								static_cast<Coordinate>(y));
+	return (i < size()) && (xs[i] == x) && (ys[i] == y);
+}
+
+vector<KDPoint<2>>
+etchasketch::EdgePointBuffer::copyAsKDPoints() const
+{
+	vector<KDPoint<2>> points;
+	points.reserve(size());
+	for (size_t i = 0; i < size(); i++) {
+		points.push_back(getPoint(i));
+	}
+	return points;
+}
+
+etchasketch::EdgeMask
+etchasketch::EdgePointBuffer::copyAsMask() const
+{
+	if (empty()) {
+		return EdgeMask();
+	}
+	const size_t width = static_cast<size_t>(*std::max_element(xs.begin(), xs.end())) + 1;
+	// The points are sorted by row.
+	const size_t height = static_cast<size_t>(ys.back()) + 1;
+	EdgeMask mask(width, height);
+	for (size_t i = 0; i < size(); i++) {
+		mask.set(xs[i], ys[i]);
+	}
+	return mask;
+}
+
+size_t
+etchasketch::EdgePointBuffer::lowerBound(Coordinate x, Coordinate y) const
+{
+	size_t first = 0, count = size();
+	while (count > 0) {
+		const size_t step = count / 2;
+		const size_t i = first + step;
+		if ((ys[i] < y) || ((ys[i] == y) && (xs[i] < x))) {
+			first = i + 1;
+			count -= step + 1;
+		} else {
+			count = step;
+		}
+	}
+	return first;
+}
+
+void
+etchasketch::EdgePointBuffer::validateCoordinates(size_t x, size_t y)
+{
+	if ((x > maxCoordinate) || (y > maxCoordinate)) {
+		out_of_range e("Edge point coordinates must fit in 16 bits");
+		throw e;
+	}
+}
@@ -0,0 +1,106 @@
+//
+//  EdgePointBuffer.hpp
+//  EtchASketch
+//
+
+#ifndef EdgePointBuffer_hpp
+#define EdgePointBuffer_hpp
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "EdgeMask.hpp"
+#include "KDPoint.hpp"
+
+namespace etchasketch {
+
+/**
+ * A compact, sorted set of edge points.
+ *
+ * Points are kept in row-major order (by y, then x) as two parallel arrays
+ * of 16-bit coordinates, so each point costs 4 bytes. A raster scan of an
+ * edge mask produces points in exactly this order and never repeats one, so
+ * the buffer is filled by appending and needs no hashing. Lookups are binary
+ * searches.
+ */
+class EdgePointBuffer {
+public:
+	/// The type of one coordinate.
+	typedef uint16_t Coordinate;
+
+	/// The largest coordinate a point can have.
+	static const size_t maxCoordinate = UINT16_MAX;
+
+	/// Create an empty buffer.
+	EdgePointBuffer();
+
+	/// The number of points.
+	inline size_t size() const
+		{ return xs.size(); }
+
+	/// Whether there are no points.
+	inline bool empty() const
+		{ return xs.empty(); }
+
+	/// The x coordinate of point @c i. Unchecked.
+	inline Coordinate getX(size_t i) const
+		{ return xs[i]; }
+
+	/// The y coordinate of point @c i. Unchecked.
+	inline Coordinate getY(size_t i) const
+		{ return ys[i]; }
+
+	/// Point @c i. Unchecked.
+	inline etchasketch::KDPoint<2> getPoint(size_t i) const
+		{ return etchasketch::KDPoint<2>(xs[i], ys[i]); }
+
+	/// Make room for @c count points in all.
+	void reserve(size_t count);
+
+	/**
+	 * Add a point to the end of the buffer. It must come after every point
+	 * already in the buffer in row-major order.
+	 */
+	void append(size_t x, size_t y);
+
+	/**
+	 * Add all the points of @c other to the end of the buffer. They must all
+	 * come after every point already in the buffer in row-major order.
+	 */
+	void append(const EdgePointBuffer &other);
+
+	/**
+	 * Add a point wherever it belongs. Costs O(n), so prefer @c append()
+	 * when filling the buffer in order.
+	 *
+	 * @return Whether the point was added; @c false if it was already there.
+	 */
+	bool insert(size_t x, size_t y);
+
+	/// Whether the buffer holds the given point.
+	bool contains(size_t x, size_t y) const;
+
+	/// Copy the points out, in order, as @c KDPoint s.
+	std::vector<etchasketch::KDPoint<2>> copyAsKDPoints() const;
+
+	/**
+	 * Draw the points into a mask just big enough to hold them, with its
+	 * top-left corner at (0, 0).
+	 */
+	etchasketch::EdgeMask copyAsMask() const;
+
+private:
+	std::vector<Coordinate> xs;
+
+	std::vector<Coordinate> ys;
+
+	/// The index of the first point not before (@c x, @c y).
+	size_t lowerBound(Coordinate x, Coordinate y) const;
+
+	/// Throw if a point can't be stored.
+	static void validateCoordinates(size_t x, size_t y);
+};
+
+}
+
+#endif /* EdgePointBuffer_hpp */
@@ -0,0 +1,256 @@
+//
+//  GrayscaleConverter.cpp
+//  EtchASketch
+//
+
+#include "GrayscaleConverter.hpp"
+#include "PixelTraversal.hpp"
+#include "SIMDSupport.hpp"
+#include <stdexcept>
+
+using std::invalid_argument;
+using etchasketch::Image;
+using etchasketch::GrayImage;
+using etchasketch::GrayscaleConverter;
+using etchasketch::LuminanceModel;
+using etchasketch::traversal::forEachRow;
+using etchasketch::traversal::forEachRowBand;
+using Pixel = etchasketch::Image::Pixel;
+using GrayPixel = etchasketch::GrayImage::Pixel;
+using Weights = etchasketch::GrayscaleConverter::Weights;
+
+/*
+ * All models compute gray = (r*red + g*green + b*blue + bias) >> shift.
+ *
+ * The average is (r + g + b) * 21846 >> 16, which equals (r + g + b) / 3
+ * exactly for every sum up to 765. The luma weights are scaled to sum to
+ * 1 << 14 and rounded to nearest.
+ */
+static const Weights averageWeights = { 21846, 21846, 21846,    0, 16 };
+static const Weights rec601Weights  = {  4899,  9617,  1868, 8192, 14 };
+static const Weights rec709Weights  = {  3483, 11718,  1183, 8192, 14 };
+
+#pragma mark - Kernels
+
+static void
+convertRowScalar(const Pixel *src, GrayPixel *dst, size_t count,
+				 const Weights &w)
+{
+	for (size_t i = 0; i < count; i++) {
+		const Pixel color = src[i];
+		const uint32_t red   = (color >> 24) & 0xFF;
+		const uint32_t green = (color >> 16) & 0xFF;
+		const uint32_t blue  = (color >>  8) & 0xFF;
+		dst[i] = static_cast<GrayPixel>((red * w.red + green * w.green
+										 + blue * w.blue + w.bias) >> w.shift);
+	}
+}
+
+#if EAS_HAVE_SSE2
+
+/*
+ * The x86 kernels line up each channel in a 16-bit half of a 32-bit lane so a
+ * single madd does two multiplies and the add: red sits in the low half next
+ * to green in the high half, and blue sits next to a constant 1 that picks up
+ * the bias. Each lane ends up holding one gray value, which is then packed
+ * down to bytes.
+ */
+
+static inline __m128i
+grayPixelsSSE2(__m128i px, __m128i redGreenWeights, __m128i blueBiasWeights,
+			   __m128i shift)
+{
+	const __m128i byteMask = _mm_set1_epi32(0xFF);
+	const __m128i redGreen = _mm_or_si128(_mm_srli_epi32(px, 24),
+										  _mm_and_si128(px, _mm_set1_epi32(0x00FF0000)));
+	const __m128i blueOne = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(px, 8), byteMask),
+										 _mm_set1_epi32(0x00010000));
+	const __m128i sum = _mm_add_epi32(_mm_madd_epi16(redGreen, redGreenWeights),
+									  _mm_madd_epi16(blueOne, blueBiasWeights));
+	return _mm_srl_epi32(sum, shift);
+}
+
+static void
+convertRowSSE2(const Pixel *src, GrayPixel *dst, size_t count, const Weights &w)
+{
+	const __m128i redGreenWeights = _mm_set1_epi32((w.green << 16) | w.red);
+	const __m128i blueBiasWeights = _mm_set1_epi32((w.bias << 16) | w.blue);
+	const __m128i shift = _mm_cvtsi32_si128(w.shift);
+	size_t i = 0;
+	// 16 pixels per iteration.
+	for (; i + 16 <= count; i += 16) {
+		__m128i gray[4];
+		for (size_t j = 0; j < 4; j++) {
+			const __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i + 4 * j));
+			gray[j] = grayPixelsSSE2(px, redGreenWeights, blueBiasWeights, shift);
+		}
+		// Every value fits in a byte, so the saturating packs are exact.
+		const __m128i bytes = _mm_packus_epi16(_mm_packs_epi32(gray[0], gray[1]),
+											   _mm_packs_epi32(gray[2], gray[3]));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), bytes);
+	}
+	convertRowScalar(src + i, dst + i, count - i, w);
+}
+
+#endif // EAS_HAVE_SSE2
+
+#if EAS_HAVE_AVX2
+
+__attribute__((target("avx2")))
+static inline __m256i
+grayPixelsAVX2(__m256i px, __m256i redGreenWeights, __m256i blueBiasWeights,
+			   __m128i shift)
+{
+	const __m256i byteMask = _mm256_set1_epi32(0xFF);
+	const __m256i redGreen = _mm256_or_si256(_mm256_srli_epi32(px, 24),
+											 _mm256_and_si256(px, _mm256_set1_epi32(0x00FF0000)));
+	const __m256i blueOne = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(px, 8), byteMask),
+											_mm256_set1_epi32(0x00010000));
+	const __m256i sum = _mm256_add_epi32(_mm256_madd_epi16(redGreen, redGreenWeights),
+										 _mm256_madd_epi16(blueOne, blueBiasWeights));
+	return _mm256_srl_epi32(sum, shift);
+}
+
+__attribute__((target("avx2")))
+static void
+convertRowAVX2(const Pixel *src, GrayPixel *dst, size_t count, const Weights &w)
+{
+	const __m256i redGreenWeights = _mm256_set1_epi32((w.green << 16) | w.red);
+	const __m256i blueBiasWeights = _mm256_set1_epi32((w.bias << 16) | w.blue);
+	const __m128i shift = _mm_cvtsi32_si128(w.shift);
+	// The packs work within each 128-bit half, which leaves the groups of 4
+	// pixels interleaved between the halves. This puts them back in order.
+	const __m256i groupOrder = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+	size_t i = 0;
+	// 32 pixels per iteration.
+	for (; i + 32 <= count; i += 32) {
+		__m256i gray[4];
+		for (size_t j = 0; j < 4; j++) {
+			const __m256i px = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i + 8 * j));
+			gray[j] = grayPixelsAVX2(px, redGreenWeights, blueBiasWeights, shift);
+		}
+		const __m256i bytes = _mm256_packus_epi16(_mm256_packs_epi32(gray[0], gray[1]),
+												  _mm256_packs_epi32(gray[2], gray[3]));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i),
+							_mm256_permutevar8x32_epi32(bytes, groupOrder));
+	}
+	convertRowScalar(src + i, dst + i, count - i, w);
+}
+
+#endif // EAS_HAVE_AVX2
+
+#if EAS_HAVE_NEON
+
+/// Weigh 8 pixels' worth of channels and narrow the result to bytes.
+static inline uint8x8_t
+grayPixelsNEON(uint8x8_t red, uint8x8_t green, uint8x8_t blue,
+			   const Weights &w, int32x4_t negativeShift)
+{
+	const uint16x8_t red16 = vmovl_u8(red);
+	const uint16x8_t green16 = vmovl_u8(green);
+	const uint16x8_t blue16 = vmovl_u8(blue);
+	const uint32x4_t bias = vdupq_n_u32(static_cast<uint32_t>(w.bias));
+
+	uint32x4_t low = vmlal_n_u16(bias, vget_low_u16(red16),
+								 static_cast<uint16_t>(w.red));
+	low = vmlal_n_u16(low, vget_low_u16(green16), static_cast<uint16_t>(w.green));
+	low = vmlal_n_u16(low, vget_low_u16(blue16), static_cast<uint16_t>(w.blue));
+	low = vshlq_u32(low, negativeShift);
+
+	uint32x4_t high = vmlal_n_u16(bias, vget_high_u16(red16),
+								  static_cast<uint16_t>(w.red));
+	high = vmlal_n_u16(high, vget_high_u16(green16), static_cast<uint16_t>(w.green));
+	high = vmlal_n_u16(high, vget_high_u16(blue16), static_cast<uint16_t>(w.blue));
+	high = vshlq_u32(high, negativeShift);
+
+	return vmovn_u16(vcombine_u16(vmovn_u32(low), vmovn_u32(high)));
+}
+
+static void
+convertRowNEON(const Pixel *src, GrayPixel *dst, size_t count, const Weights &w)
+{
+	// Pixels are 0xRRGGBBAA words, so on a little-endian CPU each one is laid
+	// out in memory as A, B, G, R. vld4 splits those into separate planes.
+	const uint8_t *in = reinterpret_cast<const uint8_t *>(src);
+	const int32x4_t negativeShift = vdupq_n_s32(-w.shift);
+	size_t i = 0;
+	// 16 pixels per iteration.
+	for (; i + 16 <= count; i += 16) {
+		const uint8x16x4_t px = vld4q_u8(in + 4 * i);
+		const uint8x8_t grayLow = grayPixelsNEON(vget_low_u8(px.val[3]),
+												 vget_low_u8(px.val[2]),
+												 vget_low_u8(px.val[1]),
+												 w, negativeShift);
+		const uint8x8_t grayHigh = grayPixelsNEON(vget_high_u8(px.val[3]),
+												  vget_high_u8(px.val[2]),
+												  vget_high_u8(px.val[1]),
+												  w, negativeShift);
+		vst1q_u8(dst + i, vcombine_u8(grayLow, grayHigh));
+	}
+	convertRowScalar(src + i, dst + i, count - i, w);
+}
+
+#endif // EAS_HAVE_NEON
+
+#pragma mark -
+
+etchasketch::GrayscaleConverter::GrayscaleConverter(LuminanceModel model)
+: model(model), kernel(convertRowScalar), kernelName("scalar"),
+  threadPool(nullptr)
+{
+	switch (model) {
+		case LuminanceModel::Rec601:
+			weights = rec601Weights;
+			break;
+		case LuminanceModel::Rec709:
+			weights = rec709Weights;
+			break;
+		case LuminanceModel::Average:
+		default:
+			weights = averageWeights;
+			break;
+	}
+
+	// Pick the fastest kernel this CPU supports.
+#if EAS_HAVE_NEON
+	kernel = convertRowNEON;
+	kernelName = "NEON";
+#else
+#if EAS_HAVE_SSE2
+	kernel = convertRowSSE2;
+	kernelName = "SSE2";
+#endif
+#if EAS_HAVE_AVX2
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		kernel = convertRowAVX2;
+		kernelName = "AVX2";
+	}
+#endif
+#endif
+}
+
+void
+etchasketch::GrayscaleConverter::convertRow(const Pixel *src, GrayPixel *dst,
+											size_t count) const
+{
+	kernel(src, dst, count, weights);
+}
+
+void
+etchasketch::GrayscaleConverter::convert(const Image &src, GrayImage &dst) const
+{
+	if ((src.getWidth() != dst.getWidth()) ||
+		(src.getHeight() != dst.getHeight()))
+	{
+		invalid_argument e("Grayscale destination size doesn't match source");
+		throw e;
+	}
+	const size_t width = src.getWidth();
+	forEachRowBand(threadPool, 0, src.getHeight(),
+				   [&](size_t firstRow, size_t lastRow) {
+		forEachRow(firstRow, lastRow, [&](size_t y) {
+			convertRow(src.getRow(y), dst.getRow(y), width);
+		});
+	});
+}
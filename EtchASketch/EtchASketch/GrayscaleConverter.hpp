@@ -0,0 +1,99 @@
+//
+//  GrayscaleConverter.hpp
+//  EtchASketch
+//
+
+#ifndef GrayscaleConverter_hpp
+#define GrayscaleConverter_hpp
+
+#include <stddef.h>
+#include "Image.hpp"
+#include "ThreadPool.hpp"
+
+namespace etchasketch {
+
+/// How the color channels are weighted when converting to grayscale.
+enum class LuminanceModel {
+	/// The plain mean of the red, green, and blue components.
+	Average,
+
+	/// ITU-R BT.601 luma: 0.299 R + 0.587 G + 0.114 B.
+	Rec601,
+
+	/// ITU-R BT.709 luma: 0.2126 R + 0.7152 G + 0.0722 B.
+	Rec709,
+};
+
+/**
+ * Converts RGBA images to single-channel grayscale.
+ *
+ * Every model is evaluated in fixed point, so the vectorized kernels produce
+ * exactly the same output as the scalar one. The fastest kernel supported by
+ * the CPU (AVX2 or SSE2 on x86, NEON on ARM) is picked once, at
+ * construction.
+ */
+class GrayscaleConverter {
+public:
+	/// Create a new converter that uses the given luminance model.
+	GrayscaleConverter(LuminanceModel model = LuminanceModel::Average);
+
+	/// The luminance model in use.
+	inline LuminanceModel getLuminanceModel() const
+		{ return model; }
+
+	/**
+	 * Run @c convert() on the threads of @c pool, or on the calling thread if
+	 * it's @c nullptr. The pool isn't owned, and must outlive its use here.
+	 */
+	inline void setThreadPool(etchasketch::ThreadPool *pool)
+		{ threadPool = pool; }
+
+	/// The name of the kernel picked for this CPU, for logging.
+	inline const char *getKernelName() const
+		{ return kernelName; }
+
+	/// Convert @c count RGBA pixels to 8-bit luminance values.
+	void convertRow(const etchasketch::Image::Pixel *src,
+					etchasketch::GrayImage::Pixel *dst,
+					size_t count) const;
+
+	/**
+	 * Convert a whole image. @c dst must be the same size as @c src.
+	 */
+	void convert(const etchasketch::Image &src,
+				 etchasketch::GrayImage &dst) const;
+
+	/// The fixed-point weights for a luminance model.
+	struct Weights {
+		/// Per-channel multipliers. Each must fit in an int16_t.
+		int32_t red, green, blue;
+		/// Added to the weighted sum before shifting, for rounding.
+		int32_t bias;
+		/// The weighted sum is shifted right by this many bits.
+		int32_t shift;
+	};
+
+	/// A kernel that converts a row of pixels.
+	typedef void (*RowKernel)(const etchasketch::Image::Pixel *src,
+							  etchasketch::GrayImage::Pixel *dst,
+							  size_t count,
+							  const Weights &weights);
+
+private:
+	LuminanceModel model;
+
+	Weights weights;
+
+	/// The kernel picked for this CPU.
+	RowKernel kernel;
+
+	/// The name of @c kernel.
+	const char *kernelName;
+
+	/// The pool to run on, or @c nullptr to run on the calling thread.
+	etchasketch::ThreadPool *threadPool;
+};
+
+}
+
+#endif /* GrayscaleConverter_hpp */
@@ -0,0 +1,276 @@
+//
+//  GridIndex.cpp
+//  EtchASketch
+//
+
+#include "GridIndex.hpp"
+#include <algorithm>
+#include <cmath>
+#include <initializer_list>
+
+using std::vector;
+using etchasketch::KDPoint;
+using etchasketch::KDPointCoordinate;
+
+namespace {
+
+/// Divide, rounding toward negative infinity.
+inline ptrdiff_t
+floorDivide(ptrdiff_t numerator, ptrdiff_t denominator)
+{
+	const ptrdiff_t quotient = numerator / denominator;
+	return ((numerator % denominator) < 0) ? (quotient - 1) : quotient;
+}
+
+}
+
+#pragma mark - Constructors
+
+etchasketch::GridIndex::GridIndex()
+: cellSize(0), originX(0), originY(0), columns(0), rows(0),
+  points(), cellStarts(1, 0), cellLiveCounts(), liveCount(0)
+{ }
+
+etchasketch::GridIndex::GridIndex(const vector<KDPoint<2>> &newPoints,
+								  size_t cellSize)
+: GridIndex()
+{
+	this->cellSize = cellSize;
+	// Drop any duplicates.
+	vector<KDPoint<2>> uniquePoints(newPoints);
+	std::sort(uniquePoints.begin(), uniquePoints.end());
+	uniquePoints.erase(std::unique(uniquePoints.begin(), uniquePoints.end()),
+					   uniquePoints.end());
+	build(uniquePoints);
+}
+
+void
+etchasketch::GridIndex::build(const vector<KDPoint<2>> &newPoints)
+{
+	points.clear();
+	liveCount = newPoints.size();
+	if (newPoints.empty()) {
+		columns = rows = 0;
+		cellStarts.assign(1, 0);
+		cellLiveCounts.clear();
+		return;
+	}
+
+	// Fit the grid to the points.
+	KDPointCoordinate minX = newPoints[0][0], maxX = minX;
+	KDPointCoordinate minY = newPoints[0][1], maxY = minY;
+	for (const KDPoint<2> &point : newPoints) {
+		minX = std::min(minX, point[0]);
+		maxX = std::max(maxX, point[0]);
+		minY = std::min(minY, point[1]);
+		maxY = std::max(maxY, point[1]);
+	}
+	originX = minX;
+	originY = minY;
+	if (0 == cellSize) {
+		const double area = (static_cast<double>(maxX - minX) + 1.0)
+						  * (static_cast<double>(maxY - minY) + 1.0);
+		const double size = std::sqrt(area * pointsPerCell / newPoints.size());
+		cellSize = std::max(static_cast<size_t>(size + 0.5), static_cast<size_t>(1));
+	}
+	columns = static_cast<size_t>(maxX - minX) / cellSize + 1;
+	rows = static_cast<size_t>(maxY - minY) / cellSize + 1;
+
+	// Counting sort the points by cell.
+	const size_t cellCount = columns * rows;
+	cellLiveCounts.assign(cellCount, 0);
+	for (const KDPoint<2> &point : newPoints) {
+		cellLiveCounts[cellIndex(point)]++;
+	}
+	cellStarts.resize(cellCount + 1);
+	cellStarts[0] = 0;
+	for (size_t cell = 0; cell < cellCount; cell++) {
+		cellStarts[cell + 1] = cellStarts[cell] + cellLiveCounts[cell];
+	}
+	points.resize(newPoints.size());
+	vector<uint32_t> nextSlots(cellStarts.begin(), cellStarts.end() - 1);
+	for (const KDPoint<2> &point : newPoints) {
+		points[nextSlots[cellIndex(point)]++] = point;
+	}
+}
+
+#pragma mark -
+
+size_t
+etchasketch::GridIndex::cellIndex(const KDPoint<2> &point) const
+{
+	const KDPointCoordinate x = point[0], y = point[1];
+	if ((0 == columns) || (x < originX) || (y < originY)) {
+		return columns * rows;
+	}
+	const size_t column = static_cast<size_t>(x - originX) / cellSize;
+	const size_t row = static_cast<size_t>(y - originY) / cellSize;
+	if ((column >= columns) || (row >= rows)) {
+		return columns * rows;
+	}
+	return column + row * columns;
+}
+
+size_t
+etchasketch::GridIndex::find(size_t first, size_t last,
+							 const KDPoint<2> &query) const
+{
+	for (size_t i = first; i < last; i++) {
+		if (points[i] == query) {
+			return i;
+		}
+	}
+	return points.size();
+}
+
+#pragma mark - Find nearest neighbor
+
+bool
+etchasketch::GridIndex::findNearestNeighbor(const KDPoint<2> &query,
+											KDPoint<2> &nearest, // out
+											float *squaredDistance) const // out
+{
+	if (0 == liveCount) {
+		return false;
+	}
+	const ptrdiff_t size = static_cast<ptrdiff_t>(cellSize);
+	const ptrdiff_t lastColumn = static_cast<ptrdiff_t>(columns) - 1;
+	const ptrdiff_t lastRow = static_cast<ptrdiff_t>(rows) - 1;
+	// The cell the query is in, which may be off the grid.
+	const ptrdiff_t queryColumn = floorDivide(query[0] - originX, size);
+	const ptrdiff_t queryRow = floorDivide(query[1] - originY, size);
+	// Past this ring, there are no cells left.
+	const ptrdiff_t lastRing = std::max(std::max(queryColumn, lastColumn - queryColumn),
+										std::max(queryRow, lastRow - queryRow));
+
+	const KDPoint<2> *best = nullptr;
+	float bestDist = 0.0f;
+	for (ptrdiff_t ring = 0; ring <= lastRing; ring++) {
+		if ((nullptr != best) && (ring > 0)) {
+			// Every point in this ring is at least this far off along one
+			// axis. Keep going on a tie, which might go to a smaller point.
+			const float minDist = static_cast<float>((ring - 1) * size + 1);
+			if (minDist * minDist > bestDist) {
+				break;
+			}
+		}
+		const ptrdiff_t top = queryRow - ring, bottom = queryRow + ring;
+		const ptrdiff_t left = queryColumn - ring, right = queryColumn + ring;
+		const ptrdiff_t firstColumn = std::max(left, static_cast<ptrdiff_t>(0));
+		const ptrdiff_t endColumn = std::min(right, lastColumn);
+		// The top and bottom edges of the ring, corners included.
+		for (ptrdiff_t row : { top, bottom }) {
+			if ((row < 0) || (row > lastRow)) {
+				continue;
+			}
+			for (ptrdiff_t column = firstColumn; column <= endColumn; column++) {
+				searchCell(column + row * columns, query, best, bestDist);
+			}
+			if (0 == ring) {
+				// Both edges are the same row.
+				break;
+			}
+		}
+		// The left and right edges, between the corners.
+		const ptrdiff_t firstRow = std::max(top + 1, static_cast<ptrdiff_t>(0));
+		const ptrdiff_t endRow = std::min(bottom - 1, lastRow);
+		for (ptrdiff_t column : { left, right }) {
+			if ((column < 0) || (column > lastColumn)) {
+				continue;
+			}
+			for (ptrdiff_t row = firstRow; row <= endRow; row++) {
+				searchCell(column + row * columns, query, best, bestDist);
+			}
+		}
+	}
+
+	nearest = *best;
+	if (nullptr != squaredDistance) {
+		*squaredDistance = bestDist;
+	}
+	return true;
+}
+
+void
+etchasketch::GridIndex::searchCell(size_t cell, const KDPoint<2> &query,
+								   const KDPoint<2> *&best, // inout
+								   float &bestDist) const // inout
+{
+	const size_t first = cellStarts[cell];
+	const size_t last = first + cellLiveCounts[cell];
+	for (size_t i = first; i < last; i++) {
+		const float dist = query.distanceTo(points[i]);
+		if ((nullptr == best) || (dist < bestDist)
+			|| ((dist == bestDist) && (points[i] < *best))) {
+			best = &points[i];
+			bestDist = dist;
+		}
+	}
+}
+
+#pragma mark - Modification
+
+bool
+etchasketch::GridIndex::contains(const KDPoint<2> &query) const
+{
+	const size_t cell = cellIndex(query);
+	if (cell >= columns * rows) {
+		return false;
+	}
+	const size_t first = cellStarts[cell];
+	return find(first, first + cellLiveCounts[cell], query) < points.size();
+}
+
+bool
+etchasketch::GridIndex::insert(const KDPoint<2> &newPoint)
+{
+	const size_t cell = cellIndex(newPoint);
+	if (cell < columns * rows) {
+		const size_t first = cellStarts[cell];
+		const size_t firstRemoved = first + cellLiveCounts[cell];
+		if (find(first, firstRemoved, newPoint) < points.size()) {
+			// It's already here.
+			return false;
+		}
+		const size_t index = find(firstRemoved, cellStarts[cell + 1], newPoint);
+		if (index < points.size()) {
+			// Bring it back.
+			std::swap(points[index], points[firstRemoved]);
+			cellLiveCounts[cell]++;
+			liveCount++;
+			return true;
+		}
+	}
+
+	// There's no room for it, so start over with it included.
+	vector<KDPoint<2>> livePoints;
+	livePoints.reserve(liveCount + 1);
+	for (size_t i = 0; i < columns * rows; i++) {
+		const size_t first = cellStarts[i];
+		livePoints.insert(livePoints.end(), points.begin() + first,
+						  points.begin() + first + cellLiveCounts[i]);
+	}
+	livePoints.push_back(newPoint);
+	build(livePoints);
+	return true;
+}
+
+bool
+etchasketch::GridIndex::remove(const KDPoint<2> &target)
+{
+	const size_t cell = cellIndex(target);
+	if (cell >= columns * rows) {
+		return false;
+	}
+	const size_t first = cellStarts[cell];
+	const size_t firstRemoved = first + cellLiveCounts[cell];
+	const size_t index = find(first, firstRemoved, target);
+	if (index >= points.size()) {
+		return false;
+	}
+	// Swap it behind the live points.
+	std::swap(points[index], points[firstRemoved - 1]);
+	cellLiveCounts[cell]--;
+	liveCount--;
+	return true;
+}
@@ -0,0 +1,141 @@
+//
+//  GridIndex.hpp
+//  EtchASketch
+//
+
+#ifndef GridIndex_hpp
+#define GridIndex_hpp
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "KDPoint.hpp"
+
+namespace etchasketch {
+
+/**
+ * A set of 2D integer points bucketed into a uniform grid of square cells,
+ * with the same query and removal interface as @c KDTree<2>.
+ *
+ * Edge points are pixels packed into a bounded raster, so rather than
+ * splitting space around the points, the grid splits it into fixed cells.
+ * All the points are stored in one array, grouped by cell, and each cell
+ * keeps its live points at the front of its range. Removing a point swaps it
+ * behind the live ones, so it costs a scan of one cell. A nearest neighbor
+ * search checks the query's cell and then rings of cells around it, and
+ * stops as soon as the next ring can't hold anything closer. When the tour
+ * is locally dense, that's the first ring or two.
+ *
+ * Nearest neighbors, ties and all, are the same ones @c KDTree<2> finds.
+ */
+class GridIndex {
+public:
+	/// Create an empty index.
+	GridIndex();
+
+	/**
+	 * Create an index over @c newPoints. Duplicates are dropped.
+	 *
+	 * @param cellSize The edge length of a cell, in pixels. Larger cells
+	 *  mean fewer rings to search but more points to check in each. Pass 0
+	 *  to size the cells so they'd hold @c pointsPerCell points each if the
+	 *  points were spread evenly.
+	 */
+	GridIndex(const std::vector<etchasketch::KDPoint<2>> &newPoints,
+			  size_t cellSize = 0);
+
+	/// The average number of points per cell when the cell size is picked.
+	static const size_t pointsPerCell = 2;
+
+	/**
+	 * Find the closest point to @c query, breaking ties in distance with
+	 * @c KDPoint::operator<().
+	 *
+	 * @param query The point to find the closest neighbor of.
+	 * @param nearest Set to the closest point to @c query. Left alone if
+	 *  the index is empty.
+	 * @param squaredDistance If not @c nullptr, set to the square of the
+	 *  distance from @c query to @c nearest.
+	 * @return @c true if a nearest neighbor was found, or @c false if the
+	 *  index is empty.
+	 */
+	bool findNearestNeighbor(const etchasketch::KDPoint<2> &query,
+							 etchasketch::KDPoint<2> &nearest, // out
+							 float *squaredDistance = nullptr) const; // out
+
+	/// Whether the index holds @c query.
+	bool contains(const etchasketch::KDPoint<2> &query) const;
+
+	/**
+	 * Insert a new point. Bringing back a removed point is as cheap as
+	 * removing it, but a point the index has never held forces a rebuild.
+	 *
+	 * @return @c true on success, or @c false if @c newPoint already exists.
+	 */
+	bool insert(const etchasketch::KDPoint<2> &newPoint);
+
+	/**
+	 * Remove a point.
+	 * @return @c true if @c target was removed, or @c false if it wasn't in
+	 *  the index.
+	 */
+	bool remove(const etchasketch::KDPoint<2> &target);
+
+	/// The number of points in the index.
+	inline size_t size() const
+		{ return liveCount; }
+
+private:
+	/// The edge length of a cell, in pixels, or 0 if it's yet to be picked.
+	size_t cellSize;
+
+	/// The coordinates of the top-left corner of cell (0, 0).
+	etchasketch::KDPointCoordinate originX, originY;
+
+	/// The size of the grid, in cells.
+	size_t columns, rows;
+
+	/**
+	 * Every point the index holds or has held, grouped by cell. The points
+	 * of cell @c i are in [@c cellStarts[i], @c cellStarts[i + 1]), with the
+	 * live ones first.
+	 */
+	std::vector<etchasketch::KDPoint<2>> points;
+
+	/// Where each cell's points start in @c points, plus one past the end.
+	std::vector<uint32_t> cellStarts;
+
+	/// The number of live points in each cell.
+	std::vector<uint32_t> cellLiveCounts;
+
+	/// The number of live points in the whole index.
+	size_t liveCount;
+
+	/**
+	 * Build the grid over @c newPoints, which hold no duplicates. If
+	 * @c cellSize is 0, pick one.
+	 */
+	void build(const std::vector<etchasketch::KDPoint<2>> &newPoints);
+
+	/**
+	 * The cell @c point falls in, or @c columns * @c rows if it's outside
+	 * the grid.
+	 */
+	size_t cellIndex(const etchasketch::KDPoint<2> &point) const;
+
+	/**
+	 * The index of @c query in [@c first, @c last) of @c points, or
+	 * @c points.size() if it isn't there.
+	 */
+	size_t find(size_t first, size_t last,
+				const etchasketch::KDPoint<2> &query) const;
+
+	/// Check the live points of a cell for one closer than @c best.
+	void searchCell(size_t cell, const etchasketch::KDPoint<2> &query,
+					const etchasketch::KDPoint<2> *&best, // inout
+					float &bestDist) const; // inout
+};
+
+}
+
+#endif /* GridIndex_hpp */
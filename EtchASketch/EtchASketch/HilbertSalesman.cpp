@@ -0,0 +1,126 @@
+//
+//  HilbertSalesman.cpp
+//  EtchASketch
+//
+
+#include "HilbertSalesman.hpp"
+#include "EASUtils+Private.hpp"
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+using std::vector;
+using etchasketch::EdgePointBuffer;
+using etchasketch::KDPoint;
+using etchasketch::KDPointCoordinate;
+
+namespace {
+
+/// How many bits of the curve index each radix sort pass sorts by.
+const unsigned bitsPerPass = 11;
+
+/**
+ * Sort @c keys by their high 32 bits, of which only the low @c keyBits can
+ * be set, with an LSD radix sort.
+ */
+void
+sortByHighHalf(vector<uint64_t> &keys, unsigned keyBits)
+{
+	const size_t bucketCount = static_cast<size_t>(1) << bitsPerPass;
+	vector<uint64_t> sorted(keys.size());
+	for (unsigned shift = 32; shift < 32 + keyBits; shift += bitsPerPass) {
+		vector<size_t> bucketStarts(bucketCount + 1, 0);
+		for (uint64_t key : keys) {
+			bucketStarts[((key >> shift) & (bucketCount - 1)) + 1]++;
+		}
+		for (size_t bucket = 0; bucket < bucketCount; bucket++) {
+			bucketStarts[bucket + 1] += bucketStarts[bucket];
+		}
+		for (uint64_t key : keys) {
+			sorted[bucketStarts[(key >> shift) & (bucketCount - 1)]++] = key;
+		}
+		keys.swap(sorted);
+	}
+}
+
+}
+
+namespace etchasketch {
+namespace salesman {
+
+HilbertSalesman::HilbertSalesman(const EdgePointBuffer &unorderedPoints,
+								 const KDPoint<2> &startPoint)
+	: Salesman(), startPoint(startPoint), unorderedPoints(unorderedPoints)
+{
+}
+
+HilbertSalesman::~HilbertSalesman()
+{
+}
+
+uint32_t
+HilbertSalesman::curveIndex(uint32_t x, uint32_t y, unsigned order)
+{
+	const uint32_t side = static_cast<uint32_t>(1) << order;
+	uint32_t index = 0;
+	for (uint32_t quadrantSize = side / 2; quadrantSize > 0; quadrantSize /= 2) {
+		const uint32_t right = (x & quadrantSize) ? 1 : 0;
+		const uint32_t bottom = (y & quadrantSize) ? 1 : 0;
+		index += quadrantSize * quadrantSize * ((3 * right) ^ bottom);
+		// Turn the quadrant to match the curve's orientation within it.
+		if (0 == bottom) {
+			if (1 == right) {
+				x = side - 1 - x;
+				y = side - 1 - y;
+			}
+			std::swap(x, y);
+		}
+	}
+	return index;
+}
+
+void
+HilbertSalesman::orderPoints()
+{
+	if (!unorderedPoints.contains(startPoint[0], startPoint[1])) {
+		EASLog("Error: unorderedPoints does not contain the starting point");
+		exit(1);
+	}
+	const size_t pointCount = unorderedPoints.size();
+	// The smallest square that holds the points.
+	EdgePointBuffer::Coordinate largest = 0;
+	for (size_t i = 0; i < pointCount; i++) {
+		largest = std::max(largest, std::max(unorderedPoints.getX(i), unorderedPoints.getY(i)));
+	}
+	unsigned order = 1;
+	while ((static_cast<uint32_t>(1) << order) <= largest) {
+		order++;
+	}
+
+	// Sort by curve index, carrying the point along in the low half so
+	// reading them back out goes straight through memory.
+	vector<uint64_t> keys(pointCount);
+	for (size_t i = 0; i < pointCount; i++) {
+		const uint32_t x = unorderedPoints.getX(i), y = unorderedPoints.getY(i);
+		keys[i] = (static_cast<uint64_t>(curveIndex(x, y, order)) << 32) | (x << 16) | y;
+	}
+	sortByHighHalf(keys, 2 * order);
+
+	// Start at the start point, and come back around to the beginning of the
+	// curve after the end.
+	const uint32_t startKey = (static_cast<uint32_t>(startPoint[0]) << 16)
+							  | static_cast<uint32_t>(startPoint[1]);
+	const auto start = std::find_if(keys.begin(), keys.end(), [startKey](uint64_t key) {
+		return static_cast<uint32_t>(key) == startKey;
+	});
+	std::rotate(keys.begin(), start, keys.end());
+	orderedPoints.clear();
+	orderedPoints.reserve(pointCount);
+	for (uint64_t key : keys) {
+		orderedPoints.push_back(KDPoint<2>(static_cast<KDPointCoordinate>((key >> 16) & 0xFFFF),
+										   static_cast<KDPointCoordinate>(key & 0xFFFF)));
+	}
+}
+
+}
+}
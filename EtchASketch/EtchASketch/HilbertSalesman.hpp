@@ -0,0 +1,62 @@
+//
+//  HilbertSalesman.hpp
+//  EtchASketch
+//
+
+#ifndef HilbertSalesman_hpp
+#define HilbertSalesman_hpp
+
+#include <stddef.h>
+#include <stdint.h>
+#include "Salesman.hpp"
+#include "EdgePointBuffer.hpp"
+#include "KDPoint.hpp"
+
+namespace etchasketch {
+namespace salesman {
+
+/**
+ * Draws the points in the order a Hilbert curve passes through them.
+ *
+ * The Hilbert curve fills the square one quadrant at a time, each quadrant
+ * a smaller copy of the whole, so points close along the curve are close
+ * in the image. Ordering is just sorting the points by their distance along
+ * the curve, which takes a radix sort, so there's no searching at all and
+ * millions of points take a fraction of a second.
+ *
+ * The path is longer than a greedy one, since the curve jumps wherever it
+ * leaves an edge, so this is best for previews, or as a quick starting
+ * point for @c TourOptimizer.
+ */
+class HilbertSalesman : public Salesman {
+  public:
+	/**
+	 * The startPoint must be contained within the unorderedPoints, which
+	 * must outlive the salesman. The order is rotated so it starts there.
+	 */
+	HilbertSalesman(const EdgePointBuffer &unorderedPoints,
+					const KDPoint<2> &startPoint);
+
+	virtual ~HilbertSalesman();
+
+	/// Order the points for the best drawing order.
+	virtual void orderPoints();
+
+	/**
+	 * The distance along a Hilbert curve filling a square @c 2^order pixels
+	 * on a side to (@c x, @c y), which must be in the square.
+	 */
+	static uint32_t curveIndex(uint32_t x, uint32_t y, unsigned order);
+
+  private:
+	/// The point at which we begin drawing.
+	const KDPoint<2> startPoint;
+
+	/// The points to put in order.
+	const EdgePointBuffer &unorderedPoints;
+};
+
+}
+}
+
+#endif /* HilbertSalesman_hpp */
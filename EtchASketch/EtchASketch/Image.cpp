@@ -7,15 +7,18 @@
 //
 
 #include "Image.hpp"
+#include <cstring>
 
 using std::out_of_range;
-using Pixel = etchasketch::Image::Pixel;
+using etchasketch::BasicImage;
+using etchasketch::ImageRegion;
 using etchasketch::KDPoint;
 
-etchasketch::Image::Image(size_t width, size_t height, const Pixel *data)
+template<typename PixelT>
+BasicImage<PixelT>::BasicImage(size_t width, size_t height, const PixelT *data)
 : width(width), height(height)
 {
-	this->data = new Pixel[getPixelCount()];
+	this->data = new PixelT[getPixelCount()];
 	if (nullptr == this->data) {
 		this->width = 0;
 		this->height = 0;
@@ -23,24 +26,26 @@ etchasketch::Image::Image(size_t width, size_t height, const Pixel *data)
 		return;
 	}
 	if (nullptr != data) {
-		memcpy(this->data, data, getPixelCount() * sizeof(Pixel));
+		memcpy(this->data, data, getPixelCount() * sizeof(PixelT));
 	} else {
-		memset(this->data, 0, getPixelCount() * sizeof(Pixel));
+		memset(this->data, 0, getPixelCount() * sizeof(PixelT));
 	}
 	return;
 }
 
-etchasketch::Image::Image(const etchasketch::Image &other)
+template<typename PixelT>
+BasicImage<PixelT>::BasicImage(const BasicImage<PixelT> &other)
 : width(other.getWidth()), height(other.getHeight())
 {
-	data = new Pixel[other.getPixelCount()];
+	data = new PixelT[other.getPixelCount()];
 	if (nullptr != data) {
-		memcpy(data, other.data, getPixelCount() * sizeof(Pixel));
+		memcpy(data, other.data, getPixelCount() * sizeof(PixelT));
 	}
 }
 
-etchasketch::Image &
-etchasketch::Image::operator=(const etchasketch::Image &that)
+template<typename PixelT>
+BasicImage<PixelT> &
+BasicImage<PixelT>::operator=(const BasicImage<PixelT> &that)
 {
 	if (this == &that) { // Safety first
 		return *this;
@@ -50,12 +55,13 @@ etchasketch::Image::operator=(const etchasketch::Image &that)
 	height = that.getHeight();
 	delete [] data;
 	const size_t pxCount = that.getPixelCount();
-	data = new Pixel[pxCount];
-	memcpy(data, that.getData(), pxCount * sizeof(Pixel));
+	data = new PixelT[pxCount];
+	memcpy(data, that.getData(), pxCount * sizeof(PixelT));
 	return *this;
 }
 
-etchasketch::Image::~Image()
+template<typename PixelT>
+BasicImage<PixelT>::~BasicImage()
 {
 	delete [] data;
 	data = nullptr;
@@ -72,18 +78,56 @@ etchasketch::Image::~Image()
 	} \
 } while (0)
 
-Pixel
-etchasketch::Image::operator[](const KDPoint<2> &index) const
+template<typename PixelT>
+PixelT
+BasicImage<PixelT>::operator[](const KDPoint<2> &index) const
 {
 	VALIDATE_INDEX(index);
 	size_t dataIndex = index[0] + (index[1] * width);
 	return data[dataIndex];
 }
 
-Pixel &
-etchasketch::Image::operator[](const KDPoint<2> &index)
+template<typename PixelT>
+PixelT &
+BasicImage<PixelT>::operator[](const KDPoint<2> &index)
 {
 	VALIDATE_INDEX(index);
 	size_t dataIndex = index[0] + (index[1] * width);
 	return data[dataIndex];
 }
+
+#define VALIDATE_REGION(x, y, regionWidth, regionHeight) do { \
+	if ((x) > getWidth() || (regionWidth) > getWidth() - (x)) { \
+		out_of_range e("Invalid region X bounds"); \
+		throw e; \
+	} \
+	if ((y) > getHeight() || (regionHeight) > getHeight() - (y)) { \
+		out_of_range e("Invalid region Y bounds"); \
+		throw e; \
+	} \
+} while (0)
+
+template<typename PixelT>
+ImageRegion<const PixelT>
+BasicImage<PixelT>::getRegion(size_t x, size_t y,
+							  size_t regionWidth, size_t regionHeight) const
+{
+	VALIDATE_REGION(x, y, regionWidth, regionHeight);
+	return ImageRegion<const PixelT>(getRow(y) + x, regionWidth, regionHeight,
+									 getStride());
+}
+
+template<typename PixelT>
+ImageRegion<PixelT>
+BasicImage<PixelT>::getRegion(size_t x, size_t y,
+							  size_t regionWidth, size_t regionHeight)
+{
+	VALIDATE_REGION(x, y, regionWidth, regionHeight);
+	return ImageRegion<PixelT>(getRow(y) + x, regionWidth, regionHeight,
+							   getStride());
+}
+
+#pragma mark - Instantiations
+
+template struct etchasketch::BasicImage<uint32_t>;
+template struct etchasketch::BasicImage<uint8_t>;
@@ -9,16 +9,108 @@
 #ifndef Image_hpp
 #define Image_hpp
 
+#include <stddef.h>
 #include <stdint.h>
 #include "KDPoint.hpp"
 
 namespace etchasketch {
 
-/// The backing store of a single image.
-struct Image {
+/**
+ * A contiguous run of pixels within a single row of an image.
+ *
+ * Spans are not bounds checked. They're handed out by @c Image and
+ * @c ImageRegion, which do any validation up front.
+ */
+template<typename PixelT>
+struct PixelSpan {
   public:
-	/// A pixel in RGBA format.
-	typedef uint32_t Pixel;
+	PixelSpan(PixelT *pixels, size_t length)
+	: pixels(pixels), length(length)
+	{ }
+
+	/// The number of pixels in the span.
+	inline size_t size() const
+		{ return length; }
+
+	inline PixelT *begin() const
+		{ return pixels; }
+
+	inline PixelT *end() const
+		{ return pixels + length; }
+
+	/// Get the pixel at offset @c x from the start of the span. Unchecked.
+	inline PixelT &operator[](size_t x) const
+		{ return pixels[x]; }
+
+  private:
+	PixelT *pixels;
+	size_t length;
+};
+
+/**
+ * A rectangular window onto an image's pixels.
+ *
+ * The window's bounds are validated once, when it's created by
+ * @c Image::getRegion(). Accesses through the region are relative to its
+ * top-left corner and are not bounds checked.
+ */
+template<typename PixelT>
+struct ImageRegion {
+  public:
+	/**
+	 * @param origin The top-left pixel of the region.
+	 * @param width The width of the region, in pixels.
+	 * @param height The height of the region, in pixels.
+	 * @param stride The distance between vertically adjacent pixels, in
+	 * pixels.
+	 */
+	ImageRegion(PixelT *origin, size_t width, size_t height, size_t stride)
+	: origin(origin), width(width), height(height), stride(stride)
+	{ }
+
+	/// The width of the region, in pixels.
+	inline size_t getWidth() const
+		{ return width; }
+
+	/// The height of the region, in pixels.
+	inline size_t getHeight() const
+		{ return height; }
+
+	/// The distance between vertically adjacent pixels, in pixels.
+	inline size_t getStride() const
+		{ return stride; }
+
+	/// Get a pointer to the first pixel of row @c y of the region. Unchecked.
+	inline PixelT *getRow(size_t y) const
+		{ return origin + (y * stride); }
+
+	/// Get row @c y of the region as a span. Unchecked.
+	inline PixelSpan<PixelT> getRowSpan(size_t y) const
+		{ return PixelSpan<PixelT>(getRow(y), width); }
+
+	/// Get the pixel at (@c x, @c y) relative to the region. Unchecked.
+	inline PixelT &operator()(size_t x, size_t y) const
+		{ return getRow(y)[x]; }
+
+  private:
+	PixelT *origin;
+	size_t width;
+	size_t height;
+	size_t stride;
+};
+
+/**
+ * The backing store of a single image.
+ *
+ * @c PixelT is the type of one pixel. Color images use @c Image, with one
+ * 32-bit RGBA word per pixel; the grayscale stages use @c GrayImage, with
+ * one byte per pixel, which is a quarter of the memory traffic.
+ */
+template<typename PixelT>
+struct BasicImage {
+  public:
+	/// The type of one pixel.
+	typedef PixelT Pixel;
 
 	// TODO: Add spec for the format of the data buffer.
 	/**
@@ -29,14 +121,14 @@ struct Image {
 	 * @param data A raw pixel buffer. The data is copied out into the
 	 * Image's own internal buffer.
 	 */
-	Image(size_t width, size_t height, const Pixel *data = nullptr);
+	BasicImage(size_t width, size_t height, const Pixel *data = nullptr);
 
 	/// Deep copy another image.
-	Image(const etchasketch::Image &other);
+	BasicImage(const BasicImage &other);
 	
-	Image & operator=(const Image &that);
+	BasicImage & operator=(const BasicImage &that);
 
-	virtual ~Image();
+	virtual ~BasicImage();
 
 	/// Whether this is a valid, visually representable image.
 	inline bool isValid() const
@@ -56,6 +148,60 @@ struct Image {
 	/// Get the @c Pixel at the given point.
 	Pixel &operator[](const etchasketch::KDPoint<2> &index);
 
+	/*
+	 * Unchecked row access, for hot loops. Pixels are stored row-major, so
+	 * walking along a row touches contiguous memory. The caller is
+	 * responsible for keeping coordinates within the image; use
+	 * @c getRegion() to validate a window once up front.
+	 */
+
+	/// The distance between vertically adjacent pixels, in pixels.
+	inline size_t getStride() const
+		{ return width; }
+
+	/// Get a pointer to the first pixel of row @c y. Unchecked.
+	inline const Pixel *getRow(size_t y) const
+		{ return data + (y * getStride()); }
+
+	/// Get a pointer to the first pixel of row @c y. Unchecked.
+	inline Pixel *getRow(size_t y)
+		{ return data + (y * getStride()); }
+
+	/// Get row @c y as a span. Unchecked.
+	inline PixelSpan<const Pixel> getRowSpan(size_t y) const
+		{ return PixelSpan<const Pixel>(getRow(y), width); }
+
+	/// Get row @c y as a span. Unchecked.
+	inline PixelSpan<Pixel> getRowSpan(size_t y)
+		{ return PixelSpan<Pixel>(getRow(y), width); }
+
+	/// Get the @c Pixel at (@c x, @c y). Unchecked.
+	inline Pixel pixelAt(size_t x, size_t y) const
+		{ return getRow(y)[x]; }
+
+	/// Get the @c Pixel at (@c x, @c y). Unchecked.
+	inline Pixel &pixelAt(size_t x, size_t y)
+		{ return getRow(y)[x]; }
+
+	/**
+	 * Get a view of a rectangular window of the image.
+	 *
+	 * @throws std::out_of_range if the window doesn't lie entirely within
+	 * the image.
+	 */
+	ImageRegion<const Pixel> getRegion(size_t x, size_t y,
+									   size_t regionWidth,
+									   size_t regionHeight) const;
+
+	/**
+	 * Get a mutable view of a rectangular window of the image.
+	 *
+	 * @throws std::out_of_range if the window doesn't lie entirely within
+	 * the image.
+	 */
+	ImageRegion<Pixel> getRegion(size_t x, size_t y,
+								 size_t regionWidth, size_t regionHeight);
+
 	// For the Objective-C wrapper.
 
 	/// Get a pointer to the data buffer used by this image.
@@ -80,6 +226,13 @@ struct Image {
 	 */
 	Pixel *data;
 };
+
+/// An image with one RGBA pixel, 0xRRGGBBAA, per 32-bit word.
+typedef BasicImage<uint32_t> Image;
+
+/// A single-channel image with one 8-bit intensity per pixel.
+typedef BasicImage<uint8_t> GrayImage;
+
 }
 
 #endif /* Image_hpp */
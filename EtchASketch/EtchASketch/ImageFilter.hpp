@@ -10,18 +10,72 @@
 #define ImageFilter_hpp
 
 #include "Image.hpp"
+#include "ThreadPool.hpp"
 
 namespace etchasketch {
 	namespace edgedetect {
 		
+		/**
+		 * Filters an image one row at a time, keeping only the rows it still
+		 * needs. @c RowFilter is an abstract superclass; get one from
+		 * @c ImageFilter::newRowFilter().
+		 *
+		 * Each output row is computed from a window of consecutive input
+		 * rows. The first output row comes out with the
+		 * @c getWindowHeight() th input row, and every input row after that
+		 * produces one more, so an image of height h filters to one of height
+		 * h - @c getWindowHeight() + 1.
+		 */
+		class RowFilter {
+		public:
+			virtual ~RowFilter() { };
+			
+			/// The width of each output row, in pixels.
+			virtual size_t getOutputWidth() const = 0;
+			
+			/// The number of input rows that go into each output row.
+			virtual size_t getWindowHeight() const = 0;
+			
+			/**
+			 * Feed in the next input row.
+			 *
+			 * @return The next output row, or @c nullptr if the window isn't
+			 * full yet. The row is only valid until the next call.
+			 */
+			virtual const etchasketch::GrayImage::Pixel *
+			pushRow(const etchasketch::GrayImage::Pixel *row) = 0;
+		};
+		
 		/// Abstract class. Apply a filter to an image.
 		class ImageFilter {
 		public:
+			ImageFilter() : threadPool(nullptr) { };
+			
 			virtual ~ImageFilter() { };
 			
+			/**
+			 * Run on the threads of @c pool, or on the calling thread if it's
+			 * @c nullptr. The pool isn't owned, and must outlive its use here.
+			 */
+			void setThreadPool(etchasketch::ThreadPool *pool)
+				{ threadPool = pool; }
+			
 			/// Apply the filter to the image.
-			virtual etchasketch::Image *
-			apply(const etchasketch::Image &originalImage) const = 0;
+			virtual etchasketch::GrayImage *
+			apply(const etchasketch::GrayImage &originalImage) const = 0;
+			
+			/**
+			 * Create a row filter that applies this filter to an image of the
+			 * given width, for streaming an image through without holding all
+			 * of it. The caller owns the returned filter, which mustn't outlive
+			 * this one.
+			 */
+			virtual etchasketch::edgedetect::RowFilter *
+			newRowFilter(size_t width) const = 0;
+			
+		protected:
+			/// The pool to run on, or @c nullptr to run on the calling thread.
+			etchasketch::ThreadPool *threadPool;
 		};
 		
 	}
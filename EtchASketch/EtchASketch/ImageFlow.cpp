@@ -7,99 +7,224 @@
 //
 
 #include "ImageFlow.hpp"
-#include "SobelEdgeDetector.hpp"
 #include "BlurImageFilter.hpp"
-#include "NearestNeighborSalesman.hpp"
+#include "EASUtils+Private.hpp"
 #include "LineSimplifier.hpp"
+#include "PixelTraversal.hpp"
+#include "TourOptimizer.hpp"
+#include <algorithm>
+#include <mutex>
+#include <utility>
 
-using std::unordered_set;
+using std::string;
 using std::vector;
+using etchasketch::EdgeMask;
+using etchasketch::EdgePointBuffer;
+using etchasketch::GrayImage;
+using etchasketch::GrayscaleConverter;
 using etchasketch::Image;
 using etchasketch::KDPoint;
+using etchasketch::ThreadPool;
+using etchasketch::LuminanceModel;
+using etchasketch::StrategyParameters;
+using etchasketch::StrategyRegistry;
 using etchasketch::edgedetect::BlurImageFilter;
-using etchasketch::edgedetect::SobelEdgeDetector;
+using etchasketch::edgedetect::BlurMode;
+using etchasketch::edgedetect::EdgeDetectorFactory;
+using etchasketch::edgedetect::edgeDetectors;
+using etchasketch::edgedetect::RowEdgeDetector;
+using etchasketch::edgedetect::RowFilter;
 using etchasketch::salesman::Salesman;
-using etchasketch::salesman::NearestNeighborSalesman;
+using etchasketch::salesman::SalesmanFactory;
+using etchasketch::salesman::SalesmanInputs;
+using etchasketch::salesman::TourOptimizer;
+using etchasketch::salesman::salesmen;
+using etchasketch::traversal::forEachRow;
+using etchasketch::traversal::forEachRowBand;
+
+/**
+ * Append the point for each set bit in a row of an edge mask to @c points,
+ * pulling the bits out a word at a time and skipping empty stretches
+ * outright.
+ */
+static void
+appendEdgePoints(const EdgeMask::Word *maskRow, size_t wordsPerRow, size_t y,
+				 EdgePointBuffer &points)
+{
+	for (size_t i = 0; i < wordsPerRow; i++) {
+		EdgeMask::Word word = maskRow[i];
+		while (word != 0) {
+			const size_t x = (i * EdgeMask::bitsPerWord)
+							 + __builtin_ctzll(word);
+			word &= word - 1; // Clear the lowest set bit.
+			points.append(x, y);
+		}
+	}
+}
 
 etchasketch::ImageFlow::ImageFlow(const Image &colorImage)
 : originalImage(colorImage),
-grayscaleImage(colorImage.getWidth(), colorImage.getHeight()),
-edgeDetectedImage(Image(0, 0)),
+grayscaleImage(0, 0),
+edgeDetectedImage(),
 edgePoints(nullptr),
+edgeAreaWidth(0),
+edgeAreaHeight(0),
+orderedAreaWidth(0),
+orderedAreaHeight(0),
 orderedEdgePoints(nullptr),
 scaledEdgePoints(nullptr),
-edgeDetector(new SobelEdgeDetector()),
+threadPool(nullptr),
+grayscaleConverter(),
+blurFilter(new BlurImageFilter()),
+edgeDetector(nullptr),
 salesman(nullptr),
+salesmanName(),
+salesmanParameters(),
+tourOptimizationTime(0.0),
 outputWidth(colorImage.getWidth()),
 outputHeight(colorImage.getHeight())
-{ }
+{
+	setEdgeDetector("sobel");
+	setSalesmanStrategy("nearest-neighbor");
+	setThreadCount(0);
+}
 
 etchasketch::ImageFlow::~ImageFlow()
 {
 	delete edgePoints;
 	delete orderedEdgePoints;
 	delete scaledEdgePoints;
+	delete blurFilter;
 	delete edgeDetector;
 	delete salesman;
+	delete threadPool;
 }
 
 void
 etchasketch::ImageFlow::convertToGrayscale()
 {
-	// Transform each pixel.
-	for (int x = 0; x < originalImage.getWidth(); x++) {
-		for (int y = 0; y < originalImage.getHeight(); y++) {
-			const KDPoint<2> pt(x, y);
-			// Average the components.
-			const Image::Pixel color = originalImage[pt];
-			const Image::Pixel gray =   (((color >> 24) & 0xFF)
-									   + ((color >> 16) & 0xFF)
-									   + ((color >>  8) & 0xFF)) / 3;
-			grayscaleImage[pt] = 0xFF | (gray << 8) | (gray << 16) | (gray << 24);
-		}
-	}
+	grayscaleImage = GrayImage(originalImage.getWidth(), originalImage.getHeight());
+	grayscaleConverter.convert(originalImage, grayscaleImage);
 }
 
 void
 etchasketch::ImageFlow::detectEdges()
 {
-	/*
-	// Blur the image.
-	BlurImageFilter blurFilter = BlurImageFilter();
-	Image *blurredImage = blurFilter.apply(grayscaleImage);
-	// Perform edge detection.
-	Image *detectedImage = edgeDetector->detectEdges(*blurredImage);
-	delete blurredImage;
-	blurredImage = nullptr;
-	/*/
-	Image *detectedImage = edgeDetector->detectEdges(grayscaleImage);
-	// */
+	EdgeMask *detectedImage = nullptr;
+	if (blurFilter) {
+		// Blur the image.
+		GrayImage *blurredImage = blurFilter->apply(grayscaleImage);
+		// Perform edge detection.
+		detectedImage = edgeDetector->detectEdges(*blurredImage);
+		delete blurredImage;
+		blurredImage = nullptr;
+	} else {
+		detectedImage = edgeDetector->detectEdges(grayscaleImage);
+	}
 	edgeDetectedImage = *detectedImage;
+	delete detectedImage;
+	edgeAreaWidth = edgeDetectedImage.getWidth();
+	edgeAreaHeight = edgeDetectedImage.getHeight();
 }
 
 void
 etchasketch::ImageFlow::generateEdgePoints()
 {
-	unordered_set<KDPoint<2>> *pointSet = new unordered_set<KDPoint<2>>();
-	// Loop through each point to see if its pixel is part of an edge.
-	for (int x = 0; x < edgeDetectedImage.getWidth(); x++) {
-		for (int y = 0; y < edgeDetectedImage.getHeight(); y++) {
-			const KDPoint<2> pt(x, y);
-			const Image::Pixel px = edgeDetectedImage[pt];
-			// Arbitrarily choose the green component. RGB all have the same value.
-			const uint8_t greenComponent = ((px >> 16) & 0xFF);
-			// Check for non-black.
-			if (greenComponent != 0) {
-				pointSet->insert(pt);
+	EdgePointBuffer *points = new EdgePointBuffer();
+	points->reserve(edgeDetectedImage.getEdgeCount() + 1);
+	forEachRow(0, edgeDetectedImage.getHeight(), [&](size_t y) {
+		appendEdgePoints(edgeDetectedImage.getRow(y),
+						 edgeDetectedImage.getWordsPerRow(), y, *points);
+	});
+	
+	// Insert the starting point if it's not already in there.
+	points->insert(0, 0);
+	
+	setEdgePoints(points);
+}
+
+void
+etchasketch::ImageFlow::streamEdgePoints()
+{
+	const size_t width = originalImage.getWidth();
+	const size_t height = originalImage.getHeight();
+	
+	// Work out how the image shrinks at each stage. Each row filter and the
+	// row detector turn a window of rows into one, so a row of the mask
+	// comes out with the last row of its combined window.
+	RowFilter *probeFilter = blurFilter ? blurFilter->newRowFilter(width)
+										: nullptr;
+	const size_t filterWindow = probeFilter ? probeFilter->getWindowHeight() : 1;
+	const size_t filteredWidth = probeFilter ? probeFilter->getOutputWidth()
+											 : width;
+	delete probeFilter;
+	const size_t filteredHeight = (height >= filterWindow)
+								  ? (height - filterWindow + 1) : 0;
+	RowEdgeDetector *probeDetector = edgeDetector->newRowDetector(filteredWidth,
+																 filteredHeight);
+	const size_t windowHeight = filterWindow + probeDetector->getWindowHeight() - 1;
+	edgeAreaWidth = probeDetector->getMaskWidth();
+	edgeAreaHeight = probeDetector->getMaskHeight();
+	delete probeDetector;
+	const size_t maskRowCount = (0 == filteredWidth || height < windowHeight)
+								? 0 : (height - windowHeight + 1);
+	
+	// Each band streams its own rows, starting with the halo of rows above
+	// its first mask row, and collects its points separately so they can be
+	// joined back up in row order.
+	std::mutex bandsMutex;
+	vector<std::pair<size_t, EdgePointBuffer>> bands;
+	forEachRowBand(threadPool, 0, maskRowCount,
+				   [&](size_t firstRow, size_t lastRow) {
+		vector<GrayImage::Pixel> grayRow(width);
+		RowFilter *rowFilter = blurFilter ? blurFilter->newRowFilter(width)
+										  : nullptr;
+		RowEdgeDetector *rowDetector = edgeDetector->newRowDetector(filteredWidth,
+																	filteredHeight);
+		const size_t wordsPerRow = (rowDetector->getMaskWidth()
+									+ EdgeMask::bitsPerWord - 1)
+								   / EdgeMask::bitsPerWord;
+		EdgePointBuffer bandPoints;
+		size_t y = firstRow;
+		forEachRow(firstRow, lastRow + windowHeight - 1, [&](size_t inputRow) {
+			grayscaleConverter.convertRow(originalImage.getRow(inputRow),
+										  grayRow.data(), width);
+			const GrayImage::Pixel *row = grayRow.data();
+			if (rowFilter) {
+				row = rowFilter->pushRow(row);
 			}
-		}
+			const EdgeMask::Word *maskRow = row ? rowDetector->pushRow(row)
+												: nullptr;
+			if (maskRow) {
+				appendEdgePoints(maskRow, wordsPerRow, y++, bandPoints);
+			}
+		});
+		delete rowDetector;
+		delete rowFilter;
+		
+		std::lock_guard<std::mutex> lock(bandsMutex);
+		bands.push_back(std::make_pair(firstRow, std::move(bandPoints)));
+	});
+	std::sort(bands.begin(), bands.end(),
+			  [](const std::pair<size_t, EdgePointBuffer> &a,
+				 const std::pair<size_t, EdgePointBuffer> &b) {
+		return a.first < b.first;
+	});
+	
+	EdgePointBuffer *points = new EdgePointBuffer();
+	size_t pointCount = 1;
+	for (const auto &band : bands) {
+		pointCount += band.second.size();
+	}
+	points->reserve(pointCount);
+	for (const auto &band : bands) {
+		points->append(band.second);
 	}
 	
 	// Insert the starting point if it's not already in there.
-	const KDPoint<2> startPoint(0, 0);
-	pointSet->insert(startPoint);
+	points->insert(0, 0);
 	
-	setEdgePoints(pointSet);
+	setEdgePoints(points);
 }
 
 void
@@ -107,15 +232,42 @@ etchasketch::ImageFlow::orderEdgePointsForDrawing()
 {
 	// TODO: Put startPoint in class scope or something.
 	const KDPoint<2> startPoint(0, 0);
-	Salesman *salesman = nullptr;
-	salesman = new NearestNeighborSalesman(*edgePoints, startPoint);
+	const StrategyRegistry<SalesmanFactory>::Entry *entry = salesmen().find(salesmanName);
+	const bool drawsGrayscaleImage = entry->factory.drawsGrayscaleImage;
+	orderedAreaWidth = edgeAreaWidth;
+	orderedAreaHeight = edgeAreaHeight;
+	if (drawsGrayscaleImage) {
+		// Streaming doesn't keep the grayscale image.
+		if (!grayscaleImage.isValid()) {
+			convertToGrayscale();
+		}
+		orderedAreaWidth = grayscaleImage.getWidth();
+		orderedAreaHeight = grayscaleImage.getHeight();
+	}
+	SalesmanInputs inputs;
+	inputs.edgePoints = edgePoints;
+	inputs.grayscaleImage = drawsGrayscaleImage ? &grayscaleImage : nullptr;
+	inputs.startPoint = startPoint;
+	inputs.threadPool = threadPool;
+	Salesman *salesman = entry->factory.create(inputs, salesmanParameters);
 	setSalesman(salesman);
 	salesman->orderPoints();
 	vector<KDPoint<2>> *line = new vector<KDPoint<2>>(salesman->getOrderedPoints());
 	setSalesman(nullptr); // Done with the salesman.
 	
+	// A sweep over the image is the picture, so there's no tour to shorten.
+	if ((tourOptimizationTime > 0.0) && !drawsGrayscaleImage) {
+		TourOptimizer optimizer;
+		optimizer.setThreadPool(threadPool);
+		optimizer.setTimeBudget(tourOptimizationTime);
+		optimizer.optimize(*line);
+		EASLog("Shortened the drawing path from %.0f to %.0f pixels",
+			   optimizer.getInitialLength(), optimizer.getFinalLength());
+	}
+	
 	// Simplify the line.
 	LineSimplifier lineSimplifier = LineSimplifier();
+	lineSimplifier.setThreadPool(threadPool);
 	lineSimplifier.simplifyLine(*line);
 	
 	setOrderedEdgePoints(line);
@@ -130,8 +282,8 @@ etchasketch::ImageFlow::scalePointsToFitOutputSize()
 	for (auto it = orderedEdgePoints->begin(); it != orderedEdgePoints->end(); ++it) {
 		const KDPoint<2> &ipt = *it;
 		KDPointCoordinate mptx, mpty;
-		mptx = static_cast<KDPointCoordinate>(floor(ipt[0] * outputWidth / static_cast<float>(edgeDetectedImage.getWidth())));
-		mpty = static_cast<KDPointCoordinate>(floor(ipt[1] * outputHeight / static_cast<float>(edgeDetectedImage.getHeight())));
+		mptx = static_cast<KDPointCoordinate>(floor(ipt[0] * outputWidth / static_cast<float>(orderedAreaWidth)));
+		mpty = static_cast<KDPointCoordinate>(floor(ipt[1] * outputHeight / static_cast<float>(orderedAreaHeight)));
 		scaledPoints->push_back(KDPoint<2>(mptx, mpty));
 	}
 	
@@ -152,9 +304,7 @@ etchasketch::ImageFlow::performAllComputationSteps()
 	// Check if each stage of computation is done. If any stage has not yet been
 	// performed, do so now.
 	if (!edgePoints) {
-		convertToGrayscale();
-		detectEdges();
-		generateEdgePoints();
+		streamEdgePoints();
 	}
 	
 	if (!orderedEdgePoints) {
@@ -188,11 +338,106 @@ etchasketch::ImageFlow::setOutputSize(size_t width, size_t height)
 	setScaledEdgePoints(nullptr);
 }
 
+void
+etchasketch::ImageFlow::setLuminanceModel(LuminanceModel model)
+{
+	grayscaleConverter = GrayscaleConverter(model);
+	grayscaleConverter.setThreadPool(threadPool);
+}
+
+void
+etchasketch::ImageFlow::setBlur(float sigma, BlurMode mode)
+{
+	delete blurFilter;
+	blurFilter = nullptr;
+	if (sigma > 0.0f) {
+		blurFilter = new BlurImageFilter(sigma,
+										 BlurImageFilter::radiusForSigma(sigma),
+										 mode);
+		blurFilter->setThreadPool(threadPool);
+	}
+}
+
+bool
+etchasketch::ImageFlow::setEdgeDetector(const string &name,
+										const StrategyParameters &parameters)
+{
+	const StrategyRegistry<EdgeDetectorFactory>::Entry *entry = edgeDetectors().find(name);
+	StrategyParameters resolvedParameters;
+	if (!entry || !StrategyRegistry<EdgeDetectorFactory>::resolveParameters(*entry, parameters,
+																			resolvedParameters)) {
+		return false;
+	}
+	delete edgeDetector;
+	edgeDetector = entry->factory(resolvedParameters);
+	edgeDetector->setThreadPool(threadPool);
+	return true;
+}
+
+bool
+etchasketch::ImageFlow::setSalesmanStrategy(const string &name,
+											const StrategyParameters &parameters)
+{
+	const StrategyRegistry<SalesmanFactory>::Entry *entry = salesmen().find(name);
+	StrategyParameters resolvedParameters;
+	if (!entry || !StrategyRegistry<SalesmanFactory>::resolveParameters(*entry, parameters,
+																		resolvedParameters)) {
+		return false;
+	}
+	salesmanName = name;
+	salesmanParameters = resolvedParameters;
+	return true;
+}
+
+void
+etchasketch::ImageFlow::setThreadCount(size_t threadCount)
+{
+	ThreadPool *newThreadPool = new ThreadPool(threadCount);
+	grayscaleConverter.setThreadPool(newThreadPool);
+	if (blurFilter) {
+		blurFilter->setThreadPool(newThreadPool);
+	}
+	edgeDetector->setThreadPool(newThreadPool);
+	delete threadPool;
+	threadPool = newThreadPool;
+}
+
+Image *
+etchasketch::ImageFlow::copyGrayscaleImageAsRGBA() const
+{
+	Image *rgbaImage = new Image(grayscaleImage.getWidth(),
+								 grayscaleImage.getHeight());
+	const size_t width = grayscaleImage.getWidth();
+	forEachRow(0, grayscaleImage.getHeight(), [&](size_t y) {
+		const GrayImage::Pixel *src = grayscaleImage.getRow(y);
+		Image::Pixel *dst = rgbaImage->getRow(y);
+		for (size_t x = 0; x < width; x++) {
+			const Image::Pixel gray = src[x];
+			dst[x] = (gray << 24) | (gray << 16) | (gray << 8) | 0xFF;
+		}
+	});
+	return rgbaImage;
+}
+
+Image *
+etchasketch::ImageFlow::copyEdgeDetectedImageAsRGBA() const
+{
+	Image *rgbaImage = new Image(edgeDetectedImage.getWidth(),
+								 edgeDetectedImage.getHeight());
+	const size_t width = edgeDetectedImage.getWidth();
+	forEachRow(0, edgeDetectedImage.getHeight(), [&](size_t y) {
+		Image::Pixel *dst = rgbaImage->getRow(y);
+		for (size_t x = 0; x < width; x++) {
+			dst[x] = edgeDetectedImage.get(x, y) ? 0xFFFFFFFF : 0x000000FF;
+		}
+	});
+	return rgbaImage;
+}
+
 #pragma mark Setters
 
 void
-etchasketch::ImageFlow::setEdgePoints(const unordered_set<KDPoint<2>>
-									  *newEdgePoints)
+etchasketch::ImageFlow::setEdgePoints(const EdgePointBuffer *newEdgePoints)
 {
 	// Delete the old value and set it to the new pointer.
 	delete edgePoints;
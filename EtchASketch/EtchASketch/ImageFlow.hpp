@@ -9,11 +9,18 @@
 #ifndef ImageFlow_hpp
 #define ImageFlow_hpp
 
-#include <unordered_set>
+#include <string>
 #include <vector>
 #include "Image.hpp"
+#include "EdgeMask.hpp"
+#include "EdgePointBuffer.hpp"
+#include "GrayscaleConverter.hpp"
 #include "EdgeDetector.hpp"
+#include "ImageFilter.hpp"
+#include "BlurImageFilter.hpp"
 #include "Salesman.hpp"
+#include "StrategyRegistry.hpp"
+#include "ThreadPool.hpp"
 
 namespace etchasketch {
 	
@@ -46,6 +53,15 @@ namespace etchasketch {
 		/// Get a set of all points on an edge in the edge detected image.
 		void generateEdgePoints();
 		
+		/**
+		 * Do the work of @c convertToGrayscale(), @c detectEdges(), and
+		 * @c generateEdgePoints() in a single pass, streaming rows through
+		 * each stage and keeping only the few rows each one still needs.
+		 * The edge points are the same, but the grayscale image and edge
+		 * mask are never stored, so they're left empty.
+		 */
+		void streamEdgePoints();
+		
 		/// Put the edge points in the best order for drawing.
 		void orderEdgePointsForDrawing();
 		
@@ -58,34 +74,137 @@ namespace etchasketch {
 		/// Get the points in drawing order, generating them if necessary.
 		const std::vector<etchasketch::KDPoint<2>> & getFinalPoints();
 		
-		/// Do the entire computation flow.
+		/**
+		 * Do the entire computation flow, skipping any stages that are
+		 * already done. The image stages are streamed.
+		 */
 		void performAllComputationSteps();
 		
 		/// Set the desired output resolution.
 		void setOutputSize(size_t width, size_t height);
 		
+		/**
+		 * Choose how color is converted to gray. Takes effect the next time
+		 * @c convertToGrayscale() runs. Defaults to
+		 * @c LuminanceModel::Average.
+		 */
+		void setLuminanceModel(etchasketch::LuminanceModel model);
+		
+		/**
+		 * Choose how the grayscale image is blurred before edge detection.
+		 * Takes effect the next time @c detectEdges() runs. Defaults to a
+		 * Gaussian with a sigma of 1.
+		 *
+		 * @param sigma The standard deviation of the blur, in pixels. Pass 0
+		 * to turn blurring off.
+		 * @param mode How to compute the blur. @c BlurMode::TripleBox is
+		 * faster for large sigmas.
+		 */
+		void setBlur(float sigma, etchasketch::edgedetect::BlurMode mode =
+					 etchasketch::edgedetect::BlurMode::Gaussian);
+		
+		/**
+		 * Set how many threads the image-processing stages run on. Pass 0 to
+		 * use one per hardware thread, which is the default. The output is
+		 * the same whatever the thread count.
+		 */
+		void setThreadCount(size_t threadCount);
+		
+		/**
+		 * Choose how edges are detected, by name from
+		 * @c edgedetect::edgeDetectors(). Takes effect the next time edges
+		 * are detected. Defaults to "sobel".
+		 *
+		 * @return @c false, changing nothing, if there's no such detector or
+		 * it doesn't take one of the @c parameters.
+		 */
+		bool setEdgeDetector(const std::string &name,
+							 const etchasketch::StrategyParameters &parameters =
+							 etchasketch::StrategyParameters());
+		
+		/**
+		 * Choose how the edge points are put in drawing order, by name from
+		 * @c salesman::salesmen(). Takes effect the next time
+		 * @c orderEdgePointsForDrawing() runs. Defaults to
+		 * "nearest-neighbor".
+		 *
+		 * @return @c false, changing nothing, if there's no such salesman or
+		 * it doesn't take one of the @c parameters.
+		 */
+		bool setSalesmanStrategy(const std::string &name,
+								 const etchasketch::StrategyParameters &parameters =
+								 etchasketch::StrategyParameters());
+		
+		/**
+		 * Spend up to @c seconds shortening the drawing order once the
+		 * salesman has made it, which shortens the drawing time as much.
+		 * Takes effect the next time @c orderEdgePointsForDrawing() runs.
+		 * Defaults to 0, which skips it.
+		 */
+		inline void setTourOptimizationTime(double seconds)
+			{ tourOptimizationTime = seconds; }
+		
 		// For the Objective-C wrapper.
 		
 		/// Get the grayscale image, if we've already produced it.
-		const etchasketch::Image & getGrayscaleImage() const
+		const etchasketch::GrayImage & getGrayscaleImage() const
 			{ return grayscaleImage; }
 		
-		/// Get the edge detected image, if we've already produced it.
-		const etchasketch::Image & getEdgeDetectedImage() const
+		/// Get the edge mask, if we've already produced it.
+		const etchasketch::EdgeMask & getEdgeDetectedImage() const
 			{ return edgeDetectedImage; }
 		
+		/// Get the edge points, if we've already produced them.
+		const etchasketch::EdgePointBuffer * getEdgePoints() const
+			{ return edgePoints; }
+		
+		/**
+		 * Expand the grayscale image to RGBA, for display. The caller owns
+		 * the returned image.
+		 */
+		etchasketch::Image * copyGrayscaleImageAsRGBA() const;
+		
+		/**
+		 * Expand the edge mask to an RGBA image with white edges on black,
+		 * for display. The caller owns the returned image.
+		 */
+		etchasketch::Image * copyEdgeDetectedImageAsRGBA() const;
+		
 	private:
 		// Images and other such things, in order of use.
 		const etchasketch::Image originalImage;
-		etchasketch::Image grayscaleImage;
-		etchasketch::Image edgeDetectedImage;
-		const std::unordered_set<etchasketch::KDPoint<2>> *edgePoints;
+		etchasketch::GrayImage grayscaleImage;
+		etchasketch::EdgeMask edgeDetectedImage;
+		const etchasketch::EdgePointBuffer *edgePoints;
+		/// The width of the edge mask the edge points came from.
+		size_t edgeAreaWidth;
+		/// The height of the edge mask the edge points came from.
+		size_t edgeAreaHeight;
+		/// The width of the area the ordered points lie in.
+		size_t orderedAreaWidth;
+		/// The height of the area the ordered points lie in.
+		size_t orderedAreaHeight;
 		const std::vector<etchasketch::KDPoint<2>> *orderedEdgePoints;
 		const std::vector<etchasketch::KDPoint<2>> *scaledEdgePoints;
 		
+		/// Shared by the image-processing stages and the tour optimizer.
+		etchasketch::ThreadPool *threadPool;
+		
+		etchasketch::GrayscaleConverter grayscaleConverter;
+		/// Applied before edge detection, or @c nullptr for no blur.
+		etchasketch::edgedetect::ImageFilter *blurFilter;
 		etchasketch::edgedetect::EdgeDetector *edgeDetector;
 		etchasketch::salesman::Salesman *salesman;
 		
+		/// Which salesman @c orderEdgePointsForDrawing() uses.
+		std::string salesmanName;
+		
+		/// The salesman's parameters, defaults and all.
+		etchasketch::StrategyParameters salesmanParameters;
+		
+		/// The most seconds to spend shortening the drawing order.
+		double tourOptimizationTime;
+		
 		/// The desired width of the ordered points, in pixels.
 		size_t outputWidth;
 		
@@ -93,8 +212,7 @@ namespace etchasketch {
 		size_t outputHeight;
 		
 		// Setters
-		void setEdgePoints(const std::unordered_set<etchasketch::KDPoint<2>>
-						   *newEdgePoints);
+		void setEdgePoints(const etchasketch::EdgePointBuffer *newEdgePoints);
 		
 		void setOrderedEdgePoints(const std::vector<etchasketch::KDPoint<2>>
 								  *newOrderedEdgePoints);
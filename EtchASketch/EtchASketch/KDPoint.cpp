@@ -24,8 +24,6 @@ using etchasketch::KDPointCoordinate;
 template<int Dim>
 etchasketch::KDPoint<Dim>::KDPoint(const KDPointCoordinate allValues)
 {
-	this->lesserPoints = nullptr;
-	this->greaterPoints = nullptr;
 	for (int i = 0; i < Dim; i++) {
 		vals[i] = allValues;
 	}
@@ -57,13 +55,6 @@ etchasketch::KDPoint<Dim>::KDPoint(KDPointCoordinate x, KDPointCoordinate y ...)
 	va_end(ap);
 }
 
-template<int Dim>
-etchasketch::KDPoint<Dim>::KDPoint(const KDPoint<Dim> & __restrict other)
-: KDPoint()
-{
-	memcpy(this->vals, other.vals, sizeof(this->vals));
-}
-
 template<int Dim>
 bool
 etchasketch::KDPoint<Dim>::isValid() const
@@ -77,13 +68,6 @@ etchasketch::KDPoint<Dim>::isValid() const
 	return true;
 }
 
-template<int Dim>
-bool
-etchasketch::KDPoint<Dim>::isLeaf() const
-{
-	return (lesserPoints == nullptr) && (greaterPoints == nullptr);
-}
-
 template<int Dim>
 float
 etchasketch::KDPoint<Dim>::distanceTo(const KDPoint<Dim> &other) const
@@ -132,27 +116,6 @@ etchasketch::KDPoint<Dim>::set(int index, KDPointCoordinate val)
 template<int Dim>
 void
 etchasketch::KDPoint<Dim>::print(std::ostream &out /* = cout */) const
-{
-	out << "{\"value\": ";
-	printVals(out);
-	out << ", \"lesserPoints\": ";
-	if (nullptr != lesserPoints) {
-		lesserPoints->print(out);
-	} else {
-		out << "null";
-	}
-	out << ", \"greaterPoints\": ";
-	if (nullptr != greaterPoints) {
-		greaterPoints->print(out);
-	} else {
-		out << "null";
-	}
-	out << "}";
-}
-
-template<int Dim>
-void
-etchasketch::KDPoint<Dim>::printVals(std::ostream &out) const
 {
 	out << '[' << vals[0];
 	
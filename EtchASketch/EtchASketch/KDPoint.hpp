@@ -12,6 +12,7 @@
 #include <cstdarg>
 #include <iostream>
 #include <stdexcept>
+#include <type_traits>
 
 using std::out_of_range;
 using std::cout;
@@ -25,6 +26,10 @@ namespace etchasketch {
 	/**
 	 * KDPoint class: represents a point in Dim dimensional space.
 	 *
+	 * A point is nothing but its coordinates, so it's trivially copyable and
+	 * arrays of points can be copied with memcpy. Tree structure lives in
+	 * @c KDTree.
+	 *
 	 * @author Matt Sachtler
 	 * @date Spring 2009
 	 */
@@ -39,32 +44,16 @@ namespace etchasketch {
 		KDPointCoordinate vals[Dim];
 		
 	public:
-		/// The subtree containing all points less than the current point.
-		KDPoint<Dim> *lesserPoints;
-		
-		/// The subtree containing all points greater than the current point.
-		KDPoint<Dim> *greaterPoints;
-		
 		KDPoint(const KDPointCoordinate allValues = 0);
 		
 		KDPoint(const KDPointCoordinate arr[Dim]);
 		
 		explicit KDPoint(KDPointCoordinate x, KDPointCoordinate y ...);
 		
-		/**
-		 * Copy constructor.
-		 * Copies the values from other, but *not* the subtree pointers.
-		 */
-		KDPoint(const KDPoint<Dim> & __restrict other);
-		
 		/// Whether this point is a valid point.
 		inline
 		bool isValid() const;
 		
-		/// Whether this point has no subtrees.
-		inline
-		bool isLeaf() const;
-		
 		/**
 		 * @param other The point to measure the distance to.
 		 * @return The square of the distance to other.
@@ -117,9 +106,6 @@ namespace etchasketch {
 		
 		/// Print a textual representation of the point to an output stream.
 		void print(std::ostream &out = std::cout) const;
-		
-	private:
-		void printVals(std::ostream &out = std::cout) const;
 	};
 	
 	template<int Dim>
@@ -153,4 +139,9 @@ namespace std {
 
 #include "KDPoint.cpp"
 
+static_assert(std::is_trivially_copyable<etchasketch::KDPoint<2>>::value,
+			  "KDPoint must stay trivially copyable");
+static_assert(sizeof(etchasketch::KDPoint<2>) == 2 * sizeof(etchasketch::KDPointCoordinate),
+			  "KDPoint must be just its coordinates");
+
 #endif /* KDPoint_hpp */
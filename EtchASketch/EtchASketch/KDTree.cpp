@@ -17,44 +17,96 @@ using std::vector;
 using etchasketch::KDPoint;
 
 
+template<int Dim>
+const size_t etchasketch::KDTree<Dim>::minimumTailLength;
+
+template<int Dim>
+const double etchasketch::KDTree<Dim>::defaultMaximumRemovedFraction = 0.9;
+
 #pragma mark - Constructors
 
 template<int Dim>
 etchasketch::KDTree<Dim>::KDTree()
-: root(nullptr)
+: points(), removed(), removedCount(0), liveCounts(),
+  maximumRemovedFraction(defaultMaximumRemovedFraction), tail()
 { }
 
 template<int Dim>
 etchasketch::KDTree<Dim>::KDTree(const unordered_set<KDPoint<Dim>> &newPoints)
 : KDTree()
 {
-	buildTree(newPoints);
+	buildTree(vector<KDPoint<Dim>>(newPoints.begin(), newPoints.end()));
 }
 
 template<int Dim>
 etchasketch::KDTree<Dim>::KDTree(const vector<KDPoint<Dim>> &newPoints)
-: KDTree(unordered_set<KDPoint<Dim>>(newPoints.begin(), newPoints.end()))
-{ }
+: KDTree()
+{
+	// Drop any duplicates.
+	vector<KDPoint<Dim>> uniquePoints(newPoints);
+	std::sort(uniquePoints.begin(), uniquePoints.end());
+	uniquePoints.erase(std::unique(uniquePoints.begin(), uniquePoints.end()),
+					   uniquePoints.end());
+	buildTree(std::move(uniquePoints));
+}
 
 template<int Dim>
 void
-etchasketch::KDTree<Dim>::buildTree(const unordered_set<KDPoint<Dim>> &points)
+etchasketch::KDTree<Dim>::buildTree(vector<KDPoint<Dim>> &&newPoints)
 {
-	// TODO: Would sorting the points help speed up the build?
-	// Just insert each point.
-	for (auto ptIter = points.begin(); ptIter != points.end(); ++ptIter) {
-		// Make a copy of the points.
-		KDPoint<Dim> *point = new KDPoint<Dim>(*ptIter);
-		this->insert(point);
+	points = std::move(newPoints);
+	removed.assign(points.size(), false);
+	liveCounts.resize(points.size());
+	removedCount = 0;
+	buildSubtree(0, points.size(), 0);
+}
+
+template<int Dim>
+void
+etchasketch::KDTree<Dim>::buildSubtree(size_t first, size_t last,
+									   int dimension)
+{
+	if (first >= last) {
+		return;
+	}
+	const size_t median = first + (last - first - 1) / 2;
+	liveCounts[median] = static_cast<uint32_t>(last - first);
+	if (last - first == 1) {
+		return;
 	}
+	// Put the median in the middle, with everything smaller before it and
+	// everything larger after it.
+	std::nth_element(points.begin() + first, points.begin() + median,
+					 points.begin() + last,
+					 [this, dimension](const KDPoint<Dim> &a,
+									   const KDPoint<Dim> &b) {
+		return smallerDimVal(a, b, dimension);
+	});
+	const int nextDimension = (dimension + 1) % Dim;
+	buildSubtree(first, median, nextDimension);
+	buildSubtree(median + 1, last, nextDimension);
 }
 
 template<int Dim>
-etchasketch::KDTree<Dim>::~KDTree()
+void
+etchasketch::KDTree<Dim>::rebuild()
 {
-	delete root;
+	vector<KDPoint<Dim>> remaining;
+	remaining.reserve(size());
+	for (size_t i = 0; i < points.size(); i++) {
+		if (!removed[i]) {
+			remaining.push_back(points[i]);
+		}
+	}
+	remaining.insert(remaining.end(), tail.begin(), tail.end());
+	tail.clear();
+	buildTree(std::move(remaining));
 }
 
+template<int Dim>
+etchasketch::KDTree<Dim>::~KDTree()
+{ }
+
 #pragma mark -
 
 template<int Dim>
@@ -73,84 +125,219 @@ etchasketch::KDTree<Dim>::smallerDimVal(const KDPoint<Dim> &first,
 #pragma mark - Find nearest neighbor
 
 template<int Dim>
-KDPoint<Dim> *
-etchasketch::KDTree<Dim>::findNearestNeighbor(const KDPoint<Dim> &query) const
+bool
+etchasketch::KDTree<Dim>::findNearestNeighbor(const KDPoint<Dim> &query,
+											  KDPoint<Dim> &nearest, // out
+											  float *squaredDistance) const // out
 {
-	double currentBestDist = 1.0 / 0.0; // Infinity.
-	const KDPoint<Dim> *nn = findNearestNeighbor(query, root, currentBestDist,
-												 0);
-	if (nullptr != nn) {
-		// Return a copy of the nearest neighbor.
-		return new KDPoint<Dim>(*nn);
-	}
-	return nullptr;
+	const KDPoint<Dim> *best = nullptr;
+	double bestDist = 1.0 / 0.0; // Infinity.
+	findNearestNeighbor(query, 0, points.size(), 0, best, bestDist);
+	// The tail is short; just check each point in it.
+	for (const KDPoint<Dim> &point : tail) {
+		if (shouldReplace(query, best, point)) {
+			best = &point;
+			bestDist = query.distanceTo(point);
+		}
+	}
+	if (nullptr == best) {
+		return false;
+	}
+	nearest = *best;
+	if (nullptr != squaredDistance) {
+		*squaredDistance = static_cast<float>(bestDist);
+	}
+	return true;
 }
 
 template<int Dim>
-const KDPoint<Dim> *
+void
 etchasketch::KDTree<Dim>::findNearestNeighbor(const KDPoint<Dim> &query,
-											  const KDPoint<Dim> *subroot,
-											  double &currentBestDist, // inout
-											  const int dimension) const
+											  size_t first, size_t last,
+											  const int dimension,
+											  const KDPoint<Dim> *&best, // inout
+											  double &bestDist) const // inout
 {
-	// Base cases.
-	if (nullptr == subroot) {
-		return nullptr;
+	// Base case.
+	if (first >= last) {
+		return;
 	}
-	const KDPoint<Dim> &subRoot = *subroot;
-	if (subRoot.isLeaf()) {
-		currentBestDist = query.distanceTo(subRoot);
-		return subroot;
+	const size_t median = first + (last - first - 1) / 2;
+	if (0 == liveCounts[median]) {
+		// Everything in here has been removed.
+		return;
 	}
-	
+	const KDPoint<Dim> &subRoot = points[median];
 	const int nextDimension = (dimension + 1) % Dim;
-	const double myDistance = query.distanceTo(subRoot);
-	const KDPoint<Dim> *currentBestKDPoint = nullptr;
 	
-	// Recurse to find the nearest neighbor in a subtree.
-	if (smallerDimVal(query, subRoot, dimension)) {
-		// Go left.
-		currentBestKDPoint = findNearestNeighbor(query, subRoot.lesserPoints, currentBestDist, nextDimension);
+	// Search the side of the splitting plane the query is on first, since
+	// that's where the nearest neighbor most likely is.
+	const bool goLeft = smallerDimVal(query, subRoot, dimension);
+	if (goLeft) {
+		findNearestNeighbor(query, first, median, nextDimension, best, bestDist);
 	} else {
-		// Go right.
-		currentBestKDPoint = findNearestNeighbor(query, subRoot.greaterPoints, currentBestDist, nextDimension);
+		findNearestNeighbor(query, median + 1, last, nextDimension, best, bestDist);
 	}
 	
 	// Check if the subroot is better than the subtree's best.
-	if (shouldReplace(query, currentBestKDPoint, subRoot)) {
-		currentBestDist = myDistance;
-		currentBestKDPoint = subroot;
+	if (!removed[median] && shouldReplace(query, best, subRoot)) {
+		best = &subRoot;
+		bestDist = query.distanceTo(subRoot);
 	}
 	
-	// Check if there could be a better point in the other subtree.
-	// If the difference between query and subroot in the current dimension is
-	// less than that between query and the other node, it's possible that the
-	// other subtree contains a closer node.
+	// Check if there could be a better point on the other side. If the
+	// splitting plane is no farther than the best point so far, the other
+	// subtree could hold a closer point, or one just as close that breaks
+	// the tie.
 	const double diffInCurDim = (query[dimension] - subRoot[dimension]);
 	const double distInCurDim = diffInCurDim * diffInCurDim;
-	if (distInCurDim <= currentBestDist) {
-		double newBestDist = 1.0 / 0.0; // Infinity.
-		const KDPoint<Dim> *newBestKDPoint;
-		if (smallerDimVal(subRoot, query, dimension)) {
-			// Go left.
-			newBestKDPoint = findNearestNeighbor(query, subRoot.lesserPoints, newBestDist, nextDimension);
+	if (distInCurDim <= bestDist) {
+		if (goLeft) {
+			findNearestNeighbor(query, median + 1, last, nextDimension, best, bestDist);
 		} else {
-			// Go right.
-			newBestKDPoint = findNearestNeighbor(query, subRoot.greaterPoints, newBestDist, nextDimension);
+			findNearestNeighbor(query, first, median, nextDimension, best, bestDist);
 		}
-		
-		if (newBestKDPoint != nullptr) {
-			// Check the distance we just got.
-			if (shouldReplace(query, currentBestKDPoint, *newBestKDPoint)) {
-				currentBestDist = newBestDist;
-				currentBestKDPoint = newBestKDPoint;
-			}
+	}
+}
+
+#pragma mark - k nearest neighbors
+
+template<int Dim>
+void
+etchasketch::KDTree<Dim>::findKNearest(const KDPoint<Dim> &query, size_t k,
+									   vector<KDPoint<Dim>> &nearest) const // out
+{
+	nearest.clear();
+	if (0 == k) {
+		return;
+	}
+	findKNearest(query, k, 0, points.size(), 0, nearest);
+	for (const KDPoint<Dim> &point : tail) {
+		offerNeighbor(query, k, point, nearest);
+	}
+	// Turn the max-heap into a list, nearest first.
+	std::sort_heap(nearest.begin(), nearest.end(),
+				   [this, &query](const KDPoint<Dim> &a, const KDPoint<Dim> &b) {
+		return shouldReplace(query, &b, a);
+	});
+}
+
+template<int Dim>
+void
+etchasketch::KDTree<Dim>::findKNearest(const KDPoint<Dim> &query, size_t k,
+									   size_t first, size_t last,
+									   const int dimension,
+									   vector<KDPoint<Dim>> &heap) const // inout
+{
+	if (first >= last) {
+		return;
+	}
+	const size_t median = first + (last - first - 1) / 2;
+	if (0 == liveCounts[median]) {
+		return;
+	}
+	const KDPoint<Dim> &subRoot = points[median];
+	const int nextDimension = (dimension + 1) % Dim;
+	
+	const bool goLeft = smallerDimVal(query, subRoot, dimension);
+	if (goLeft) {
+		findKNearest(query, k, first, median, nextDimension, heap);
+	} else {
+		findKNearest(query, k, median + 1, last, nextDimension, heap);
+	}
+	
+	if (!removed[median]) {
+		offerNeighbor(query, k, subRoot, heap);
+	}
+	
+	// Until the heap is full, anything could make the cut. After that, only
+	// points no farther than the farthest kept point can.
+	const double diffInCurDim = (query[dimension] - subRoot[dimension]);
+	const double distInCurDim = diffInCurDim * diffInCurDim;
+	if (heap.size() < k || distInCurDim <= query.distanceTo(heap.front())) {
+		if (goLeft) {
+			findKNearest(query, k, median + 1, last, nextDimension, heap);
+		} else {
+			findKNearest(query, k, first, median, nextDimension, heap);
+		}
+	}
+}
+
+template<int Dim>
+void
+etchasketch::KDTree<Dim>::offerNeighbor(const KDPoint<Dim> &query, size_t k,
+										const KDPoint<Dim> &candidate,
+										vector<KDPoint<Dim>> &heap) const // inout
+{
+	// Order the heap so the farthest point is on top.
+	auto closer = [this, &query](const KDPoint<Dim> &a, const KDPoint<Dim> &b) {
+		return shouldReplace(query, &b, a);
+	};
+	if (heap.size() < k) {
+		heap.push_back(candidate);
+		std::push_heap(heap.begin(), heap.end(), closer);
+	} else if (shouldReplace(query, &heap.front(), candidate)) {
+		std::pop_heap(heap.begin(), heap.end(), closer);
+		heap.back() = candidate;
+		std::push_heap(heap.begin(), heap.end(), closer);
+	}
+}
+
+#pragma mark - Radius search
+
+template<int Dim>
+void
+etchasketch::KDTree<Dim>::findWithinRadius(const KDPoint<Dim> &query,
+										   float radius,
+										   vector<KDPoint<Dim>> &found) const // out
+{
+	found.clear();
+	if (radius < 0.0f) {
+		return;
+	}
+	const float squaredRadius = radius * radius;
+	findWithinRadius(query, squaredRadius, 0, points.size(), 0, found);
+	for (const KDPoint<Dim> &point : tail) {
+		if (query.distanceTo(point) <= squaredRadius) {
+			found.push_back(point);
 		}
 	}
+}
+
+template<int Dim>
+void
+etchasketch::KDTree<Dim>::findWithinRadius(const KDPoint<Dim> &query,
+										   float squaredRadius,
+										   size_t first, size_t last,
+										   const int dimension,
+										   vector<KDPoint<Dim>> &found) const // inout
+{
+	if (first >= last) {
+		return;
+	}
+	const size_t median = first + (last - first - 1) / 2;
+	if (0 == liveCounts[median]) {
+		return;
+	}
+	const KDPoint<Dim> &subRoot = points[median];
+	const int nextDimension = (dimension + 1) % Dim;
+	
+	if (!removed[median] && query.distanceTo(subRoot) <= squaredRadius) {
+		found.push_back(subRoot);
+	}
 	
-	return currentBestKDPoint;
+	// Only cross a splitting plane that's inside the circle.
+	const float diffInCurDim = static_cast<float>(query[dimension] - subRoot[dimension]);
+	if (diffInCurDim <= 0.0f || diffInCurDim * diffInCurDim <= squaredRadius) {
+		findWithinRadius(query, squaredRadius, first, median, nextDimension, found);
+	}
+	if (diffInCurDim >= 0.0f || diffInCurDim * diffInCurDim <= squaredRadius) {
+		findWithinRadius(query, squaredRadius, median + 1, last, nextDimension, found);
+	}
 }
 
+#pragma mark -
+
 template<int Dim>
 bool
 etchasketch::KDTree<Dim>::shouldReplace(const KDPoint<Dim> &target,
@@ -176,218 +363,163 @@ etchasketch::KDTree<Dim>::shouldReplace(const KDPoint<Dim> &target,
 #pragma mark -
 
 template<int Dim>
-bool
-etchasketch::KDTree<Dim>::contains(const KDPoint<Dim> &query) const
+size_t
+etchasketch::KDTree<Dim>::find(const KDPoint<Dim> &query) const
 {
-	const KDPoint<Dim> *subRoot = root;
+	// Each point's place in the layout is fixed by the order it was built
+	// with, so there's exactly one path to follow down.
+	size_t first = 0, last = points.size();
 	int dimension = 0;
-	while (nullptr != subRoot) {
-		// Base case.
-		if (*subRoot == query) {
-			return true;
+	while (first < last) {
+		const size_t median = first + (last - first - 1) / 2;
+		if (points[median] == query) {
+			return median;
 		}
-		
-		if (smallerDimVal(query, *subRoot, dimension)) {
+		if (smallerDimVal(query, points[median], dimension)) {
 			// Go left.
-			subRoot = subRoot->lesserPoints;
+			last = median;
 		} else {
 			// Go right.
-			subRoot = subRoot->greaterPoints;
+			first = median + 1;
 		}
 		dimension = (dimension + 1) % Dim;
 	}
-	return false;
+	return points.size();
 }
 
-#pragma mark - Tree modification
-
 template<int Dim>
-bool
-etchasketch::KDTree<Dim>::insert(const KDPoint<Dim> &newPoint)
+void
+etchasketch::KDTree<Dim>::adjustLiveCounts(size_t index, int delta)
 {
-	// Make a copy and insert it.
-	KDPoint<Dim> *pointCopy = new KDPoint<Dim>(newPoint);
-	bool success = insert(pointCopy);
-	if (!success) {
-		delete pointCopy;
+	const KDPoint<Dim> &point = points[index];
+	size_t first = 0, last = points.size();
+	int dimension = 0;
+	while (first < last) {
+		const size_t median = first + (last - first - 1) / 2;
+		liveCounts[median] += delta;
+		if (median == index) {
+			return;
+		}
+		if (smallerDimVal(point, points[median], dimension)) {
+			last = median;
+		} else {
+			first = median + 1;
+		}
+		dimension = (dimension + 1) % Dim;
 	}
-	return success;
 }
 
 template<int Dim>
 bool
-etchasketch::KDTree<Dim>::insert(KDPoint<Dim> *newPoint)
+etchasketch::KDTree<Dim>::contains(const KDPoint<Dim> &query) const
 {
-	// Safety first.
-	if (nullptr == newPoint) {
-		return false;
-	}
-//	// Check if the new point is already in the KDTree.
-//	if (contains(*newPoint)) {
-//		return false;
-//	}
-	
-	// Temporarily remove the subtrees.
-	KDPoint<Dim> *left = newPoint->lesserPoints;
-	KDPoint<Dim> *right = newPoint->greaterPoints;
-	newPoint->lesserPoints = nullptr;
-	newPoint->greaterPoints = nullptr;
-	
-	if (nullptr != root) {
-		// Call the helper.
-		if (!insert(*newPoint, *root, 0)) {
-			goto warnAndFail;
-		}
-	} else {
-		root = newPoint;
+	const size_t index = find(query);
+	if (index < points.size()) {
+		return !removed[index];
 	}
-	
-	// Insert the subtrees recursively.
-	if (nullptr != left) {
-		if (!insert(left)) {
-			goto warnAndFail;
-		}
-	}
-	if (nullptr != right) {
-		if (!insert(right)) {
-			goto warnAndFail;
-		}
-	}
-	
-	return true; // Success.
-	
-warnAndFail:
-//	EASLog("Warning: the KDTree may be in an inconsistent state.");
-	return false;
+	return tail.end() != std::find(tail.begin(), tail.end(), query);
 }
 
+#pragma mark - Tree modification
+
 template<int Dim>
 bool
-etchasketch::KDTree<Dim>::insert(KDPoint<Dim> &newPoint,
-								 KDPoint<Dim> &subRoot,
-								 const int dimension)
+etchasketch::KDTree<Dim>::insert(const KDPoint<Dim> &newPoint)
 {
-	// Make sure the new point doesn't already exist.
-	if (newPoint == subRoot) {
+	const size_t index = find(newPoint);
+	if (index < points.size()) {
+		if (!removed[index]) {
+			// It's already here.
+			return false;
+		}
+		// Bring it back.
+		removed[index] = false;
+		removedCount--;
+		adjustLiveCounts(index, 1);
+		return true;
+	}
+	if (tail.end() != std::find(tail.begin(), tail.end(), newPoint)) {
 		return false;
 	}
 	
-	const int nextDimension = (dimension + 1) % Dim;
-	// Should we go left or right?
-	if (smallerDimVal(newPoint, subRoot, dimension)) {
-		// Go left.
-		KDPoint<Dim> *lesser = subRoot.lesserPoints;
-		if (nullptr != lesser) {
-			return insert(newPoint, *lesser, nextDimension);
-		} else {
-			// Put the new point here.
-			subRoot.lesserPoints = &newPoint;
-			// TODO: Clear the lesserPoints and greaterPoints of newKDPoint?
-			return true;
-		}
-	} else {
-		// Go right.
-		KDPoint<Dim> *greater = subRoot.greaterPoints;
-		if (nullptr != greater) {
-			return insert(newPoint, *greater, nextDimension);
-		} else {
-			// Put the new point here.
-			subRoot.greaterPoints = &newPoint;
-			// TODO: Clear the lesserPoints and greaterPoints of newKDPoint?
-			return true;
-		}
+	tail.push_back(newPoint);
+	if (tail.size() > std::max(minimumTailLength, points.size() / 8)) {
+		rebuild();
 	}
+	return true;
 }
 
 template<int Dim>
 bool
 etchasketch::KDTree<Dim>::remove(const KDPoint<Dim> &target)
 {
-	KDPoint<Dim> *targetPtr = nullptr;
-	// Get the parent point.
-	KDPoint<Dim> *parent = const_cast<KDPoint<Dim> *>(getParent(target));
-	if (nullptr != parent) {
-		// Set the parent's reference to the target point to NULL, effectively
-		// removing it from the tree.
-		if ((nullptr != parent->lesserPoints) &&
-			(*parent->lesserPoints == target))
-		{
-			targetPtr = parent->lesserPoints;
-			parent->lesserPoints = nullptr;
-		} else if ((nullptr != parent->greaterPoints) &&
-				   (*parent->greaterPoints == target))
-		{
-			targetPtr = parent->greaterPoints;
-			parent->greaterPoints = nullptr;
+	const size_t index = find(target);
+	if (index < points.size()) {
+		if (removed[index]) {
+			// Target is not in the KDTree; return failure.
+			return false;
 		}
-	} else if ((nullptr != root) && (*root == target)) {
-		// The target is the root node.
-		targetPtr = root;
-		root = nullptr;
-	} else {
-		// Target is not in the KDTree; return failure.
-		return false;
+		removed[index] = true;
+		removedCount++;
+		adjustLiveCounts(index, -1);
+		// Searches skip emptied subtrees, but removed points scattered
+		// through live ones still slow them down, so once enough of the tree
+		// is dead weight start over with just the live points.
+		if (removedCount > maximumRemovedFraction * points.size()) {
+			rebuild();
+		}
+		return true; // Success.
 	}
 	
-	// Reinsert each of its children into the tree.
-	if (nullptr != targetPtr) {
-		// Reinsert the lesser points.
-		insert(targetPtr->lesserPoints);
-		targetPtr->lesserPoints = nullptr;
-		// Reinsert the greater points.
-		insert(targetPtr->greaterPoints);
-		targetPtr->greaterPoints = nullptr;
-		// Delete the now-removed node.
-		delete targetPtr;
+	auto tailIter = std::find(tail.begin(), tail.end(), target);
+	if (tail.end() == tailIter) {
+		// Target is not in the KDTree; return failure.
+		return false;
 	}
+	*tailIter = tail.back();
+	tail.pop_back();
 	return true; // Success.
 }
 
+#pragma mark - Printing
+
 template<int Dim>
-const KDPoint<Dim> *
-etchasketch::KDTree<Dim>::getParent(const KDPoint<Dim> &child) const
+void
+etchasketch::KDTree<Dim>::plainPrint(std::ostream &out) const
 {
-	int dimension = 0;
-	const KDPoint<Dim> *subRoot = root;
-	while (nullptr != subRoot) {
-		// Base case.
-		if (subRoot->isLeaf()) {
-			// No parent exists.
-			return nullptr;
-		}
-		
-		bool lesserIsChild = (nullptr != subRoot->lesserPoints) &&
-				(*subRoot->lesserPoints == child);
-		bool greaterIsChild = (nullptr != subRoot->greaterPoints) &&
-				(*subRoot->greaterPoints == child);
-		if (lesserIsChild || greaterIsChild) {
-			return subRoot;
-		}
-		
-		if (smallerDimVal(child, *subRoot, dimension)) {
-			// Go left.
-			subRoot = subRoot->lesserPoints;
-		} else {
-			// Go right.
-			subRoot = subRoot->greaterPoints;
+	out << "{\"root\": ";
+	// Print all the nodes.
+	printSubtree(out, 0, points.size());
+	out << ", \"tail\": [";
+	for (size_t i = 0; i < tail.size(); i++) {
+		if (i > 0) {
+			out << ", ";
 		}
-		dimension = (dimension + 1) % Dim;
+		tail[i].print(out);
 	}
-	return nullptr;
+	out << "]}";
 }
 
 template<int Dim>
 void
-etchasketch::KDTree<Dim>::plainPrint(std::ostream &out) const
+etchasketch::KDTree<Dim>::printSubtree(std::ostream &out, size_t first,
+									   size_t last) const
 {
-	out << "{\"root\": ";
-	// Print all the nodes.
-	if (nullptr != root) {
-		out << *root;
-	} else {
+	if (first >= last) {
 		out << "null";
+		return;
+	}
+	const size_t median = first + (last - first - 1) / 2;
+	out << "{\"value\": ";
+	points[median].print(out);
+	if (removed[median]) {
+		out << ", \"removed\": true";
 	}
-	out << '}';
+	out << ", \"lesserPoints\": ";
+	printSubtree(out, first, median);
+	out << ", \"greaterPoints\": ";
+	printSubtree(out, median + 1, last);
+	out << "}";
 }
 
 template<int Dim>
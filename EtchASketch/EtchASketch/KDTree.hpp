@@ -9,6 +9,8 @@
 #ifndef KDTree_hpp
 #define KDTree_hpp
 
+#include <stddef.h>
+#include <stdint.h>
 #include <iostream>
 #include <unordered_set>
 #include <vector>
@@ -20,7 +22,20 @@ namespace etchasketch {
 		class KDTreeTests;
 	}
 	
-	/// An implementation of a k-D tree.
+	/**
+	 * An implementation of a k-D tree.
+	 *
+	 * The tree is static and implicit: its points are kept in one flat array
+	 * in the layout described at the constructor, so a node's subtrees are
+	 * found by index arithmetic and no links are stored at all.
+	 *
+	 * Points removed from the tree are only marked as removed. Each subtree
+	 * keeps a count of the live points in it, so searches skip subtrees that
+	 * have been emptied out entirely, and a removal costs a single walk down
+	 * the tree. Points inserted after construction wait in a small unsorted
+	 * tail. Once too much of the tree is removed or the tail grows too long,
+	 * the tree is rebuilt from the points it holds.
+	 */
 	template<int Dim>
 	class KDTree
 	{
@@ -121,13 +136,50 @@ namespace etchasketch {
 		 * subtree can be skipped entirely.
 		 *
 		 * @c findNearestNeighbor should only be called on a valid kd-tree.
+		 * It doesn't allocate, so it's cheap to call once per point.
 		 *
 		 * @param query The point we wish to find the closest neighbor to in the
 		 * tree.
-		 * @return A copy of the closest point to @c query in the KDTree.
+		 * @param nearest Set to the closest point to @c query in the KDTree.
+		 *  Left alone if the tree is empty.
+		 * @param squaredDistance If not @c nullptr, set to the square of the
+		 *  distance from @c query to @c nearest.
+		 * @return @c true if a nearest neighbor was found, or @c false if the
+		 *  tree is empty.
 		 */
-		etchasketch::KDPoint<Dim> *
-		findNearestNeighbor(const etchasketch::KDPoint<Dim> &query) const;
+		bool findNearestNeighbor(const etchasketch::KDPoint<Dim> &query,
+								 etchasketch::KDPoint<Dim> &nearest, // out
+								 float *squaredDistance = nullptr) const; // out
+		
+		/**
+		 * Find the @c k points in the KDTree closest to @c query, using the
+		 * same distance and tie-breaking as @c findNearestNeighbor().
+		 *
+		 * The search keeps the best points so far in a bounded max-heap, so
+		 * it only descends into subtrees that could beat the farthest of
+		 * them. The heap lives in @c nearest itself, so once @c nearest has
+		 * grown to @c k points, later queries don't allocate.
+		 *
+		 * @param query The point to find the neighbors of.
+		 * @param k The number of neighbors to find.
+		 * @param nearest Replaced with the (up to) @c k closest points,
+		 *  nearest first. Holds fewer than @c k if the tree is that small.
+		 */
+		void findKNearest(const etchasketch::KDPoint<Dim> &query, size_t k,
+						  std::vector<etchasketch::KDPoint<Dim>> &nearest) const; // out
+		
+		/**
+		 * Find every point in the KDTree within @c radius of @c query,
+		 * including any at exactly @c radius.
+		 *
+		 * @param query The center of the search.
+		 * @param radius The distance (not squared) to search within.
+		 * @param found Replaced with the points found, in no particular
+		 *  order. Its storage is reused between calls.
+		 */
+		void findWithinRadius(const etchasketch::KDPoint<Dim> &query,
+							  float radius,
+							  std::vector<etchasketch::KDPoint<Dim>> &found) const; // out
 		
 		/**
 		 * Check whether the KD tree contains a given point.
@@ -145,14 +197,30 @@ namespace etchasketch {
 		bool insert(const etchasketch::KDPoint<Dim> &newPoint);
 		
 		/**
-		 * Remove a given node from the KD tree, then delete the node. The
-		 * target's subtrees are retained in the KD tree.
-		 * @param target The node to be removed and deleted.
+		 * Remove a point from the KD tree.
+		 * @param target The point to be removed.
 		 * @return @c true if @c target was successfully removed, @c false
 		 *  otherwise.
 		 */
 		bool remove(const etchasketch::KDPoint<Dim> &target);
 		
+		/**
+		 * Set how much of the tree may be removed before it's rebuilt, as a
+		 * fraction of the points laid out when it was last built. Since
+		 * searches skip subtrees with nothing left in them, removing points
+		 * in spatial order (as the salesmen do) leaves the tree fast even
+		 * when most of it is gone, so this can be close to 1. Defaults to
+		 * @c defaultMaximumRemovedFraction.
+		 */
+		void setMaximumRemovedFraction(double fraction)
+			{ maximumRemovedFraction = fraction; }
+		
+		static const double defaultMaximumRemovedFraction;
+		
+		/// The number of points in the tree.
+		inline size_t size() const
+			{ return points.size() - removedCount + tail.size(); }
+		
 		/// Print the KD tree, one node at a time.
 		void print(std::ostream &out = std::cout, bool prettyJSON = true) const;
 		
@@ -161,41 +229,85 @@ namespace etchasketch {
 			{ print(); }
 		
 	private:
-		/// This is the root node of our KDTree representation.
-		etchasketch::KDPoint<Dim> *root;
+		/**
+		 * The points of the tree, in the implicit layout: the root of the
+		 * subtree over [first, last) is at (first + last - 1) / 2.
+		 */
+		std::vector<etchasketch::KDPoint<Dim>> points;
 		
-		/// Helper function for the KDTree constructor.
-		void
-		buildTree(const std::unordered_set<etchasketch::KDPoint<Dim>> &points);
+		/// Whether each point in @c points has been removed.
+		std::vector<bool> removed;
+		
+		/// The number of points in @c points that have been removed.
+		size_t removedCount;
+		
+		/**
+		 * For each subtree, the number of points in it that haven't been
+		 * removed, stored at the index of the subtree's root.
+		 */
+		std::vector<uint32_t> liveCounts;
+		
+		/// The fraction of @c points that may be removed before a rebuild.
+		double maximumRemovedFraction;
+		
+		/// Points inserted since the tree was last built, in no order.
+		std::vector<etchasketch::KDPoint<Dim>> tail;
+		
+		/// The tail is merged into the tree once it's longer than this.
+		static const size_t minimumTailLength = 32;
+		
+		/// Build the tree from scratch from @c newPoints, which hold no duplicates.
+		void buildTree(std::vector<etchasketch::KDPoint<Dim>> &&newPoints);
 		
 		/**
-		 * Delete a subtree.
-		 * @param subRoot inout The root of the subtree to be deleted.
+		 * Lay out the points in [@c first, @c last) as a subtree splitting on
+		 * @c dimension.
 		 */
-		void deleteSubtree(etchasketch::KDPoint<Dim> *subRoot);
+		void buildSubtree(size_t first, size_t last, int dimension);
+		
+		/// Rebuild the tree from its remaining points and the tail.
+		void rebuild();
+		
+		/// The index in @c points of @c query, or @c points.size() if absent.
+		size_t find(const etchasketch::KDPoint<Dim> &query) const;
+		
+		/**
+		 * Add @c delta to the live count of every subtree containing
+		 * @c points[index].
+		 */
+		void adjustLiveCounts(size_t index, int delta);
 		
 		/**
-		 * Like regular insert, but takes a pointer for a pre-copied point.
-		 * @return @c true on success, or @c false on failure.
+		 * Search the subtree over [@c first, @c last) for a point closer to
+		 * @c query than @c best, updating @c best and @c bestDist as it goes.
 		 */
-		bool insert(etchasketch::KDPoint<Dim> *newPoint);
+		void findNearestNeighbor(const etchasketch::KDPoint<Dim> &query,
+								 size_t first, size_t last,
+								 const int dimension,
+								 const etchasketch::KDPoint<Dim> *&best, // inout
+								 double &bestDist) const; // inout
 		
 		/**
-		 * Helper function for insert.
-		 * @return @c true on success, or @c false on failure.
+		 * Search the subtree over [@c first, @c last) for points closer to
+		 * @c query than the farthest in @c heap, keeping the @c k closest.
 		 */
-		bool insert(etchasketch::KDPoint<Dim> &newPoint,
-					etchasketch::KDPoint<Dim> &subRoot,
-					const int dimension);
+		void findKNearest(const etchasketch::KDPoint<Dim> &query, size_t k,
+						  size_t first, size_t last, const int dimension,
+						  std::vector<etchasketch::KDPoint<Dim>> &heap) const; // inout
 		
-		const etchasketch::KDPoint<Dim> *
-		getParent(const etchasketch::KDPoint<Dim> &child) const;
+		/// Offer @c candidate to the bounded max-heap of @c k neighbors.
+		void offerNeighbor(const etchasketch::KDPoint<Dim> &query, size_t k,
+						   const etchasketch::KDPoint<Dim> &candidate,
+						   std::vector<etchasketch::KDPoint<Dim>> &heap) const; // inout
 		
-		const etchasketch::KDPoint<Dim> *
-		findNearestNeighbor(const etchasketch::KDPoint<Dim> &query,
-							const etchasketch::KDPoint<Dim> *subroot,
-							double &currentBestDist, // inout
-							const int dimension) const;
+		/**
+		 * Add the points in the subtree over [@c first, @c last) that are no
+		 * farther than @c squaredRadius from @c query to @c found.
+		 */
+		void findWithinRadius(const etchasketch::KDPoint<Dim> &query,
+							  float squaredRadius,
+							  size_t first, size_t last, const int dimension,
+							  std::vector<etchasketch::KDPoint<Dim>> &found) const; // inout
 		
 		/**
 		 * Determines if KDPoint a is smaller than KDPoint b in a given
@@ -261,6 +373,9 @@ namespace etchasketch {
 						   const etchasketch::KDPoint<Dim> &potential) const;
 		
 		void plainPrint(std::ostream &out) const;
+		
+		/// Print the subtree over [@c first, @c last) as JSON.
+		void printSubtree(std::ostream &out, size_t first, size_t last) const;
 	};
 	
 	template<int Dim>
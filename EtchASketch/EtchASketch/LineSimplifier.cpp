@@ -8,124 +8,435 @@
 
 #include "EASUtils+Private.hpp"
 #include "LineSimplifier.hpp"
+#include "SIMDSupport.hpp"
+#include <algorithm>
+#include <utility>
 
-using std::list;
+using std::pair;
 using std::vector;
 using etchasketch::KDPoint;
+using etchasketch::ThreadPool;
+
+typedef pair<size_t, size_t> Segment;
+
+static_assert(sizeof(KDPoint<2>) == 2 * sizeof(etchasketch::KDPointCoordinate),
+			  "The vector kernels read a line as x, y, x, y, ...");
+
+/// Points measured at a time when looking for the farthest point. Only the
+/// block it turns up in is searched for the point itself.
+static const size_t scanBlockLength = 256;
+
+/// Segments shorter than this aren't worth splitting up between threads.
+static const size_t minForkLength = 4096;
+
+/// Segments at least this long have their farthest point found by the whole
+/// pool, rather than by the calling thread alone.
+static const size_t minSharedScanLength = 1 << 18;
+
+/// How many segments to hand each thread, so those whose segments finish
+/// early have more to take.
+static const size_t segmentsPerThread = 4;
+
+/**
+ * The farthest point from a segment. It's measured by the magnitude of the
+ * cross product, which is its distance from the segment's line times the
+ * segment's length and so an integer, or by its squared distance from the
+ * start when the segment is only a point.
+ */
+struct FarthestPoint {
+	size_t index;
+	int64_t measure;
+};
 
 // Forward declares
 
-static float distFromLineSquared(const list<KDPoint<2>>::iterator pointIt,
-								 const list<KDPoint<2>>::iterator startIt,
-								 const list<KDPoint<2>>::iterator endIt) __attribute__((pure));
+/// Whether the line's coordinates span less than 2^25 on each axis, so the
+/// cross products, at up to 2^51, come out exact in a double.
+static bool fitsVectorKernels(const vector<KDPoint<2>> &line) __attribute__((pure));
 
 /**
  * Find the point on the line that lies the maximum distance from a line drawn
- * through the @c beginning and @c end points.
+ * through the @c first and @c last points.
  *
- * @param beginning An iterator pointing to the first point of the line segment.
- * @param end An iterator pointing to the last point of the line segment.
- * @param outMaxDist An output parameter that contains the distance of the
- * farthest point from the line.
+ * @param line The points.
+ * @param first The index of the first point of the line segment.
+ * @param last The index of the last point of the line segment. There must be
+ * at least one point between @c first and @c last.
+ * @param outMaxDist An output parameter that contains the squared distance of
+ * the farthest point from the line.
+ * @param vectorsAreExact Whether the vector kernels can be used.
+ * @param pool The threads to share the search with, or @c nullptr.
+ * @return The index of the farthest point. Ties go to the earliest.
  */
-static const list<KDPoint<2>>::iterator
-findMaxDistPoint(const list<KDPoint<2>>::iterator &beginning,
-				 const list<KDPoint<2>>::iterator &end,
-				 float *outMaxDist);
+static size_t
+findMaxDistPoint(const vector<KDPoint<2>> &line, size_t first, size_t last,
+				 double *outMaxDist, bool vectorsAreExact, ThreadPool *pool);
 
 etchasketch::LineSimplifier::LineSimplifier(float epsilon)
-: epsilon(epsilon), line(nullptr)
+: epsilon(epsilon), jumpLength(0.0f), threadPool(nullptr)
 { }
 
 void
-etchasketch::LineSimplifier::simplifyLine(vector<KDPoint<2>> &lineVect)
+etchasketch::LineSimplifier::simplifyLine(vector<KDPoint<2>> &line)
 {
-	EASLog("Before simplification: %lu points", lineVect.size());
-	
-    // Convert to a doubly linked list.
-    line = new list<KDPoint<2>>(lineVect.begin(), lineVect.end());
-    // Safety checks
-    if (line->empty()) {
-        return;
-    }
-    
-	// Call out to our implementation.
-	douglasPeucker(line->begin(), line->end());
-	
-	// Convert back to a vector and clean up.
-	lineVect.assign(line->begin(), line->end());
-	delete this->line;
-	this->line = nullptr;
-	
-	EASLog("After simplification: %lu points", lineVect.size());
+	EASLog("Before simplification: %lu points", line.size());
+
+	// Safety checks
+	if (line.size() <= 2) {
+		return;
+	}
+
+	// Mark the points to keep; the ends of each piece always stay.
+	vector<uint8_t> keep(line.size(), 0);
+	vector<Segment> segments = findPieces(line, keep);
+	const bool vectorsAreExact = fitsVectorKernels(line);
+	if (threadPool && (threadPool->getThreadCount() > 1)) {
+		forkSegments(line, segments, keep, vectorsAreExact);
+		// Segments only mark points strictly inside themselves, so no two
+		// threads write the same flag.
+		threadPool->parallelFor(segments.size(), [&](size_t index) {
+			douglasPeucker(line, segments[index].first, segments[index].second,
+						   keep, vectorsAreExact);
+		});
+	} else {
+		for (const Segment &segment : segments) {
+			douglasPeucker(line, segment.first, segment.second, keep, vectorsAreExact);
+		}
+	}
+
+	// Slide the kept points down over the rest.
+	size_t keptCount = 0;
+	for (size_t i = 0; i < line.size(); i++) {
+		if (keep[i]) {
+			line[keptCount++] = line[i];
+		}
+	}
+	line.resize(keptCount);
+
+	EASLog("After simplification: %lu points", line.size());
+}
+
+vector<Segment>
+etchasketch::LineSimplifier::findPieces(const vector<KDPoint<2>> &line,
+										vector<uint8_t> &keep) const // inout
+{
+	vector<Segment> pieces;
+	keep.front() = 1;
+	keep.back() = 1;
+	if (jumpLength <= 0.0f) {
+		pieces.push_back(std::make_pair(0, line.size() - 1));
+		return pieces;
+	}
+
+	const double jumpLengthSquared = static_cast<double>(jumpLength) * jumpLength;
+	size_t pieceStart = 0;
+	for (size_t i = 1; i < line.size(); i++) {
+		const int64_t dx = line[i][0] - line[i - 1][0];
+		const int64_t dy = line[i][1] - line[i - 1][1];
+		if (static_cast<double>((dx * dx) + (dy * dy)) > jumpLengthSquared) {
+			// The pen has to get to both ends of the jump.
+			keep[i - 1] = 1;
+			keep[i] = 1;
+			if (i - 1 > pieceStart) {
+				pieces.push_back(std::make_pair(pieceStart, i - 1));
+			}
+			pieceStart = i;
+		}
+	}
+	if (line.size() - 1 > pieceStart) {
+		pieces.push_back(std::make_pair(pieceStart, line.size() - 1));
+	}
+	return pieces;
 }
 
 void
-etchasketch::LineSimplifier::douglasPeucker(const list<KDPoint<2>>::iterator &start,
-											const list<KDPoint<2>>::iterator &end) const
+etchasketch::LineSimplifier::forkSegments(const vector<KDPoint<2>> &line,
+										  vector<Segment> &segments, // inout
+										  vector<uint8_t> &keep, // inout
+										  bool vectorsAreExact) const
 {
-	// Safety first; make sure there's at least one point between the endpoints.
-	if ((start == end) || (std::next(start) == end)) {
-        return; // Nothing to do; no points to potentially remove.
-    }
-	
-	float maxDist;
-    const list<KDPoint<2>>::iterator farPtIter = findMaxDistPoint(start, end, &maxDist);
-	// Check if we can eliminate any points.
-	if (maxDist > epsilon) {
-		// We can't remove the farthest point, but we can split the line at the
-		// farthest point and recurse.
-		douglasPeucker(start, std::prev(farPtIter));
-		douglasPeucker(std::next(farPtIter), end);
-	} else {
-		// Since the farthest point is within our margin of error, we can safely
-		// remove all points between the start and end points.
-		line->erase(std::next(start), end);
+	const size_t wantedCount = segmentsPerThread * threadPool->getThreadCount();
+	auto isShorter = [](const Segment &a, const Segment &b) {
+		return (a.second - a.first) < (b.second - b.first);
+	};
+	std::make_heap(segments.begin(), segments.end(), isShorter);
+	while (!segments.empty() && (segments.size() < wantedCount)) {
+		const Segment longest = segments.front();
+		if (longest.second - longest.first < minForkLength) {
+			break;
+		}
+		std::pop_heap(segments.begin(), segments.end(), isShorter);
+		segments.pop_back();
+
+		// The same split douglasPeucker() would make.
+		double maxDist;
+		const size_t farPt = findMaxDistPoint(line, longest.first, longest.second, &maxDist,
+											  vectorsAreExact, threadPool);
+		if (maxDist > epsilon) {
+			keep[farPt] = 1;
+			segments.push_back(std::make_pair(longest.first, farPt));
+			std::push_heap(segments.begin(), segments.end(), isShorter);
+			segments.push_back(std::make_pair(farPt, longest.second));
+			std::push_heap(segments.begin(), segments.end(), isShorter);
+		}
+	}
+	// Start the longest first, so they aren't left until the end.
+	std::sort(segments.begin(), segments.end(), [&](const Segment &a, const Segment &b) {
+		return isShorter(b, a);
+	});
+}
+
+void
+etchasketch::LineSimplifier::douglasPeucker(const vector<KDPoint<2>> &line,
+											size_t first, size_t last,
+											vector<uint8_t> &keep, // inout
+											bool vectorsAreExact) const
+{
+	vector<pair<size_t, size_t>> segments;
+	segments.push_back(std::make_pair(first, last));
+	while (!segments.empty()) {
+		const size_t start = segments.back().first;
+		const size_t end = segments.back().second;
+		segments.pop_back();
+		// Make sure there's at least one point between the endpoints.
+		if (end - start < 2) {
+			continue; // Nothing to do; no points to potentially remove.
+		}
+
+		double maxDist;
+		const size_t farPt = findMaxDistPoint(line, start, end, &maxDist,
+											  vectorsAreExact, nullptr);
+		// Check if we can eliminate any points.
+		if (maxDist > epsilon) {
+			// We can't remove the farthest point, but we can split the line
+			// at the farthest point and simplify each side.
+			keep[farPt] = 1;
+			segments.push_back(std::make_pair(start, farPt));
+			segments.push_back(std::make_pair(farPt, end));
+		}
+		// Otherwise, the farthest point is within our margin of error, so all
+		// the points between the start and end points can go; they're
+		// already unmarked.
 	}
 }
 
-// There must be at least one point between beginning and end.
 static
-const list<KDPoint<2>>::iterator
-findMaxDistPoint(const list<KDPoint<2>>::iterator &beginning,
-				 const list<KDPoint<2>>::iterator &end,
-				 float *outMaxDist)
+bool
+fitsVectorKernels(const vector<KDPoint<2>> &line)
+{
+	int64_t minX = line.front()[0], maxX = minX;
+	int64_t minY = line.front()[1], maxY = minY;
+	for (const KDPoint<2> &point : line) {
+		minX = std::min<int64_t>(minX, point[0]);
+		maxX = std::max<int64_t>(maxX, point[0]);
+		minY = std::min<int64_t>(minY, point[1]);
+		maxY = std::max<int64_t>(maxY, point[1]);
+	}
+	const int64_t limit = int64_t(1) << 25;
+	return (maxX - minX < limit) && (maxY - minY < limit);
+}
+
+#pragma mark - Measuring
+
+/// The magnitude of the cross product of @c point - @c start with the
+/// segment's direction, (@c dx, @c dy).
+static inline int64_t
+crossMagnitude(const KDPoint<2> &point, const KDPoint<2> &start, int64_t dx, int64_t dy)
+{
+	// Work in 64 bits; the cross product alone can overflow 32.
+	const int64_t px = point[0] - start[0];
+	const int64_t py = point[1] - start[1];
+	const int64_t cross = (dx * py) - (dy * px);
+	return (cross < 0) ? -cross : cross;
+}
+
+static double
+blockMaxCrossScalar(const KDPoint<2> *points, size_t count,
+					const KDPoint<2> &start, int64_t dx, int64_t dy)
+{
+	int64_t maxCross = 0;
+	for (size_t i = 0; i < count; i++) {
+		maxCross = std::max(maxCross, crossMagnitude(points[i], start, dx, dy));
+	}
+	return static_cast<double>(maxCross);
+}
+
+#if EAS_HAVE_SSE2
+
+static double
+blockMaxCrossSSE2(const KDPoint<2> *points, size_t count,
+				  const KDPoint<2> &start, int64_t dx, int64_t dy)
 {
-    list<KDPoint<2>>::iterator curFarthestPoint = beginning;
-    float curFarthestDist = -1.0f;
-    
-    // Check each point between beginning and end.
-    list<KDPoint<2>>::iterator curPoint = beginning;
-    while (++curPoint != end) {
-		float dist = distFromLineSquared(curPoint, beginning, end);
-		if (dist > curFarthestDist) {
-			curFarthestDist = dist;
-			curFarthestPoint = curPoint;
+	const __m128d startX = _mm_set1_pd(start[0]);
+	const __m128d startY = _mm_set1_pd(start[1]);
+	const __m128d deltaX = _mm_set1_pd(static_cast<double>(dx));
+	const __m128d deltaY = _mm_set1_pd(static_cast<double>(dy));
+	const __m128d signBit = _mm_set1_pd(-0.0);
+	__m128d maxCross = _mm_setzero_pd();
+	size_t i = 0;
+	// 2 points per iteration.
+	for (; i + 2 <= count; i += 2) {
+		// x0 y0 x1 y1 -> x0 x1 y0 y1
+		const __m128i xy = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&points[i]));
+		const __m128i xxyy = _mm_shuffle_epi32(xy, _MM_SHUFFLE(3, 1, 2, 0));
+		const __m128d px = _mm_sub_pd(_mm_cvtepi32_pd(xxyy), startX);
+		const __m128d py = _mm_sub_pd(_mm_cvtepi32_pd(_mm_unpackhi_epi64(xxyy, xxyy)), startY);
+		const __m128d cross = _mm_sub_pd(_mm_mul_pd(deltaX, py), _mm_mul_pd(deltaY, px));
+		maxCross = _mm_max_pd(maxCross, _mm_andnot_pd(signBit, cross));
+	}
+	maxCross = _mm_max_sd(maxCross, _mm_unpackhi_pd(maxCross, maxCross));
+	return std::max(_mm_cvtsd_f64(maxCross),
+					blockMaxCrossScalar(points + i, count - i, start, dx, dy));
+}
+
+#endif // EAS_HAVE_SSE2
+
+// 32-bit ARM has no double-precision NEON, so it stays scalar.
+#if EAS_HAVE_NEON && defined(__aarch64__)
+
+static double
+blockMaxCrossNEON(const KDPoint<2> *points, size_t count,
+				  const KDPoint<2> &start, int64_t dx, int64_t dy)
+{
+	const float64x2_t startX = vdupq_n_f64(start[0]);
+	const float64x2_t startY = vdupq_n_f64(start[1]);
+	const float64x2_t deltaX = vdupq_n_f64(static_cast<double>(dx));
+	const float64x2_t deltaY = vdupq_n_f64(static_cast<double>(dy));
+	float64x2_t maxCross = vdupq_n_f64(0.0);
+	size_t i = 0;
+	// 2 points per iteration.
+	for (; i + 2 <= count; i += 2) {
+		const int32x2x2_t xy = vld2_s32(reinterpret_cast<const int32_t *>(&points[i]));
+		const float64x2_t px = vsubq_f64(vcvtq_f64_s64(vmovl_s32(xy.val[0])), startX);
+		const float64x2_t py = vsubq_f64(vcvtq_f64_s64(vmovl_s32(xy.val[1])), startY);
+		const float64x2_t cross = vsubq_f64(vmulq_f64(deltaX, py), vmulq_f64(deltaY, px));
+		maxCross = vmaxq_f64(maxCross, vabsq_f64(cross));
+	}
+	return std::max(vmaxvq_f64(maxCross),
+					blockMaxCrossScalar(points + i, count - i, start, dx, dy));
+}
+
+static const bool haveVectorKernel = true;
+
+#elif EAS_HAVE_SSE2
+
+static const bool haveVectorKernel = true;
+
+#else
+
+static const bool haveVectorKernel = false;
+
+#endif
+
+/**
+ * The largest cross product magnitude among @c count points, using the
+ * fastest kernel available. Only exact if the line fits the vector kernels.
+ */
+static inline double
+blockMaxCross(const KDPoint<2> *points, size_t count,
+			  const KDPoint<2> &start, int64_t dx, int64_t dy)
+{
+#if EAS_HAVE_NEON && defined(__aarch64__)
+	return blockMaxCrossNEON(points, count, start, dx, dy);
+#elif EAS_HAVE_SSE2
+	return blockMaxCrossSSE2(points, count, start, dx, dy);
+#else
+	return blockMaxCrossScalar(points, count, start, dx, dy);
+#endif
+}
+
+/**
+ * Find the farthest of the points [@c begin, @c end) from the segment between
+ * @c first and @c last. Ties go to the earliest.
+ */
+static FarthestPoint
+findFarthestPoint(const vector<KDPoint<2>> &line, size_t first, size_t last,
+				  size_t begin, size_t end, bool vectorsAreExact)
+{
+	const KDPoint<2> &start = line[first];
+	const int64_t dx = line[last][0] - start[0];
+	const int64_t dy = line[last][1] - start[1];
+	FarthestPoint farthest = { begin, -1 };
+
+	if ((0 == dx) && (0 == dy)) {
+		// The segment is a single point, so measure to that.
+		for (size_t i = begin; i < end; i++) {
+			const int64_t px = line[i][0] - start[0];
+			const int64_t py = line[i][1] - start[1];
+			const int64_t distSquared = (px * px) + (py * py);
+			if (distSquared > farthest.measure) {
+				farthest.measure = distSquared;
+				farthest.index = i;
+			}
 		}
-    }
-	
-	// Return the results.
-	*outMaxDist = curFarthestDist;
-	return curFarthestPoint;
+		return farthest;
+	}
+
+	if (haveVectorKernel && vectorsAreExact) {
+		// Find the first block holding the farthest point, then only look
+		// for it in there.
+		size_t farthestBlock = begin;
+		double farthestBlockCross = -1.0;
+		for (size_t block = begin; block < end; block += scanBlockLength) {
+			const size_t count = std::min(scanBlockLength, end - block);
+			const double cross = blockMaxCross(&line[block], count, start, dx, dy);
+			if (cross > farthestBlockCross) {
+				farthestBlockCross = cross;
+				farthestBlock = block;
+			}
+		}
+		begin = farthestBlock;
+		end = std::min(farthestBlock + scanBlockLength, end);
+	}
+	for (size_t i = begin; i < end; i++) {
+		const int64_t cross = crossMagnitude(line[i], start, dx, dy);
+		if (cross > farthest.measure) {
+			farthest.measure = cross;
+			farthest.index = i;
+		}
+	}
+	return farthest;
 }
 
 static
-float
-distFromLineSquared(const list<KDPoint<2>>::iterator pointIt,
-					const list<KDPoint<2>>::iterator startIt,
-					const list<KDPoint<2>>::iterator endIt)
+size_t
+findMaxDistPoint(const vector<KDPoint<2>> &line, size_t first, size_t last,
+				 double *outMaxDist, bool vectorsAreExact, ThreadPool *pool)
 {
-	const KDPoint<2> &point = *pointIt;
-	const KDPoint<2> &start = *startIt;
-	const KDPoint<2> &end   = *endIt;
-	
-	KDPointCoordinate proj = (end[1] - start[1]) * point[0] -
-							 (end[0] - start[0]) * point[1] +
-									      end[0] * start[1] -
-							              end[1] * start[0];
-	proj = proj * proj;
-	KDPointCoordinate dx = end[0] - start[0];
-	KDPointCoordinate dy = end[1] - start[1];
-	KDPointCoordinate scale = (dx * dx) + (dy * dy);
-	return static_cast<float>(proj) / static_cast<float>(scale);
+	FarthestPoint farthest;
+	if (pool && (last - first >= minSharedScanLength)) {
+		// Each thread finds the farthest of its share, then the farthest of
+		// those wins, or the earliest on a tie, as it would in one pass.
+		const size_t chunkCount = pool->getThreadCount();
+		const size_t chunkLength = (last - first - 1 + chunkCount - 1) / chunkCount;
+		vector<FarthestPoint> farthestInChunk(chunkCount, FarthestPoint{ first + 1, -1 });
+		pool->parallelFor(chunkCount, [&](size_t chunk) {
+			const size_t begin = std::min(first + 1 + (chunk * chunkLength), last);
+			const size_t end = std::min(begin + chunkLength, last);
+			if (begin < end) {
+				farthestInChunk[chunk] = findFarthestPoint(line, first, last, begin, end,
+															vectorsAreExact);
+			}
+		});
+		farthest = farthestInChunk.front();
+		for (const FarthestPoint &candidate : farthestInChunk) {
+			if (candidate.measure > farthest.measure) {
+				farthest = candidate;
+			}
+		}
+	} else {
+		farthest = findFarthestPoint(line, first, last, first + 1, last, vectorsAreExact);
+	}
+
+	// Return the results.
+	const int64_t dx = line[last][0] - line[first][0];
+	const int64_t dy = line[last][1] - line[first][1];
+	const int64_t scale = (dx * dx) + (dy * dy);
+	if (0 == scale) {
+		*outMaxDist = static_cast<double>(farthest.measure);
+	} else {
+		const double proj = static_cast<double>(farthest.measure);
+		*outMaxDist = (proj * proj) / static_cast<double>(scale);
+	}
+	return farthest.index;
 }
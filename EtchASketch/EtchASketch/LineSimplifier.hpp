@@ -9,23 +9,36 @@
 #ifndef LineSimplifier_hpp
 #define LineSimplifier_hpp
 
-#include <list>
+#include <stddef.h>
+#include <stdint.h>
+#include <utility>
 #include <vector>
 #include "KDPoint.hpp"
+#include "ThreadPool.hpp"
 
 namespace etchasketch {
 
 /**
  * Removes extra points to "simplify" a line while maintaining a certain level
  * of quality.
+ *
+ * Works in place on the line: a pass of Douglas-Peucker marks the points to
+ * keep, and a second pass slides them down over the ones that go. Segments
+ * still to be split wait on an explicit stack rather than the call stack, so
+ * a line of millions of points can't overflow it.
+ *
+ * The two halves of a split never touch each other's points, so with a
+ * thread pool the longest segments are split on the calling thread until
+ * there are enough to go around, and then the threads finish them off
+ * independently. Either way the same points are kept.
  */
 class LineSimplifier {
 public:
 	/**
 	 * Create a new @c LineSimplifier.
 	 * 
-	 * @param epsilon The minimum distance a point needs to be from a line in
-	 * order to be kept.
+	 * @param epsilon The minimum squared distance a point needs to be from a
+	 * line in order to be kept.
 	 */
 	LineSimplifier(float epsilon = 50.0f);
 	
@@ -33,30 +46,69 @@ public:
 	 * Remove any points from the line if its removal doesn't change the path
 	 * taken by too much.
 	 * 
-	 * @note This method is not reentrant.
-	 *
 	 * @param line (inout) The ordered points that make up the line.
 	 */
 	void simplifyLine(std::vector<etchasketch::KDPoint<2>> &line);
 	
+	/**
+	 * Simplify on the threads of @c pool, or on the calling thread if it's
+	 * @c nullptr. The pool isn't owned, and must outlive its use here.
+	 */
+	inline void setThreadPool(etchasketch::ThreadPool *pool)
+		{ threadPool = pool; }
+	
+	/**
+	 * Treat any step in the line longer than @c length as a jump between
+	 * separate pieces of the drawing, and simplify the pieces on their own.
+	 * Both ends of every jump are kept, so the pen never lands somewhere the
+	 * jump didn't go. 0, the default, simplifies the line as one piece.
+	 */
+	inline void setJumpLength(float length)
+		{ jumpLength = length; }
+	
 private:
-	/// The minimum distance a point must be from a line in order to be kept.
+	/// The minimum squared distance a point must be from a line to be kept.
 	const float epsilon;
 	
-	/// A doubly linked list containing the line we're currently working on.
-	std::list<etchasketch::KDPoint<2>> *line;
+	/// Steps longer than this split the line into pieces, or 0 for none.
+	float jumpLength;
+	
+	etchasketch::ThreadPool *threadPool;
+	
+	/**
+	 * Split the line into the segments to simplify: the whole line, or the
+	 * pieces between jumps. The ends of each are marked in @c keep.
+	 */
+	std::vector<std::pair<size_t, size_t>>
+	findPieces(const std::vector<etchasketch::KDPoint<2>> &line,
+			   std::vector<uint8_t> &keep) const; // inout
+	
+	/**
+	 * Split the longest of @c segments on the calling thread until there are
+	 * enough for each thread of the pool to have a few, or they're all too
+	 * short to be worth sharing.
+	 */
+	void forkSegments(const std::vector<etchasketch::KDPoint<2>> &line,
+					  std::vector<std::pair<size_t, size_t>> &segments, // inout
+					  std::vector<uint8_t> &keep, // inout
+					  bool vectorsAreExact) const;
 	
 	/**
 	 * Implementation of @c simplifyLine(). Uses the Douglas-Peucker line
 	 * simplification algorithm.
 	 *
-	 * @param start The first point in the line segment.
-	 * @param end The last point in the line segment.
+	 * @param line The points.
+	 * @param first The first point in the line segment.
+	 * @param last The last point in the line segment.
+	 * @param keep Set to 1 for each point strictly between @c first and
+	 * @c last that has to stay. The rest are left alone.
+	 * @param vectorsAreExact Whether the line's coordinates are small enough
+	 * for the vector kernels to measure distances exactly.
 	 */
-	void
-	douglasPeucker(const std::list<etchasketch::KDPoint<2>>::iterator &start,
-				   const std::list<etchasketch::KDPoint<2>>::iterator &end)
-	const;
+	void douglasPeucker(const std::vector<etchasketch::KDPoint<2>> &line,
+						size_t first, size_t last,
+						std::vector<uint8_t> &keep, // inout
+						bool vectorsAreExact) const;
 };
 
 }
@@ -8,16 +8,44 @@
 
 #include "NearestNeighborSalesman.hpp"
 #include "EASUtils.hpp"
+#include "HilbertSalesman.hpp"
+#include <algorithm>
+#include <stdint.h>
 
-using std::unordered_set;
 using std::vector;
+using etchasketch::EdgePointBuffer;
+using etchasketch::GridIndex;
 using etchasketch::KDTree;
 using etchasketch::KDPoint;
+using etchasketch::KDPointCoordinate;
+using etchasketch::salesman::HilbertSalesman;
+
+namespace {
+
+/// A rectangle of pixels, inclusive of its edges.
+struct Tile {
+	KDPointCoordinate minX, minY, maxX, maxY;
+};
+
+/// The square of the distance from @c point to the closest pixel in @c tile.
+int64_t
+squaredDistanceToTile(const KDPoint<2> &point, const Tile &tile)
+{
+	const int64_t dx = std::max(std::max(tile.minX - point[0], point[0] - tile.maxX), 0);
+	const int64_t dy = std::max(std::max(tile.minY - point[1], point[1] - tile.maxY), 0);
+	return dx * dx + dy * dy;
+}
+
+}
 
 etchasketch::salesman::NearestNeighborSalesman::NearestNeighborSalesman(
-																		const unordered_set<KDPoint<2>> &unorderedPoints, const KDPoint<2> &startPoint)
+																		const EdgePointBuffer &unorderedPoints, const KDPoint<2> &startPoint,
+																		NeighborIndex neighborIndex)
 : startPoint(startPoint),
-unorderedPoints(unorderedPoints)
+unorderedPoints(unorderedPoints),
+neighborIndex(neighborIndex),
+threadPool(nullptr),
+pointsPerTile(0)
 {
 }
 
@@ -28,43 +56,162 @@ etchasketch::salesman::NearestNeighborSalesman::~NearestNeighborSalesman()
 void
 etchasketch::salesman::NearestNeighborSalesman::orderPoints()
 {
-	// Create a K-D tree with the points.
-	KDTree<2> kdTree = KDTree<2>(unorderedPoints);
+	if (!unorderedPoints.contains(startPoint[0], startPoint[1])) {
+		EASLog("Error: unorderedPoints does not contain the starting point");
+		exit(1);
+	}
+	orderedPoints.clear();
+	if (0 != pointsPerTile && unorderedPoints.size() >= 4 * pointsPerTile) {
+		orderPointsInTiles();
+		return;
+	}
 	
-	nearestNeighborAlgorithm(kdTree);
+	orderedPoints.reserve(unorderedPoints.size());
+	switch (neighborIndex) {
+		case NeighborIndex::KDTree: {
+			// Create a K-D tree with the points.
+			KDTree<2> kdTree = KDTree<2>(unorderedPoints.copyAsKDPoints());
+			nearestNeighborAlgorithm(kdTree, startPoint, orderedPoints);
+			break;
+		}
+		case NeighborIndex::Grid: {
+			GridIndex grid(unorderedPoints.copyAsKDPoints());
+			nearestNeighborAlgorithm(grid, startPoint, orderedPoints);
+			break;
+		}
+	}
 }
 
 void
-etchasketch::salesman::NearestNeighborSalesman::nearestNeighborAlgorithm(KDTree<2> &kdTree)
+etchasketch::salesman::NearestNeighborSalesman::orderPointsInTiles()
 {
-	// Assume that we start at (0, 0).
-	const KDPoint<2> startPoint(0, 0);
-	if (1 != unorderedPoints.erase(startPoint)) {
-		EASLog("Error: unorderedPoints does not contain the starting point");
-		exit(1);
+	const size_t pointCount = unorderedPoints.size();
+	
+	// A square grid of tiles over the points' bounds, a power of two on a
+	// side so the Hilbert curve can order them, with at least pointsPerTile
+	// points per tile if they were spread evenly.
+	KDPointCoordinate width = 1, height = 1;
+	for (size_t i = 0; i < pointCount; i++) {
+		width = std::max(width, static_cast<KDPointCoordinate>(unorderedPoints.getX(i)) + 1);
+		height = std::max(height, static_cast<KDPointCoordinate>(unorderedPoints.getY(i)) + 1);
 	}
-	orderedPoints.push_back(startPoint);
-	kdTree.remove(startPoint);
+	unsigned order = 1;
+	while (static_cast<size_t>(1) << (2 * (order + 1)) <= pointCount / pointsPerTile) {
+		order++;
+	}
+	const uint32_t tilesPerSide = static_cast<uint32_t>(1) << order;
+	const size_t tileCount = static_cast<size_t>(tilesPerSide) * tilesPerSide;
+	const KDPointCoordinate tileWidth = (width + tilesPerSide - 1) / tilesPerSide;
+	const KDPointCoordinate tileHeight = (height + tilesPerSide - 1) / tilesPerSide;
 	
-	while (!unorderedPoints.empty()) {
-//		EASLog("Size remaining: %lu", unorderedPoints.size());
-		
-		// Find the next point nearest the last point we added, add it to the
-		// list of ordered points, and remove it as an option in the list of
-		// unordered point list.
-		KDPoint<2> *currPoint = kdTree.findNearestNeighbor(orderedPoints.back());
-		if ((nullptr != currPoint) && currPoint->isValid()) {
-			orderedPoints.push_back(*currPoint);
-			
-			// erase returns the number of elements removed.
-			if (1 != unorderedPoints.erase(*currPoint)) {
-				EASLog("Failed to remove the current value.");
+	// Number the tiles along the curve, starting from the start point's tile
+	// and coming back around to the beginning of the curve after the end.
+	const uint32_t startIndex = HilbertSalesman::curveIndex(startPoint[0] / tileWidth,
+															startPoint[1] / tileHeight, order);
+	auto tileNumber = [=](EdgePointBuffer::Coordinate x, EdgePointBuffer::Coordinate y) {
+		const uint32_t index = HilbertSalesman::curveIndex(x / tileWidth, y / tileHeight, order);
+		return (index - startIndex) & (tileCount - 1);
+	};
+	vector<Tile> tiles(tileCount);
+	for (uint32_t tileY = 0; tileY < tilesPerSide; tileY++) {
+		for (uint32_t tileX = 0; tileX < tilesPerSide; tileX++) {
+			const KDPointCoordinate minX = tileX * tileWidth, minY = tileY * tileHeight;
+			tiles[tileNumber(minX, minY)] = { minX, minY, minX + tileWidth - 1, minY + tileHeight - 1 };
+		}
+	}
+	
+	// Group the points by tile with a counting sort, so each tile's points
+	// stay in row-major order.
+	vector<size_t> tileStarts(tileCount + 1, 0);
+	for (size_t i = 0; i < pointCount; i++) {
+		tileStarts[tileNumber(unorderedPoints.getX(i), unorderedPoints.getY(i)) + 1]++;
+	}
+	for (size_t tile = 0; tile < tileCount; tile++) {
+		tileStarts[tile + 1] += tileStarts[tile];
+	}
+	vector<KDPoint<2>> tilePoints(pointCount);
+	{
+		vector<size_t> next(tileStarts.begin(), tileStarts.end() - 1);
+		for (size_t i = 0; i < pointCount; i++) {
+			const EdgePointBuffer::Coordinate x = unorderedPoints.getX(i), y = unorderedPoints.getY(i);
+			tilePoints[next[tileNumber(x, y)]++] = KDPoint<2>(x, y);
+		}
+	}
+	
+	// Each walk starts at the point closest to the last tile that had any,
+	// which is where the walk before it most likely ended up. The first
+	// starts at the start point.
+	vector<KDPoint<2>> entries(tileCount);
+	size_t previousTile = 0;
+	entries[0] = startPoint;
+	for (size_t tile = 1; tile < tileCount; tile++) {
+		if (tileStarts[tile] == tileStarts[tile + 1]) {
+			continue;
+		}
+		int64_t bestDistance = INT64_MAX;
+		for (size_t i = tileStarts[tile]; i < tileStarts[tile + 1]; i++) {
+			const int64_t distance = squaredDistanceToTile(tilePoints[i], tiles[previousTile]);
+			if (distance < bestDistance) {
+				bestDistance = distance;
+				entries[tile] = tilePoints[i];
 			}
-			// Remove the point from the KDTree and delete our copy of it.
-			kdTree.remove(*currPoint);
-			delete currPoint;
-		} else {
-			EASLog("KDTree.findNearestNeighbor returned a bad currPoint.");
 		}
+		previousTile = tile;
+	}
+	
+	// Walk the tiles, then join them up.
+	vector<vector<KDPoint<2>>> walks(tileCount);
+	auto walkTile = [&](size_t tile) {
+		if (tileStarts[tile] == tileStarts[tile + 1]) {
+			return;
+		}
+		vector<KDPoint<2>> points(tilePoints.begin() + tileStarts[tile],
+								  tilePoints.begin() + tileStarts[tile + 1]);
+		walks[tile].reserve(points.size());
+		switch (neighborIndex) {
+			case NeighborIndex::KDTree: {
+				KDTree<2> kdTree = KDTree<2>(points);
+				nearestNeighborAlgorithm(kdTree, entries[tile], walks[tile]);
+				break;
+			}
+			case NeighborIndex::Grid: {
+				GridIndex grid(points);
+				nearestNeighborAlgorithm(grid, entries[tile], walks[tile]);
+				break;
+			}
+		}
+	};
+	if (nullptr != threadPool) {
+		threadPool->parallelFor(tileCount, walkTile);
+	} else {
+		for (size_t tile = 0; tile < tileCount; tile++) {
+			walkTile(tile);
+		}
+	}
+	orderedPoints.reserve(pointCount);
+	for (vector<KDPoint<2>> &walk : walks) {
+		orderedPoints.insert(orderedPoints.end(), walk.begin(), walk.end());
+		vector<KDPoint<2>>().swap(walk);
+	}
+}
+
+template<typename Index>
+void
+etchasketch::salesman::NearestNeighborSalesman::nearestNeighborAlgorithm(Index &index,
+																		  const KDPoint<2> &start,
+																		  vector<KDPoint<2>> &path) // out
+{
+	path.push_back(start);
+	index.remove(start);
+	
+	// The index holds exactly the points not yet ordered.
+	// Find the next point nearest the last point we added, add it to the
+	// list of ordered points, and remove it as an option.
+	KDPoint<2> currPoint;
+	while (index.findNearestNeighbor(path.back(), currPoint)) {
+		path.push_back(currPoint);
+		
+		// Remove the point from the index.
+		index.remove(currPoint);
 	}
 }
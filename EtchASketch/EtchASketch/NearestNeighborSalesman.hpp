@@ -9,28 +9,79 @@
 #ifndef NearestNeighborSalesman_hpp
 #define NearestNeighborSalesman_hpp
 
-#include <unordered_set>
+#include <stddef.h>
 #include <vector>
+#include "EdgePointBuffer.hpp"
+#include "GridIndex.hpp"
 #include "KDPoint.hpp"
 #include "KDTree.hpp"
 #include "Salesman.hpp"
+#include "ThreadPool.hpp"
 
 namespace etchasketch {
 	namespace salesman {
 		
-		/// Solves the traveling salesman problem.
+		/**
+		 * The spatial index @c NearestNeighborSalesman looks up neighbors in.
+		 * Both give the same tour.
+		 */
+		enum class NeighborIndex {
+			/// A @c KDTree<2>.
+			KDTree,
+			
+			/**
+			 * A @c GridIndex. Usually faster on edge points, since they're
+			 * packed into a raster and the tour mostly moves a pixel at a time.
+			 */
+			Grid,
+		};
+		
+		/**
+		 * Solves the traveling salesman problem.
+		 *
+		 * Tiling splits the image into a grid of tiles, walks each tile on
+		 * its own, and joins the walks in the order a Hilbert curve visits
+		 * the tiles, so neighboring tiles follow each other. Each walk
+		 * starts at the point closest to the tile before it. The tiles
+		 * don't depend on each other, so they're walked on the thread pool.
+		 * The tile grid only depends on the points, so the tour is the same
+		 * whatever the thread count, though the joins make it a little
+		 * longer than a single walk.
+		 */
 		class NearestNeighborSalesman : public Salesman {
 			
   public:
-			/// The startPoint must be contained within the unorderedPoints.
-			NearestNeighborSalesman(const std::unordered_set<KDPoint<2>> &unorderedPoints,
-									const KDPoint<2> &startPoint);
+			/**
+			 * The startPoint must be contained within the unorderedPoints,
+			 * which must outlive the salesman.
+			 */
+			NearestNeighborSalesman(const EdgePointBuffer &unorderedPoints,
+									const KDPoint<2> &startPoint,
+									NeighborIndex neighborIndex = NeighborIndex::Grid);
 			
 			virtual ~NearestNeighborSalesman();
 			
 			/// Order the points for the best drawing order.
 			virtual void orderPoints();
 			
+			/**
+			 * Walk the tiles on the threads of @c pool, or on the calling
+			 * thread if it's @c nullptr. The pool isn't owned, and must
+			 * outlive its use here.
+			 */
+			inline void setThreadPool(etchasketch::ThreadPool *pool)
+				{ threadPool = pool; }
+			
+			/**
+			 * Split the points into tiles of about @c count points each.
+			 * Pass 0, the default, to order all the points in one walk.
+			 */
+			inline void setPointsPerTile(size_t count)
+				{ pointsPerTile = count; }
+			
+			/// A tile size that keeps the tour within a few percent.
+			static const size_t suggestedPointsPerTile = 16384;
+			
 			/// Get a copy of the ordered points.
 			const std::vector<KDPoint<2>> *getOrderedPoints() const
 			{
@@ -41,18 +92,37 @@ namespace etchasketch {
 			/// The point at which we begin drawing.
 			const KDPoint<2> startPoint;
 			
-			/// The current set of points that have not yet been ordered. 
-			std::unordered_set<KDPoint<2>> unorderedPoints;
+			/// The points to put in order.
+			const EdgePointBuffer &unorderedPoints;
+			
+			/// Where to look up neighbors.
+			const NeighborIndex neighborIndex;
 			
   private:
+			etchasketch::ThreadPool *threadPool;
+			
+			size_t pointsPerTile;
+			
 			/**
 			 * Add the nearest neighbor to the last point added until we run out
 			 * of points to add.
 			 *
 			 * @discussion This algorithm produces lots of large lines all the
 			 * way across the image.
+			 *
+			 * @param index The unordered points, in a @c KDTree<2> or a
+			 * @c GridIndex.
+			 * @param start Where to begin. It must be in @c index.
+			 * @param path Filled with every point in @c index, in order.
+			 *  @c index ends up empty.
 			 */
-			void nearestNeighborAlgorithm(KDTree<2> &kdTree);
+			template<typename Index>
+			static void nearestNeighborAlgorithm(Index &index,
+												 const KDPoint<2> &start,
+												 std::vector<KDPoint<2>> &path); // out
+			
+			/// Fill @c orderedPoints by walking each tile and joining them.
+			void orderPointsInTiles();
 		};
 	}
 }
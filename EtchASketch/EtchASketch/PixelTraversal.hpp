@@ -0,0 +1,166 @@
+//
+//  PixelTraversal.hpp
+//  EtchASketch
+//
+
+#ifndef PixelTraversal_hpp
+#define PixelTraversal_hpp
+
+#include <stddef.h>
+#include "ThreadPool.hpp"
+
+namespace etchasketch {
+namespace traversal {
+
+/*
+ * Images are stored row-major, so the traversal helpers always walk x in the
+ * innermost loop. Every image-processing stage should go through these
+ * instead of hand-rolling its loops, so the memory access pattern is decided
+ * in one place.
+ */
+
+/**
+ * Edge length of a tile sized for the L1 data cache. A 64x64 tile of 32-bit
+ * pixels is 16 KiB, leaving room in a 32 KiB L1 for the output.
+ */
+static const size_t l1TileSize = 64;
+
+/**
+ * Edge length of a tile sized for the L2 cache. A 128x128 tile of 32-bit
+ * pixels is 64 KiB, comfortably inside the Pi 3's 512 KiB shared L2.
+ */
+static const size_t l2TileSize = 128;
+
+/**
+ * Call @c rowFunction(y) for each row in [@c firstRow, @c lastRow), top to
+ * bottom.
+ */
+template<typename RowFunction>
+inline void
+forEachRow(size_t firstRow, size_t lastRow, RowFunction rowFunction)
+{
+	for (size_t y = firstRow; y < lastRow; y++) {
+		rowFunction(y);
+	}
+}
+
+/**
+ * Call @c pixelFunction(x, y) for each pixel in the rectangle with top-left
+ * corner (@c left, @c top), in row-major order.
+ */
+template<typename PixelFunction>
+inline void
+forEachPixel(size_t left, size_t top, size_t width, size_t height,
+			 PixelFunction pixelFunction)
+{
+	const size_t right = left + width;
+	const size_t bottom = top + height;
+	for (size_t y = top; y < bottom; y++) {
+		for (size_t x = left; x < right; x++) {
+			pixelFunction(x, y);
+		}
+	}
+}
+
+/// Call @c pixelFunction(x, y) for each pixel of a @c width by @c height image.
+template<typename PixelFunction>
+inline void
+forEachPixel(size_t width, size_t height, PixelFunction pixelFunction)
+{
+	forEachPixel(0, 0, width, height, pixelFunction);
+}
+
+/**
+ * Split a @c width by @c height image into square tiles and call
+ * @c tileFunction(left, top, tileWidth, tileHeight) for each one. Tiles are
+ * visited in row-major order; tiles on the right and bottom edges are clipped
+ * to the image.
+ *
+ * Use this for stages that read a neighborhood around each pixel, so the
+ * rows of the neighborhood stay cache-resident while a tile is processed.
+ */
+template<typename TileFunction>
+inline void
+forEachTile(size_t width, size_t height, size_t tileSize,
+			TileFunction tileFunction)
+{
+	for (size_t top = 0; top < height; top += tileSize) {
+		const size_t tileHeight = (height - top < tileSize) ? (height - top)
+															: tileSize;
+		for (size_t left = 0; left < width; left += tileSize) {
+			const size_t tileWidth = (width - left < tileSize) ? (width - left)
+															   : tileSize;
+			tileFunction(left, top, tileWidth, tileHeight);
+		}
+	}
+}
+
+/**
+ * Visit each pixel of a @c width by @c height image tile by tile, calling
+ * @c pixelFunction(x, y). Within a tile, pixels are visited in row-major
+ * order.
+ */
+template<typename PixelFunction>
+inline void
+forEachPixelTiled(size_t width, size_t height, size_t tileSize,
+				  PixelFunction pixelFunction)
+{
+	forEachTile(width, height, tileSize,
+				[&pixelFunction](size_t left, size_t top,
+								 size_t tileWidth, size_t tileHeight) {
+		forEachPixel(left, top, tileWidth, tileHeight, pixelFunction);
+	});
+}
+
+/**
+ * The smallest band @c forEachRowBand() will split an image into, so the
+ * halo rows a stage re-reads at each band's edges stay a small fraction of
+ * the work.
+ */
+static const size_t minimumRowsPerBand = 16;
+
+/**
+ * Split the rows [@c firstRow, @c lastRow) into horizontal bands and call
+ * @c bandFunction(bandFirstRow, bandLastRow) for each, in parallel on
+ * @c pool. If @c pool is @c nullptr, the bands are run in order on the
+ * calling thread.
+ *
+ * Bands run in no particular order, so each one must only write its own
+ * output rows. A stage that reads a neighborhood around each row reads the
+ * halo rows above and below its band straight from the shared input, and any
+ * running state (like a sliding window of rows) has to be primed at the start
+ * of every band. As long as each output row is computed the same way no
+ * matter which band it lands in, the result doesn't depend on the number of
+ * threads.
+ */
+template<typename BandFunction>
+inline void
+forEachRowBand(etchasketch::ThreadPool *pool, size_t firstRow, size_t lastRow,
+			   BandFunction bandFunction)
+{
+	if (lastRow <= firstRow) {
+		return;
+	}
+	const size_t rowCount = lastRow - firstRow;
+	if (nullptr == pool || 1 == pool->getThreadCount()) {
+		bandFunction(firstRow, lastRow);
+		return;
+	}
+	// A few bands per thread evens out the load.
+	size_t rowsPerBand = rowCount / (4 * pool->getThreadCount());
+	if (rowsPerBand < minimumRowsPerBand) {
+		rowsPerBand = minimumRowsPerBand;
+	}
+	const size_t bandCount = (rowCount + rowsPerBand - 1) / rowsPerBand;
+	pool->parallelFor(bandCount, [&](size_t band) {
+		const size_t bandFirstRow = firstRow + band * rowsPerBand;
+		const size_t bandLastRow = (lastRow - bandFirstRow < rowsPerBand)
+								   ? lastRow : (bandFirstRow + rowsPerBand);
+		bandFunction(bandFirstRow, bandLastRow);
+	});
+}
+
+}
+}
+
+#endif /* PixelTraversal_hpp */
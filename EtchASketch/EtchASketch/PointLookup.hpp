@@ -0,0 +1,63 @@
+//
+//  PointLookup.hpp
+//  EtchASketch
+//
+
+#ifndef PointLookup_hpp
+#define PointLookup_hpp
+
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include "KDPoint.hpp"
+
+namespace etchasketch {
+
+/**
+ * Maps points to the numbers they were added with, such as their index in
+ * a path. Add every point, call @c sort(), then look them up. Each entry is
+ * a 64-bit key and a 32-bit value in one sorted array, so there's no
+ * hashing, and lookups are binary searches.
+ *
+ * Coordinates must not be negative.
+ */
+class PointLookup {
+public:
+	/// Make room for @c count points in all.
+	inline void reserve(size_t count)
+		{ entries.reserve(count); }
+
+	/// Map @c point to @c value. Call @c sort() before looking it up.
+	inline void add(const etchasketch::KDPoint<2> &point, uint32_t value)
+		{ entries.push_back(std::make_pair(keyForPoint(point), value)); }
+
+	/// Get ready for lookups, once every point is added.
+	inline void sort()
+		{ std::sort(entries.begin(), entries.end()); }
+
+	/**
+	 * The value @c point was added with. The point must have been added; if
+	 * it was added more than once, the smallest of its values.
+	 */
+	inline uint32_t find(const etchasketch::KDPoint<2> &point) const
+	{
+		return std::lower_bound(entries.begin(), entries.end(),
+								std::make_pair(keyForPoint(point),
+											   static_cast<uint32_t>(0)))->second;
+	}
+
+private:
+	/// A key for a point that sorts the same way the point does.
+	static inline uint64_t keyForPoint(const etchasketch::KDPoint<2> &point)
+	{
+		return (static_cast<uint64_t>(point[0]) << 32) | static_cast<uint32_t>(point[1]);
+	}
+
+	std::vector<std::pair<uint64_t, uint32_t>> entries;
+};
+
+}
+
+#endif /* PointLookup_hpp */
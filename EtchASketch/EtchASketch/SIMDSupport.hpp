@@ -0,0 +1,35 @@
+//
+//  SIMDSupport.hpp
+//  EtchASketch
+//
+
+#ifndef SIMDSupport_hpp
+#define SIMDSupport_hpp
+
+/*
+ * Pulls in the vector intrinsics for the target CPU and says which kernels
+ * can be built:
+ *
+ * EAS_HAVE_SSE2  SSE2 is enabled at compile time (always, on x86-64).
+ * EAS_HAVE_AVX2  AVX2 kernels can be compiled. They must be marked with
+ *                __attribute__((target("avx2"))) and only called after
+ *                checking __builtin_cpu_supports("avx2").
+ * EAS_HAVE_NEON  NEON is enabled at compile time on a little-endian ARM CPU.
+ *                The kernels assume pixels are laid out little-endian.
+ */
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define EAS_HAVE_AVX2 1
+#if defined(__SSE2__)
+#define EAS_HAVE_SSE2 1
+#endif
+#endif
+
+#if (defined(__ARM_NEON) || defined(__ARM_NEON__)) && \
+	(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#include <arm_neon.h>
+#define EAS_HAVE_NEON 1
+#endif
+
+#endif /* SIMDSupport_hpp */
@@ -9,8 +9,13 @@
 #ifndef Salesman_hpp
 #define Salesman_hpp
 
+#include <functional>
 #include <vector>
+#include "EdgePointBuffer.hpp"
+#include "Image.hpp"
 #include "KDPoint.hpp"
+#include "StrategyRegistry.hpp"
+#include "ThreadPool.hpp"
 
 namespace etchasketch {
 namespace salesman {
@@ -37,6 +42,56 @@ class Salesman {
 	std::vector<etchasketch::KDPoint<2>> orderedPoints;
 };
 
+/// What a salesman factory has to work with.
+struct SalesmanInputs {
+	/// The edge points, in row-major order.
+	const etchasketch::EdgePointBuffer *edgePoints;
+
+	/**
+	 * The grayscale image. Only kept for salesmen that draw it, and
+	 * @c nullptr for the rest.
+	 */
+	const etchasketch::GrayImage *grayscaleImage;
+
+	/// Where the drawing has to start. It's one of the edge points.
+	etchasketch::KDPoint<2> startPoint;
+
+	/// The pool to run on. Not owned.
+	etchasketch::ThreadPool *threadPool;
+};
+
+/// Makes a salesman. See @c salesmen().
+struct SalesmanFactory {
+	/**
+	 * Make a salesman with the given parameters, all of them filled in. The
+	 * caller owns it, and it mustn't outlive the inputs.
+	 */
+	std::function<Salesman *(const SalesmanInputs &inputs,
+							 const etchasketch::StrategyParameters &parameters)> create;
+
+	/**
+	 * Whether the salesman sweeps over the grayscale image instead of
+	 * putting the edge points in order. Its points are then in the image's
+	 * coordinates, and there's no tour for the tour optimizer to shorten.
+	 */
+	bool drawsGrayscaleImage;
+};
+
+/**
+ * The ways @c ImageFlow can put the edge points in drawing order:
+ *
+ * - nearest-neighbor: @c NearestNeighborSalesman. The default.
+ * - tiled-nearest-neighbor: @c NearestNeighborSalesman in tiles, on the
+ *   thread pool. A few percent longer, but it scales with the thread count.
+ * - bitmap: @c BitmapSalesman, the same tour found on a bitmap.
+ * - chain: @c ChainSalesman, tracing each edge whole.
+ * - spanning-tree: @c SpanningTreeSalesman.
+ * - hilbert: @c HilbertSalesman. The fastest by far, but the longest path,
+ *   unless the tour optimizer shortens it.
+ * - bob-and-weave: @c BobAndWeaveSalesman, which sweeps the grayscale image.
+ */
+etchasketch::StrategyRegistry<SalesmanFactory> & salesmen();
+
 }
 }
 
@@ -7,43 +7,48 @@
 //
 
 #include "SobelEdgeDetector.hpp"
+#include "PixelTraversal.hpp"
+#include "SIMDSupport.hpp"
+#include <string.h>
+#include <vector>
 
-using etchasketch::Image;
-using Pixel = etchasketch::Image::Pixel;
+using etchasketch::EdgeMask;
+using etchasketch::GrayImage;
+using Pixel = etchasketch::GrayImage::Pixel;
+using Word = etchasketch::EdgeMask::Word;
+using etchasketch::traversal::forEachRow;
+using etchasketch::traversal::forEachRowBand;
 
-etchasketch::edgedetect::SobelEdgeDetector::SobelEdgeDetector()
-: etchasketch::edgedetect::EdgeDetector()
-{ }
+/*
+ * Both Sobel kernels are separable. With a, b, and c the rows above, at, and
+ * below the pixel:
+ *
+ *   gx = [1 2 1] applied along the row to (c - a)
+ *   gy = [1 0 -1] applied along the row to (a + 2b + c)
+ *
+ * On 8-bit pixels both fit easily in an int16_t. The detector used to compute
+ * the gradients in float, on intensities divided by 255, and compare them
+ * against 0.6 and 0.4. Scaled up, those thresholds are 153 and 102. Any
+ * gradient further than one step from a threshold lands on the same side of
+ * it in float and in integer arithmetic, but a gradient exactly on a
+ * threshold can go either way depending on float rounding, so those rare
+ * pixels are handed to the original float code to keep the edge map
+ * identical.
+ */
 
-Image *
-etchasketch::edgedetect::SobelEdgeDetector::detectEdges(
-		const Image &grayscaleImage) const
-{
-	// dst's width and height are each 1 less than the grayscaleImage.
-	Image *dst = new Image(grayscaleImage.getWidth()-1,
-						   grayscaleImage.getHeight()-1);
-	
-	for (int x = 1; x < grayscaleImage.getWidth() - 1; x++) {
-		for (int y = 1; y < grayscaleImage.getHeight() - 1; y++) {
-			KDPoint<2> dstPt(x-1, y-1);
-			float intensity = intensityForPoint(grayscaleImage, x, y);
-			// Scale the float intensity into an RGBA pixel.
-			uint8_t intensityInt = static_cast<uint8_t>(intensity * 255.0f);
-			Pixel intensityPixel =    (intensityInt << 24)
-									| (intensityInt << 16)
-									| (intensityInt <<  8)
-									|  0xFF;
-			(*dst)[dstPt] = intensityPixel;
-		}
-	}
-	
-	return dst;
-}
+/// 0.6 * 255. @c gx above this is an edge.
+static const int16_t gxThreshold = 153;
+
+/// 0.4 * 255. @c gy above this is an edge.
+static const int16_t gyThreshold = 102;
 
-float
-etchasketch::edgedetect::SobelEdgeDetector::intensityForPoint(const Image &img,
-															  const int x,
-															  const int y) const
+/**
+ * The original float evaluation of the thresholded gradient at column @c x.
+ * Only used to settle gradients that land exactly on a threshold.
+ */
+static bool
+isEdgeReference(const Pixel *rowAbove, const Pixel *row, const Pixel *rowBelow,
+				const size_t x)
 {
 	static float sobelX[3][3] = {
 		{ -1.0f, -2.0f, -1.0f },
@@ -55,32 +60,306 @@ etchasketch::edgedetect::SobelEdgeDetector::intensityForPoint(const Image &img,
 		{ 2.0f, 0.0f, -2.0f },
 		{ 1.0f, 0.0f, -1.0f }
 	};
-	
+
 	// Find the gradient across this pixel.
 	float sumX = 0.0f;
 	float sumY = 0.0f;
+	const Pixel * const rows[3] = { rowAbove, row, rowBelow };
 	for (int dy = -1; dy <= 1; dy++) {
 		for (int dx = -1; dx <= 1; dx++) {
-			KDPoint<2> pt(x + dx, y + dy);
-			// Pixels are in RGBA format.
-			Pixel px = img[pt];
-			px = (px >> 8) & 0xFF;
+			const Pixel px = rows[dy+1][x + dx];
 			float currentIntensity = static_cast<float>(px) / 255.0f;
 			sumX += sobelX[dy+1][dx+1] * currentIntensity;
 			sumY += sobelY[dy+1][dx+1] * currentIntensity;
 		}
 	}
-	
-	float outputVal; // 1.0 to output white, 0.0 to output black.
-	
+
 	// Filter out values below a threshold.
 	float thresholdX = 0.6f;
 	float thresholdY = 0.4f;
-	if (sumX >= thresholdX || sumY >= thresholdY) {
-		outputVal = 1.0f;
-	} else {
-		outputVal = 0.0f;
+	return (sumX >= thresholdX || sumY >= thresholdY);
+}
+
+/// Set bit @c x of a row of mask words.
+static inline void
+setBit(Word *maskRow, size_t x)
+{
+	maskRow[x / EdgeMask::bitsPerWord] |=
+		static_cast<Word>(1) << (x % EdgeMask::bitsPerWord);
+}
+
+/**
+ * Scalar version of the row kernel. Fills in output columns
+ * [@c first, @c count), where output column @c i is centered on input column
+ * @c i + 1.
+ */
+static void
+detectRowScalar(const Pixel *a, const Pixel *b, const Pixel *c,
+				size_t first, size_t count, Word *maskRow)
+{
+	for (size_t i = first; i < count; i++) {
+		const int16_t gx = (c[i] - a[i]) + 2 * (c[i+1] - a[i+1])
+						   + (c[i+2] - a[i+2]);
+		const int16_t gy = (a[i] + 2 * b[i] + c[i])
+						   - (a[i+2] + 2 * b[i+2] + c[i+2]);
+		bool isEdge = (gx > gxThreshold) || (gy > gyThreshold);
+		if (!isEdge && ((gx == gxThreshold) || (gy == gyThreshold))) {
+			isEdge = isEdgeReference(a, b, c, i + 1);
+		}
+		if (isEdge) {
+			setBit(maskRow, i);
+		}
+	}
+}
+
+/**
+ * Merge 16 output bits starting at output column @c i into the mask,
+ * settling any ties with the float code.
+ */
+static inline void
+storeBits(const Pixel *a, const Pixel *b, const Pixel *c, size_t i,
+		  uint32_t edgeBits, uint32_t tieBits, Word *maskRow)
+{
+	// Blocks of 16 start on a multiple of 16, so they never straddle words.
+	maskRow[i / EdgeMask::bitsPerWord] |=
+		static_cast<Word>(edgeBits) << (i % EdgeMask::bitsPerWord);
+	tieBits &= ~edgeBits;
+	while (tieBits != 0) {
+		const size_t bit = __builtin_ctz(tieBits);
+		tieBits &= tieBits - 1;
+		if (isEdgeReference(a, b, c, i + bit + 1)) {
+			setBit(maskRow, i + bit);
+		}
+	}
+}
+
+#if EAS_HAVE_SSE2
+
+/// Compute gx and gy for 8 pixels, given their neighborhoods widened to int16.
+static inline void
+gradientsSSE2(__m128i a0, __m128i a1, __m128i a2,
+			  __m128i b0, __m128i b2,
+			  __m128i c0, __m128i c1, __m128i c2,
+			  __m128i &gx, __m128i &gy)
+{
+	const __m128i d1 = _mm_sub_epi16(c1, a1);
+	gx = _mm_add_epi16(_mm_add_epi16(_mm_sub_epi16(c0, a0),
+									 _mm_sub_epi16(c2, a2)),
+					   _mm_add_epi16(d1, d1));
+	const __m128i v0 = _mm_add_epi16(_mm_add_epi16(a0, c0), _mm_add_epi16(b0, b0));
+	const __m128i v2 = _mm_add_epi16(_mm_add_epi16(a2, c2), _mm_add_epi16(b2, b2));
+	gy = _mm_sub_epi16(v0, v2);
+}
+
+static void
+detectRowSSE2(const Pixel *a, const Pixel *b, const Pixel *c,
+			  size_t count, Word *maskRow)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i gxLimit = _mm_set1_epi16(gxThreshold);
+	const __m128i gyLimit = _mm_set1_epi16(gyThreshold);
+	size_t i = 0;
+	// 16 pixels per iteration.
+	for (; i + 16 <= count; i += 16) {
+		#define LOAD(row, offset) \
+			_mm_loadu_si128(reinterpret_cast<const __m128i *>((row) + i + (offset)))
+		const __m128i a0 = LOAD(a, 0), a1 = LOAD(a, 1), a2 = LOAD(a, 2);
+		const __m128i b0 = LOAD(b, 0), b2 = LOAD(b, 2);
+		const __m128i c0 = LOAD(c, 0), c1 = LOAD(c, 1), c2 = LOAD(c, 2);
+		#undef LOAD
+
+		__m128i edge[2], tie[2];
+		for (int half = 0; half < 2; half++) {
+			#define WIDEN(v) \
+				(half == 0 ? _mm_unpacklo_epi8((v), zero) : _mm_unpackhi_epi8((v), zero))
+			__m128i gx, gy;
+			gradientsSSE2(WIDEN(a0), WIDEN(a1), WIDEN(a2), WIDEN(b0), WIDEN(b2),
+						  WIDEN(c0), WIDEN(c1), WIDEN(c2), gx, gy);
+			#undef WIDEN
+			edge[half] = _mm_or_si128(_mm_cmpgt_epi16(gx, gxLimit),
+									  _mm_cmpgt_epi16(gy, gyLimit));
+			tie[half] = _mm_or_si128(_mm_cmpeq_epi16(gx, gxLimit),
+									 _mm_cmpeq_epi16(gy, gyLimit));
+		}
+		const uint32_t edgeBits = _mm_movemask_epi8(_mm_packs_epi16(edge[0], edge[1]));
+		const uint32_t tieBits = _mm_movemask_epi8(_mm_packs_epi16(tie[0], tie[1]));
+		storeBits(a, b, c, i, edgeBits, tieBits, maskRow);
+	}
+	detectRowScalar(a, b, c, i, count, maskRow);
+}
+
+#endif // EAS_HAVE_SSE2
+
+#if EAS_HAVE_NEON
+
+/// Gather the top bit of each byte lane into a 16-bit mask.
+static inline uint32_t
+movemaskNEON(uint8x16_t mask)
+{
+	static const uint8_t laneBits[16] = {
+		1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128
+	};
+	const uint8x16_t bits = vandq_u8(mask, vld1q_u8(laneBits));
+	uint8x8_t sums = vpadd_u8(vget_low_u8(bits), vget_high_u8(bits));
+	sums = vpadd_u8(sums, sums);
+	sums = vpadd_u8(sums, sums);
+	return vget_lane_u8(sums, 0) | (vget_lane_u8(sums, 1) << 8);
+}
+
+/// Widen 8 bytes to int16 lanes.
+static inline int16x8_t
+widenNEON(uint8x8_t v)
+{
+	return vreinterpretq_s16_u16(vmovl_u8(v));
+}
+
+static void
+detectRowNEON(const Pixel *a, const Pixel *b, const Pixel *c,
+			  size_t count, Word *maskRow)
+{
+	const int16x8_t gxLimit = vdupq_n_s16(gxThreshold);
+	const int16x8_t gyLimit = vdupq_n_s16(gyThreshold);
+	size_t i = 0;
+	// 16 pixels per iteration.
+	for (; i + 16 <= count; i += 16) {
+		const uint8x16_t a0 = vld1q_u8(a + i), a1 = vld1q_u8(a + i + 1), a2 = vld1q_u8(a + i + 2);
+		const uint8x16_t b0 = vld1q_u8(b + i), b2 = vld1q_u8(b + i + 2);
+		const uint8x16_t c0 = vld1q_u8(c + i), c1 = vld1q_u8(c + i + 1), c2 = vld1q_u8(c + i + 2);
+
+		uint16x8_t edge[2], tie[2];
+		for (int half = 0; half < 2; half++) {
+			#define WIDEN(v) widenNEON(half == 0 ? vget_low_u8(v) : vget_high_u8(v))
+			const int16x8_t d1 = vsubq_s16(WIDEN(c1), WIDEN(a1));
+			const int16x8_t gx = vaddq_s16(vaddq_s16(vsubq_s16(WIDEN(c0), WIDEN(a0)),
+													 vsubq_s16(WIDEN(c2), WIDEN(a2))),
+										   vaddq_s16(d1, d1));
+			const int16x8_t v0 = vaddq_s16(vaddq_s16(WIDEN(a0), WIDEN(c0)),
+										   vshlq_n_s16(WIDEN(b0), 1));
+			const int16x8_t v2 = vaddq_s16(vaddq_s16(WIDEN(a2), WIDEN(c2)),
+										   vshlq_n_s16(WIDEN(b2), 1));
+			const int16x8_t gy = vsubq_s16(v0, v2);
+			#undef WIDEN
+			edge[half] = vorrq_u16(vcgtq_s16(gx, gxLimit), vcgtq_s16(gy, gyLimit));
+			tie[half] = vorrq_u16(vceqq_s16(gx, gxLimit), vceqq_s16(gy, gyLimit));
+		}
+		const uint32_t edgeBits = movemaskNEON(vcombine_u8(vmovn_u16(edge[0]),
+														   vmovn_u16(edge[1])));
+		const uint32_t tieBits = movemaskNEON(vcombine_u8(vmovn_u16(tie[0]),
+														  vmovn_u16(tie[1])));
+		storeBits(a, b, c, i, edgeBits, tieBits, maskRow);
+	}
+	detectRowScalar(a, b, c, i, count, maskRow);
+}
+
+#endif // EAS_HAVE_NEON
+
+/**
+ * Fill in one row of the mask from the three image rows around it, using the
+ * fastest kernel available. @c width is the width of the image rows.
+ */
+static inline void
+detectRow(const Pixel *rowAbove, const Pixel *row, const Pixel *rowBelow,
+		  size_t width, Word *maskRow)
+{
+#if EAS_HAVE_NEON
+	detectRowNEON(rowAbove, row, rowBelow, width - 2, maskRow);
+#elif EAS_HAVE_SSE2
+	detectRowSSE2(rowAbove, row, rowBelow, width - 2, maskRow);
+#else
+	detectRowScalar(rowAbove, row, rowBelow, 0, width - 2, maskRow);
+#endif
+}
+
+#pragma mark - Row detector
+
+namespace {
+
+/// Streams an image through the Sobel kernels, holding three rows of it.
+class SobelRowDetector : public etchasketch::edgedetect::RowEdgeDetector {
+public:
+	SobelRowDetector(size_t width, size_t height)
+	: width(width), height(height), rows(3 * width), rowCount(0),
+	  mask((width > 0) ? (width - 1) : 0, 1)
+	{ }
+
+	virtual size_t getMaskWidth() const
+		{ return mask.getWidth(); }
+
+	virtual size_t getMaskHeight() const
+		{ return (height > 0) ? (height - 1) : 0; }
+
+	virtual size_t getWindowHeight() const
+		{ return 3; }
+
+	virtual const Word *pushRow(const Pixel *row)
+	{
+		memcpy(&rows[(rowCount % 3) * width], row, width * sizeof(Pixel));
+		rowCount++;
+		if (rowCount < 3 || width < 3) {
+			return nullptr;
+		}
+		Word *maskRow = mask.getRow(0);
+		memset(maskRow, 0, mask.getWordsPerRow() * sizeof(Word));
+		detectRow(&rows[(rowCount % 3) * width],
+				  &rows[((rowCount + 1) % 3) * width],
+				  &rows[((rowCount + 2) % 3) * width],
+				  width, maskRow);
+		return maskRow;
+	}
+
+private:
+	size_t width;
+
+	size_t height;
+
+	/// The last three rows pushed in, as a ring.
+	std::vector<Pixel> rows;
+
+	/// The number of rows pushed in so far.
+	size_t rowCount;
+
+	/// A single row, handed back from @c pushRow().
+	EdgeMask mask;
+};
+
+}
+
+#pragma mark -
+
+etchasketch::edgedetect::SobelEdgeDetector::SobelEdgeDetector()
+: etchasketch::edgedetect::EdgeDetector()
+{ }
+
+EdgeMask *
+etchasketch::edgedetect::SobelEdgeDetector::detectEdges(
+		const GrayImage &grayscaleImage) const
+{
+	// dst's width and height are each 1 less than the grayscaleImage.
+	EdgeMask *dst = new EdgeMask(grayscaleImage.getWidth()-1,
+								 grayscaleImage.getHeight()-1);
+
+	// Slide a 3-row window down each band of the image. Each pass fills in
+	// the output columns [0, width - 2), which keeps every read inside the
+	// image. Rows don't depend on each other, so bands need no priming.
+	const size_t width = grayscaleImage.getWidth();
+	const size_t height = grayscaleImage.getHeight();
+	if (width < 3 || height < 3) {
+		return dst;
 	}
-	
-	return outputVal;
+	forEachRowBand(threadPool, 1, height - 1,
+				   [&](size_t firstRow, size_t lastRow) {
+		forEachRow(firstRow, lastRow, [&](size_t y) {
+			detectRow(grayscaleImage.getRow(y - 1), grayscaleImage.getRow(y),
+					  grayscaleImage.getRow(y + 1), width, dst->getRow(y - 1));
+		});
+	});
+
+	return dst;
+}
+
+etchasketch::edgedetect::RowEdgeDetector *
+etchasketch::edgedetect::SobelEdgeDetector::newRowDetector(size_t width,
+														   size_t height) const
+{
+	return new SobelRowDetector(width, height);
 }
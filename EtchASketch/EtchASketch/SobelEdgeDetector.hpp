@@ -14,7 +14,13 @@
 namespace etchasketch {
 	namespace edgedetect {
 
-		/// Detect edges, à la Sobel.
+		/**
+		 * Detect edges, à la Sobel.
+		 *
+		 * The gradients are computed with the separable form of the Sobel
+		 * kernels in 16-bit integer arithmetic, a row at a time, using SSE2
+		 * or NEON where available.
+		 */
 		class SobelEdgeDetector : public etchasketch::edgedetect::EdgeDetector {
 		public:
 			/// Create a new Sobel edge detector.
@@ -23,17 +29,15 @@ namespace etchasketch {
 			virtual ~SobelEdgeDetector() { };
 
 			/**
-			 * Detect edges in an image, copying the result into a newly
-			 * allocated image.
+			 * Detect edges in an image, writing the result into a newly
+			 * allocated mask.
 			 */
-			virtual etchasketch::Image *
-			detectEdges(const etchasketch::Image &grayscaleImage) const;
-
-		private:
-			float intensityForPoint(const etchasketch::Image &img,
-									const int x,
-									const int y) const;
+			virtual etchasketch::EdgeMask *
+			detectEdges(const etchasketch::GrayImage &grayscaleImage) const;
 
+			/// Create a row detector for an image of the given size.
+			virtual etchasketch::edgedetect::RowEdgeDetector *
+			newRowDetector(size_t width, size_t height) const;
 		};
 
 	}
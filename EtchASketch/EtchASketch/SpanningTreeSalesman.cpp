@@ -0,0 +1,500 @@
+//
+//  SpanningTreeSalesman.cpp
+//  EtchASketch
+//
+
+#include "SpanningTreeSalesman.hpp"
+#include "EASUtils+Private.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using std::pair;
+using std::vector;
+using etchasketch::EdgePointBuffer;
+using etchasketch::KDPoint;
+using etchasketch::KDPointCoordinate;
+
+namespace {
+
+/// Marks a k-d tree node whose subtree spans more than one component.
+const uint32_t mixedComponents = std::numeric_limits<uint32_t>::max();
+
+/// Marks a point that hasn't found a neighbor outside its component.
+const uint32_t noNeighbor = std::numeric_limits<uint32_t>::max();
+
+/// How many components each thread is handed at a time.
+const size_t componentsPerChunk = 256;
+
+inline int64_t
+squaredDistance(const KDPoint<2> &a, const KDPoint<2> &b)
+{
+	const int64_t dx = a[0] - b[0], dy = a[1] - b[1];
+	return dx * dx + dy * dy;
+}
+
+/**
+ * A k-d tree of point indices, for finding the closest point in another
+ * component. Like @c KDTree, it's stored implicitly: the node for the range
+ * [first, last) is the median at @c first + (last - first) / 2, with the
+ * lower half before it and the upper half after. The points and their
+ * components are copied into that order, so a search reads memory in about
+ * the order it's laid out.
+ */
+class ComponentTree {
+  public:
+	explicit ComponentTree(const vector<KDPoint<2>> &points)
+		: order(points.size()), treePoints(points.size()),
+		  treeComponents(points.size()), nodeComponents(points.size())
+	{
+		// Sort the points together with their indices, rather than the
+		// indices alone, so the comparisons don't chase pointers.
+		vector<Entry> entries(points.size());
+		for (size_t i = 0; i < entries.size(); i++) {
+			entries[i] = std::make_pair(points[i], static_cast<uint32_t>(i));
+		}
+		build(entries, 0, entries.size(), 0);
+		for (size_t i = 0; i < entries.size(); i++) {
+			treePoints[i] = entries[i].first;
+			order[i] = entries[i].second;
+		}
+		nodeBounds.resize(order.size());
+		if (!order.empty()) {
+			bound(0, order.size());
+		}
+	}
+
+	/**
+	 * Note which component each point is in, so searches can skip subtrees
+	 * that are entirely in the searcher's component.
+	 */
+	void label(const vector<uint32_t> &components)
+	{
+		for (size_t i = 0; i < order.size(); i++) {
+			treeComponents[i] = components[order[i]];
+		}
+		if (!order.empty()) {
+			label(0, order.size());
+		}
+	}
+
+	/**
+	 * Find the closest point to @c query that isn't in @c component,
+	 * breaking ties by index. Only points closer than @c nearest, which is
+	 * @c nearestDistance squared away, are considered.
+	 */
+	void findNearestOutside(const KDPoint<2> &query, uint32_t component,
+							uint32_t &nearest, // inout
+							int64_t &nearestDistance) const // inout
+	{
+		find(query, component, 0, order.size(), 0, nearest, nearestDistance);
+	}
+
+  private:
+	/// The point indices, in tree order.
+	vector<uint32_t> order;
+
+	/// The points, in tree order.
+	vector<KDPoint<2>> treePoints;
+
+	/// The component of each point, in tree order.
+	vector<uint32_t> treeComponents;
+
+	/// The component everything under each node is in, or @c mixedComponents.
+	vector<uint32_t> nodeComponents;
+
+	/// The bounding box of everything under a node.
+	struct Bounds {
+		KDPointCoordinate minX, minY, maxX, maxY;
+	};
+
+	/// The bounding box of everything under each node.
+	vector<Bounds> nodeBounds;
+
+	/// A point and its index.
+	typedef pair<KDPoint<2>, uint32_t> Entry;
+
+	static void build(vector<Entry> &entries, size_t first, size_t last, int dimension)
+	{
+		if (last - first <= 1) {
+			return;
+		}
+		const size_t median = first + (last - first) / 2;
+		std::nth_element(entries.begin() + first, entries.begin() + median,
+						 entries.begin() + last, [dimension](const Entry &a, const Entry &b) {
+			return a.first[dimension] < b.first[dimension];
+		});
+		build(entries, first, median, 1 - dimension);
+		build(entries, median + 1, last, 1 - dimension);
+	}
+
+	/// Find the bounds of the subtree for [@c first, @c last), which must not be empty.
+	const Bounds & bound(size_t first, size_t last)
+	{
+		const size_t median = first + (last - first) / 2;
+		const KDPoint<2> &point = treePoints[median];
+		Bounds bounds = { point[0], point[1], point[0], point[1] };
+		for (const pair<size_t, size_t> &child : { std::make_pair(first, median),
+												   std::make_pair(median + 1, last) }) {
+			if (child.first < child.second) {
+				const Bounds &childBounds = bound(child.first, child.second);
+				bounds.minX = std::min(bounds.minX, childBounds.minX);
+				bounds.minY = std::min(bounds.minY, childBounds.minY);
+				bounds.maxX = std::max(bounds.maxX, childBounds.maxX);
+				bounds.maxY = std::max(bounds.maxY, childBounds.maxY);
+			}
+		}
+		nodeBounds[median] = bounds;
+		return nodeBounds[median];
+	}
+
+	/// Label the subtree for [@c first, @c last), which must not be empty.
+	uint32_t label(size_t first, size_t last)
+	{
+		const size_t median = first + (last - first) / 2;
+		const uint32_t component = treeComponents[median];
+		bool isUniform = true;
+		if (first < median) {
+			isUniform = (label(first, median) == component);
+		}
+		if (median + 1 < last) {
+			isUniform = (label(median + 1, last) == component) && isUniform;
+		}
+		nodeComponents[median] = isUniform ? component : mixedComponents;
+		return nodeComponents[median];
+	}
+
+	void find(const KDPoint<2> &query, uint32_t component,
+			  size_t first, size_t last, int dimension,
+			  uint32_t &nearest, // inout
+			  int64_t &nearestDistance) const // inout
+	{
+		if (first == last) {
+			return;
+		}
+		const size_t median = first + (last - first) / 2;
+		if (nodeComponents[median] == component) {
+			// Nothing under here is outside the component.
+			return;
+		}
+		// Ties count, since they might win on index.
+		const Bounds &bounds = nodeBounds[median];
+		const int64_t dx = std::max(std::max(bounds.minX - query[0], query[0] - bounds.maxX), 0);
+		const int64_t dy = std::max(std::max(bounds.minY - query[1], query[1] - bounds.maxY), 0);
+		if (dx * dx + dy * dy > nearestDistance) {
+			return;
+		}
+		const KDPoint<2> &candidate = treePoints[median];
+		if (treeComponents[median] != component) {
+			const int64_t distance = squaredDistance(query, candidate);
+			if ((distance < nearestDistance)
+				|| ((distance == nearestDistance) && (order[median] < nearest))) {
+				nearest = order[median];
+				nearestDistance = distance;
+			}
+		}
+		const int64_t split = query[dimension] - candidate[dimension];
+		const bool isLowerFirst = split < 0;
+		find(query, component,
+			 isLowerFirst ? first : median + 1, isLowerFirst ? median : last,
+			 1 - dimension, nearest, nearestDistance);
+		if (split * split <= nearestDistance) {
+			find(query, component,
+				 isLowerFirst ? median + 1 : first, isLowerFirst ? last : median,
+				 1 - dimension, nearest, nearestDistance);
+		}
+	}
+};
+
+/// Find the root of @c i's set, halving the path on the way.
+inline uint32_t
+findRoot(vector<uint32_t> &parents, uint32_t i)
+{
+	while (parents[i] != i) {
+		parents[i] = parents[parents[i]];
+		i = parents[i];
+	}
+	return i;
+}
+
+/**
+ * Call @c join(a, b) for each pair of points where @c b is @c dx to the
+ * right of and @c dy (0 or 1) below @c a. The points must be in row-major
+ * order, so it's a single pass, walking the next row alongside each row.
+ */
+template<typename Join>
+void
+forEachOffsetPair(const vector<KDPoint<2>> &points, int dx, int dy, Join join)
+{
+	size_t rowStart = 0;
+	while (rowStart < points.size()) {
+		const KDPointCoordinate y = points[rowStart][1];
+		size_t rowEnd = rowStart;
+		while ((rowEnd < points.size()) && (points[rowEnd][1] == y)) {
+			rowEnd++;
+		}
+		size_t other = (0 == dy) ? rowStart : rowEnd;
+		size_t otherEnd = other;
+		while ((otherEnd < points.size()) && (points[otherEnd][1] == y + dy)) {
+			otherEnd++;
+		}
+		for (size_t i = rowStart; i < rowEnd; i++) {
+			const KDPointCoordinate x = points[i][0] + dx;
+			while ((other < otherEnd) && (points[other][0] < x)) {
+				other++;
+			}
+			if ((other < otherEnd) && (points[other][0] == x)) {
+				join(static_cast<uint32_t>(i), static_cast<uint32_t>(other));
+			}
+		}
+		rowStart = rowEnd;
+	}
+}
+
+}
+
+namespace etchasketch {
+namespace salesman {
+
+SpanningTreeSalesman::SpanningTreeSalesman(const EdgePointBuffer &unorderedPoints,
+										   const KDPoint<2> &startPoint)
+	: Salesman(), startPoint(startPoint), unorderedPoints(unorderedPoints),
+	  threadPool(nullptr), treeLength(0.0)
+{
+}
+
+SpanningTreeSalesman::~SpanningTreeSalesman()
+{
+}
+
+void
+SpanningTreeSalesman::orderPoints()
+{
+	if (!unorderedPoints.contains(startPoint[0], startPoint[1])) {
+		EASLog("Error: unorderedPoints does not contain the starting point");
+		exit(1);
+	}
+	vector<KDPoint<2>> points;
+	points.reserve(unorderedPoints.size());
+	uint32_t root = 0;
+	for (size_t i = 0; i < unorderedPoints.size(); i++) {
+		points.push_back(unorderedPoints.getPoint(i));
+		if (points.back() == startPoint) {
+			root = static_cast<uint32_t>(i);
+		}
+	}
+
+	vector<pair<uint32_t, uint32_t>> edges;
+	buildTree(points, edges);
+	treeLength = 0.0;
+	for (const pair<uint32_t, uint32_t> &edge : edges) {
+		treeLength += std::sqrt(static_cast<double>(squaredDistance(points[edge.first],
+																	points[edge.second])));
+	}
+	walkTree(points, edges, root);
+}
+
+#pragma mark - Tree construction
+
+void
+SpanningTreeSalesman::buildTree(const vector<KDPoint<2>> &points,
+								vector<pair<uint32_t, uint32_t>> &edges) // out
+{
+	const size_t pointCount = points.size();
+	edges.clear();
+	edges.reserve(pointCount);
+	ComponentTree tree(points);
+	vector<uint32_t> parents(pointCount);
+	for (size_t i = 0; i < pointCount; i++) {
+		parents[i] = static_cast<uint32_t>(i);
+	}
+	vector<uint32_t> components(pointCount);
+	// The points of each component, one component after another.
+	vector<uint32_t> members(pointCount);
+	vector<uint32_t> memberStarts;
+	// Start the way Kruskal's algorithm would, by joining every pair of
+	// touching pixels: first side by side, then corner to corner. Finding them
+	// is a single pass over the points, since they're in row-major order, and
+	// it saves the first few rounds of searching.
+	auto join = [&](uint32_t a, uint32_t b) {
+		const uint32_t aRoot = findRoot(parents, a);
+		const uint32_t bRoot = findRoot(parents, b);
+		if (aRoot != bRoot) {
+			parents[aRoot] = bRoot;
+			edges.push_back(std::make_pair(a, b));
+		}
+	};
+	forEachOffsetPair(points, 1, 0, join);
+	forEachOffsetPair(points, 0, 1, join);
+	forEachOffsetPair(points, 1, 1, join);
+	forEachOffsetPair(points, -1, 1, join);
+	// Each point's closest point outside its component, as of when it last
+	// looked. That stays the closest until it joins the component, since the
+	// component only grows. Until then, the distance to it is still a lower
+	// bound on the distance to the closest one. Now that every touching pair
+	// is joined, nothing outside is closer than 2 pixels.
+	vector<uint32_t> neighbors(pointCount, noNeighbor);
+	vector<int64_t> neighborDistances(pointCount, 4);
+	// The shortest edge out of each component, in @c memberStarts order.
+	vector<pair<uint32_t, uint32_t>> shortestEdges;
+
+	while (edges.size() + 1 < pointCount) {
+		// Group the points by component.
+		std::fill(memberStarts.begin(), memberStarts.end(), 0);
+		memberStarts.resize(pointCount + 1, 0);
+		for (size_t i = 0; i < pointCount; i++) {
+			components[i] = findRoot(parents, static_cast<uint32_t>(i));
+			memberStarts[components[i] + 1]++;
+		}
+		for (size_t i = 0; i < pointCount; i++) {
+			memberStarts[i + 1] += memberStarts[i];
+		}
+		vector<uint32_t> fill(memberStarts.begin(), memberStarts.end() - 1);
+		for (size_t i = 0; i < pointCount; i++) {
+			members[fill[components[i]]++] = static_cast<uint32_t>(i);
+		}
+		memberStarts.erase(std::unique(memberStarts.begin(), memberStarts.end()),
+						   memberStarts.end());
+		tree.label(components);
+
+		// Each component's search only writes to its own points, so the
+		// components can be searched in parallel.
+		const size_t componentCount = memberStarts.size() - 1;
+		shortestEdges.assign(componentCount, std::make_pair(noNeighbor, noNeighbor));
+		auto searchComponent = [&](size_t index) {
+			const uint32_t *first = &members[memberStarts[index]];
+			const uint32_t *last = &members[memberStarts[index + 1] - 1] + 1;
+			const uint32_t component = components[*first];
+			uint32_t bestFrom = noNeighbor, bestTo = noNeighbor;
+			int64_t bestDistance = std::numeric_limits<int64_t>::max();
+			// Start with the neighbors that are still good, so the searches
+			// have something to beat.
+			for (const uint32_t *point = first; point != last; ++point) {
+				const uint32_t neighbor = neighbors[*point];
+				if ((noNeighbor != neighbor) && (components[neighbor] != component)
+					&& (neighborDistances[*point] < bestDistance)) {
+					bestFrom = *point;
+					bestTo = neighbor;
+					bestDistance = neighborDistances[*point];
+				}
+			}
+			for (const uint32_t *point = first; point != last; ++point) {
+				const uint32_t neighbor = neighbors[*point];
+				if (((noNeighbor != neighbor) && (components[neighbor] != component))
+					|| (neighborDistances[*point] >= bestDistance)) {
+					// Either it's known, or it can't be the shortest.
+					continue;
+				}
+				uint32_t nearest = noNeighbor;
+				int64_t nearestDistance = bestDistance;
+				tree.findNearestOutside(points[*point], component, nearest, nearestDistance);
+				neighbors[*point] = nearest;
+				neighborDistances[*point] = nearestDistance;
+				if ((noNeighbor != nearest) && (nearestDistance < bestDistance)) {
+					bestFrom = *point;
+					bestTo = nearest;
+					bestDistance = nearestDistance;
+				}
+			}
+			shortestEdges[index] = std::make_pair(bestFrom, bestTo);
+		};
+		const size_t chunkCount = (componentCount + componentsPerChunk - 1) / componentsPerChunk;
+		auto searchChunk = [&](size_t chunk) {
+			const size_t end = std::min((chunk + 1) * componentsPerChunk, componentCount);
+			for (size_t index = chunk * componentsPerChunk; index < end; index++) {
+				searchComponent(index);
+			}
+		};
+		if (threadPool) {
+			threadPool->parallelFor(chunkCount, searchChunk);
+		} else {
+			for (size_t chunk = 0; chunk < chunkCount; chunk++) {
+				searchChunk(chunk);
+			}
+		}
+
+		// Join them up. Edges that would close a loop can only be there
+		// because of a tie, so any of the loop's edges can go.
+		for (const pair<uint32_t, uint32_t> &edge : shortestEdges) {
+			const uint32_t fromRoot = findRoot(parents, edge.first);
+			const uint32_t toRoot = findRoot(parents, edge.second);
+			if (fromRoot != toRoot) {
+				parents[fromRoot] = toRoot;
+				edges.push_back(edge);
+			}
+		}
+	}
+}
+
+#pragma mark - Walk
+
+void
+SpanningTreeSalesman::walkTree(const vector<KDPoint<2>> &points,
+							   const vector<pair<uint32_t, uint32_t>> &edges,
+							   uint32_t root)
+{
+	const size_t pointCount = points.size();
+	// Adjacency lists: point i's neighbors are
+	// [adjacencyStarts[i], adjacencyStarts[i + 1]) of adjacent.
+	vector<uint32_t> adjacencyStarts(pointCount + 1, 0);
+	for (const pair<uint32_t, uint32_t> &edge : edges) {
+		adjacencyStarts[edge.first + 1]++;
+		adjacencyStarts[edge.second + 1]++;
+	}
+	for (size_t i = 0; i < pointCount; i++) {
+		adjacencyStarts[i + 1] += adjacencyStarts[i];
+	}
+	vector<uint32_t> adjacent(adjacencyStarts.back());
+	vector<uint32_t> fill(adjacencyStarts.begin(), adjacencyStarts.end() - 1);
+	for (const pair<uint32_t, uint32_t> &edge : edges) {
+		adjacent[fill[edge.first]++] = edge.second;
+		adjacent[fill[edge.second]++] = edge.first;
+	}
+
+	// Hang the tree from the root, and find how big each subtree is.
+	vector<uint32_t> parents(pointCount, noNeighbor);
+	vector<uint32_t> subtreeSizes(pointCount, 1);
+	vector<uint32_t> preorder;
+	preorder.reserve(pointCount);
+	vector<uint32_t> stack(1, root);
+	parents[root] = root;
+	while (!stack.empty()) {
+		const uint32_t point = stack.back();
+		stack.pop_back();
+		preorder.push_back(point);
+		for (uint32_t i = adjacencyStarts[point]; i < adjacencyStarts[point + 1]; i++) {
+			if (noNeighbor == parents[adjacent[i]]) {
+				parents[adjacent[i]] = point;
+				stack.push_back(adjacent[i]);
+			}
+		}
+	}
+	for (auto it = preorder.rbegin(); it != preorder.rend(); ++it) {
+		if (*it != root) {
+			subtreeSizes[parents[*it]] += subtreeSizes[*it];
+		}
+	}
+
+	// Walk it again, taking the smaller subtrees first.
+	orderedPoints.clear();
+	orderedPoints.reserve(pointCount);
+	stack.assign(1, root);
+	while (!stack.empty()) {
+		const uint32_t point = stack.back();
+		stack.pop_back();
+		orderedPoints.push_back(points[point]);
+		const size_t childrenStart = stack.size();
+		for (uint32_t i = adjacencyStarts[point]; i < adjacencyStarts[point + 1]; i++) {
+			if (adjacent[i] != parents[point]) {
+				stack.push_back(adjacent[i]);
+			}
+		}
+		// The stack pops the last one first, so put the biggest first.
+		std::sort(stack.begin() + childrenStart, stack.end(), [&](uint32_t a, uint32_t b) {
+			return subtreeSizes[a] > subtreeSizes[b];
+		});
+	}
+}
+
+}
+}
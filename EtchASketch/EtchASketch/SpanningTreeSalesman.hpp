@@ -0,0 +1,95 @@
+//
+//  SpanningTreeSalesman.hpp
+//  EtchASketch
+//
+
+#ifndef SpanningTreeSalesman_hpp
+#define SpanningTreeSalesman_hpp
+
+#include <stddef.h>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+#include "Salesman.hpp"
+#include "EdgePointBuffer.hpp"
+#include "KDPoint.hpp"
+#include "ThreadPool.hpp"
+
+namespace etchasketch {
+namespace salesman {
+
+/**
+ * Draws the points in a depth-first walk of their Euclidean minimum spanning
+ * tree.
+ *
+ * The tree is built with Borůvka's algorithm. Each round, every component
+ * finds its shortest edge to a point outside it, and all of those edges join
+ * the tree at once, so there are at most log2(n) rounds. The searches go
+ * through a k-d tree whose nodes know when everything under them is in one
+ * component, so a search skips its own component wholesale. The searches in
+ * a round don't depend on each other, so they run on the thread pool, and a
+ * point only searches again once the neighbor it found joins its component.
+ *
+ * The walk visits the tree in preorder from the start point. Finishing a
+ * branch means jumping straight to the next one rather than retracing the
+ * way back, and smaller branches go first, so the jumps are short and the
+ * biggest branch needs none. By the triangle inequality, the path is at most
+ * twice as long as the tree, which is no longer than the shortest possible
+ * path, so the drawing is never more than twice as long as it needs to be.
+ */
+class SpanningTreeSalesman : public Salesman {
+  public:
+	/**
+	 * The startPoint must be contained within the unorderedPoints, which
+	 * must outlive the salesman.
+	 */
+	SpanningTreeSalesman(const EdgePointBuffer &unorderedPoints,
+						 const KDPoint<2> &startPoint);
+
+	virtual ~SpanningTreeSalesman();
+
+	/// Order the points for the best drawing order.
+	virtual void orderPoints();
+
+	/**
+	 * Build the tree on the threads of @c pool, or on the calling thread if
+	 * it's @c nullptr. The pool isn't owned, and must outlive its use here.
+	 */
+	inline void setThreadPool(etchasketch::ThreadPool *pool)
+		{ threadPool = pool; }
+
+	/// The total length of the tree's edges, once the points are ordered.
+	inline double getTreeLength() const
+		{ return treeLength; }
+
+  private:
+	/// The point at which we begin drawing.
+	const KDPoint<2> startPoint;
+
+	/// The points to put in order.
+	const EdgePointBuffer &unorderedPoints;
+
+	etchasketch::ThreadPool *threadPool;
+
+	double treeLength;
+
+	/**
+	 * Find the minimum spanning tree of @c points, which must be in
+	 * row-major order, as pairs of indices into @c points.
+	 */
+	void buildTree(const std::vector<etchasketch::KDPoint<2>> &points,
+				   std::vector<std::pair<uint32_t, uint32_t>> &edges); // out
+
+	/**
+	 * Fill @c orderedPoints with a preorder walk of the tree, starting from
+	 * @c points[@c root].
+	 */
+	void walkTree(const std::vector<etchasketch::KDPoint<2>> &points,
+				  const std::vector<std::pair<uint32_t, uint32_t>> &edges,
+				  uint32_t root);
+};
+
+}
+}
+
+#endif /* SpanningTreeSalesman_hpp */
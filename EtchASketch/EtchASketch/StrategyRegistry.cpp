@@ -0,0 +1,153 @@
+//
+//  StrategyRegistry.cpp
+//  EtchASketch
+//
+
+#include "StrategyRegistry.hpp"
+#include "BitmapSalesman.hpp"
+#include "BobAndWeaveSalesman.hpp"
+#include "ChainSalesman.hpp"
+#include "EdgeDetector.hpp"
+#include "HilbertSalesman.hpp"
+#include "NearestNeighborSalesman.hpp"
+#include "Salesman.hpp"
+#include "SobelEdgeDetector.hpp"
+#include "SpanningTreeSalesman.hpp"
+#include <stdlib.h>
+
+using std::string;
+using etchasketch::StrategyParameters;
+using etchasketch::StrategyRegistry;
+using etchasketch::edgedetect::EdgeDetectorFactory;
+using etchasketch::edgedetect::SobelEdgeDetector;
+using etchasketch::salesman::BitmapSalesman;
+using etchasketch::salesman::BobAndWeaveSalesman;
+using etchasketch::salesman::ChainSalesman;
+using etchasketch::salesman::HilbertSalesman;
+using etchasketch::salesman::NearestNeighborSalesman;
+using etchasketch::salesman::NeighborIndex;
+using etchasketch::salesman::SalesmanFactory;
+using etchasketch::salesman::SalesmanInputs;
+using etchasketch::salesman::SpanningTreeSalesman;
+
+namespace {
+
+/// More points per tile than any image has, but still safe to convert to a
+/// @c size_t.
+const double maxPointsPerTile = 1e9;
+
+etchasketch::salesman::Salesman *
+newNearestNeighborSalesman(const SalesmanInputs &inputs, const StrategyParameters &parameters)
+{
+	const NeighborIndex index = (0.0 != parameters.at("kdTree"))
+								? NeighborIndex::KDTree : NeighborIndex::Grid;
+	NearestNeighborSalesman *salesman = new NearestNeighborSalesman(*inputs.edgePoints,
+																	 inputs.startPoint, index);
+	salesman->setThreadPool(inputs.threadPool);
+	salesman->setPointsPerTile(static_cast<size_t>(parameters.at("pointsPerTile")));
+	return salesman;
+}
+
+}
+
+bool
+etchasketch::parseStrategySpec(const string &spec,
+							   string &name, // out
+							   StrategyParameters &parameters) // out
+{
+	parameters.clear();
+	const size_t colon = spec.find(':');
+	name = spec.substr(0, colon);
+	if (string::npos == colon) {
+		return true;
+	}
+	size_t start = colon + 1;
+	while (start <= spec.size()) {
+		size_t end = spec.find(',', start);
+		if (string::npos == end) {
+			end = spec.size();
+		}
+		const string setting = spec.substr(start, end - start);
+		const size_t equals = setting.find('=');
+		if ((string::npos == equals) || (0 == equals) || (setting.size() - 1 == equals)) {
+			return false;
+		}
+		const string value = setting.substr(equals + 1);
+		char *valueEnd = nullptr;
+		parameters[setting.substr(0, equals)] = strtod(value.c_str(), &valueEnd);
+		if (*valueEnd != '\0') {
+			return false;
+		}
+		start = end + 1;
+	}
+	return true;
+}
+
+StrategyRegistry<EdgeDetectorFactory> &
+etchasketch::edgedetect::edgeDetectors()
+{
+	static StrategyRegistry<EdgeDetectorFactory> registry = [] {
+		StrategyRegistry<EdgeDetectorFactory> builtIns;
+		builtIns.add({ "sobel", "Sobel gradients with fixed thresholds", {},
+			[](const StrategyParameters &) {
+				return new SobelEdgeDetector();
+			}
+		});
+		return builtIns;
+	}();
+	return registry;
+}
+
+StrategyRegistry<SalesmanFactory> &
+etchasketch::salesman::salesmen()
+{
+	static StrategyRegistry<SalesmanFactory> registry = [] {
+		StrategyRegistry<SalesmanFactory> builtIns;
+		builtIns.add({ "nearest-neighbor", "Always go to the closest undrawn point", {
+				{ "pointsPerTile", 0, 0, maxPointsPerTile,
+				  "Order tiles of about this many points in parallel, or 0 for one walk" },
+				{ "kdTree", 0, 0, 1, "1 to look up neighbors in a k-d tree instead of a grid" },
+			}, { newNearestNeighborSalesman, false }
+		});
+		builtIns.add({ "tiled-nearest-neighbor",
+			"nearest-neighbor in parallel tiles; a few percent longer", {
+				{ "pointsPerTile",
+				  static_cast<double>(NearestNeighborSalesman::suggestedPointsPerTile),
+				  1, maxPointsPerTile, "About how many points to put in each tile" },
+				{ "kdTree", 0, 0, 1, "1 to look up neighbors in a k-d tree instead of a grid" },
+			}, { newNearestNeighborSalesman, false }
+		});
+		builtIns.add({ "bitmap", "The nearest-neighbor tour, found on a bitmap", {},
+			{ [](const SalesmanInputs &inputs, const StrategyParameters &) {
+				return new BitmapSalesman(*inputs.edgePoints, inputs.startPoint);
+			}, false }
+		});
+		builtIns.add({ "chain", "Trace each edge whole, then jump to the closest", {},
+			{ [](const SalesmanInputs &inputs, const StrategyParameters &) {
+				return new ChainSalesman(*inputs.edgePoints, inputs.startPoint);
+			}, false }
+		});
+		builtIns.add({ "spanning-tree", "Walk the minimum spanning tree", {},
+			{ [](const SalesmanInputs &inputs, const StrategyParameters &) {
+				SpanningTreeSalesman *salesman = new SpanningTreeSalesman(*inputs.edgePoints,
+																		  inputs.startPoint);
+				salesman->setThreadPool(inputs.threadPool);
+				return salesman;
+			}, false }
+		});
+		builtIns.add({ "hilbert", "Follow a Hilbert curve; fastest, but the longest path", {},
+			{ [](const SalesmanInputs &inputs, const StrategyParameters &) {
+				return new HilbertSalesman(*inputs.edgePoints, inputs.startPoint);
+			}, false }
+		});
+		builtIns.add({ "bob-and-weave", "Sweep the grayscale image in wavy lines", {},
+			{ [](const SalesmanInputs &inputs, const StrategyParameters &) {
+				BobAndWeaveSalesman *salesman = new BobAndWeaveSalesman(*inputs.grayscaleImage);
+				salesman->setThreadPool(inputs.threadPool);
+				return salesman;
+			}, true }
+		});
+		return builtIns;
+	}();
+	return registry;
+}
@@ -0,0 +1,135 @@
+//
+//  StrategyRegistry.hpp
+//  EtchASketch
+//
+
+#ifndef StrategyRegistry_hpp
+#define StrategyRegistry_hpp
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace etchasketch {
+
+/// Settings for a strategy, by name, like "pointsPerTile" = 16384.
+typedef std::map<std::string, double> StrategyParameters;
+
+/// A setting a strategy takes.
+struct StrategyParameter {
+	std::string name;
+
+	/// The value when it isn't given.
+	double defaultValue;
+
+	/// The smallest value it takes.
+	double minValue;
+
+	/// The largest value it takes.
+	double maxValue;
+
+	std::string description;
+};
+
+/**
+ * Split a strategy spec like "nearest-neighbor:pointsPerTile=16384,kdTree=1"
+ * into its name and parameters. The parameters are optional.
+ *
+ * @return @c false if a parameter isn't "key=number".
+ */
+bool parseStrategySpec(const std::string &spec,
+					   std::string &name, // out
+					   StrategyParameters &parameters); // out
+
+/**
+ * The strategies for one stage of the flow, like edge detection, by name, so
+ * they can be chosen at run time.
+ *
+ * Registering isn't thread-safe, so add any strategies of your own before
+ * starting a flow that might use them.
+ *
+ * @param Factory What makes an instance of a strategy. Each stage decides
+ *  what its factories take.
+ */
+template<typename Factory>
+class StrategyRegistry {
+public:
+	struct Entry {
+		/// What it's chosen by.
+		std::string name;
+
+		/// One line for usage messages.
+		std::string description;
+
+		/// Everything it takes. Others are refused.
+		std::vector<StrategyParameter> parameters;
+
+		Factory factory;
+	};
+
+	/// Add a strategy, replacing any already registered by that name.
+	void add(const Entry &entry)
+	{
+		for (Entry &existing : entries) {
+			if (existing.name == entry.name) {
+				existing = entry;
+				return;
+			}
+		}
+		entries.push_back(entry);
+	}
+
+	/// The strategy called @c name, or @c nullptr if there isn't one.
+	const Entry * find(const std::string &name) const
+	{
+		for (const Entry &entry : entries) {
+			if (entry.name == name) {
+				return &entry;
+			}
+		}
+		return nullptr;
+	}
+
+	/// Every strategy, in the order they were added.
+	inline const std::vector<Entry> & getEntries() const
+		{ return entries; }
+
+	/**
+	 * Fill in the defaults for any of @c entry's parameters @c given leaves
+	 * out.
+	 *
+	 * @return @c false if @c given has a parameter @c entry doesn't take, or
+	 *  a value outside a parameter's range.
+	 */
+	static bool resolveParameters(const Entry &entry,
+								  const StrategyParameters &given,
+								  StrategyParameters &resolved) // out
+	{
+		resolved.clear();
+		for (const StrategyParameter &parameter : entry.parameters) {
+			resolved[parameter.name] = parameter.defaultValue;
+		}
+		for (const auto &setting : given) {
+			const StrategyParameter *parameter = nullptr;
+			for (const StrategyParameter &candidate : entry.parameters) {
+				if (candidate.name == setting.first) {
+					parameter = &candidate;
+				}
+			}
+			// Written so that NaN is out of range too.
+			if (!parameter || !((setting.second >= parameter->minValue) &&
+								(setting.second <= parameter->maxValue))) {
+				return false;
+			}
+			resolved[setting.first] = setting.second;
+		}
+		return true;
+	}
+
+private:
+	std::vector<Entry> entries;
+};
+
+}
+
+#endif /* StrategyRegistry_hpp */
@@ -0,0 +1,104 @@
+//
+//  ThreadPool.cpp
+//  EtchASketch
+//
+
+#include "ThreadPool.hpp"
+
+using std::function;
+using std::mutex;
+using std::thread;
+using std::unique_lock;
+
+etchasketch::ThreadPool::ThreadPool(size_t threadCount)
+: job(nullptr), jobChunkCount(0), nextChunk(0), busyWorkers(0),
+  jobGeneration(0), isStopping(false)
+{
+	if (0 == threadCount) {
+		threadCount = thread::hardware_concurrency();
+	}
+	// The calling thread makes up the last one.
+	for (size_t i = 1; i < threadCount; i++) {
+		workers.push_back(thread(&ThreadPool::workerLoop, this));
+	}
+}
+
+etchasketch::ThreadPool::~ThreadPool()
+{
+	{
+		unique_lock<mutex> lock(stateMutex);
+		isStopping = true;
+	}
+	workAvailable.notify_all();
+	for (thread &worker : workers) {
+		worker.join();
+	}
+}
+
+void
+etchasketch::ThreadPool::parallelFor(size_t chunkCount,
+									 const function<void(size_t)> &chunkFunction)
+{
+	if (workers.empty() || chunkCount <= 1) {
+		// Not worth waking anyone up.
+		for (size_t i = 0; i < chunkCount; i++) {
+			chunkFunction(i);
+		}
+		return;
+	}
+
+	unique_lock<mutex> callLock(callMutex);
+	{
+		unique_lock<mutex> lock(stateMutex);
+		job = &chunkFunction;
+		jobChunkCount = chunkCount;
+		nextChunk = 0;
+		busyWorkers = workers.size();
+		jobGeneration++;
+	}
+	workAvailable.notify_all();
+
+	runChunks(chunkFunction, chunkCount);
+
+	unique_lock<mutex> lock(stateMutex);
+	workFinished.wait(lock, [this] { return 0 == busyWorkers; });
+	job = nullptr;
+}
+
+void
+etchasketch::ThreadPool::workerLoop()
+{
+	uint64_t lastGeneration = 0;
+	while (true) {
+		const function<void(size_t)> *currentJob = nullptr;
+		size_t chunkCount = 0;
+		{
+			unique_lock<mutex> lock(stateMutex);
+			workAvailable.wait(lock, [&] {
+				return isStopping || (jobGeneration != lastGeneration);
+			});
+			if (isStopping) {
+				return;
+			}
+			lastGeneration = jobGeneration;
+			currentJob = job;
+			chunkCount = jobChunkCount;
+		}
+
+		runChunks(*currentJob, chunkCount);
+
+		unique_lock<mutex> lock(stateMutex);
+		if (0 == --busyWorkers) {
+			workFinished.notify_one();
+		}
+	}
+}
+
+void
+etchasketch::ThreadPool::runChunks(const function<void(size_t)> &chunkFunction,
+								   size_t chunkCount)
+{
+	for (size_t i = nextChunk++; i < chunkCount; i = nextChunk++) {
+		chunkFunction(i);
+	}
+}
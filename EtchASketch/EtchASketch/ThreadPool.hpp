@@ -0,0 +1,95 @@
+//
+//  ThreadPool.hpp
+//  EtchASketch
+//
+
+#ifndef ThreadPool_hpp
+#define ThreadPool_hpp
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace etchasketch {
+
+/**
+ * A fixed set of worker threads for data-parallel loops.
+ *
+ * The thread that calls @c parallelFor() does its share of the work, so a
+ * pool of N threads starts N - 1 workers, and a pool of 1 thread runs
+ * everything inline. Only one @c parallelFor() runs at a time; concurrent
+ * calls wait their turn.
+ */
+class ThreadPool {
+public:
+	/**
+	 * Create a new pool.
+	 *
+	 * @param threadCount The number of threads to run loops on, including
+	 * the calling thread. Pass 0 to use one per hardware thread.
+	 */
+	explicit ThreadPool(size_t threadCount = 0);
+
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool &) = delete;
+
+	ThreadPool & operator=(const ThreadPool &) = delete;
+
+	/// The number of threads loops run on, including the calling thread.
+	inline size_t getThreadCount() const
+		{ return workers.size() + 1; }
+
+	/**
+	 * Call @c chunkFunction(i) for each i in [0, @c chunkCount), spread
+	 * across the pool, and wait for them all to finish. Chunks run in no
+	 * particular order, so each must only write to memory no other chunk
+	 * touches. @c chunkFunction must not throw.
+	 */
+	void parallelFor(size_t chunkCount,
+					 const std::function<void(size_t)> &chunkFunction);
+
+private:
+	std::vector<std::thread> workers;
+
+	/// Serializes calls to @c parallelFor().
+	std::mutex callMutex;
+
+	/// Guards everything below.
+	std::mutex stateMutex;
+
+	std::condition_variable workAvailable;
+
+	std::condition_variable workFinished;
+
+	/// The loop being run, or @c nullptr between loops.
+	const std::function<void(size_t)> *job;
+
+	size_t jobChunkCount;
+
+	/// The next chunk to hand out.
+	std::atomic<size_t> nextChunk;
+
+	/// The number of workers still busy with the current job.
+	size_t busyWorkers;
+
+	/// Bumped each time a new job is posted, so workers can tell it's new.
+	uint64_t jobGeneration;
+
+	bool isStopping;
+
+	void workerLoop();
+
+	/// Claim and run chunks of the current job until there are none left.
+	void runChunks(const std::function<void(size_t)> &chunkFunction,
+				   size_t chunkCount);
+};
+
+}
+
+#endif /* ThreadPool_hpp */
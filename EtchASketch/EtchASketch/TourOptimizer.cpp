@@ -0,0 +1,565 @@
+//
+//  TourOptimizer.cpp
+//  EtchASketch
+//
+
+#include "TourOptimizer.hpp"
+#include "EASUtils+Private.hpp"
+#include "KDTree.hpp"
+#include "PointLookup.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <limits>
+#include <stdint.h>
+
+using std::vector;
+using etchasketch::KDPoint;
+using etchasketch::KDTree;
+using etchasketch::PointLookup;
+using etchasketch::salesman::TourOptimizer;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+/// Marks a point with fewer neighbors than the lists have room for.
+const uint32_t noNeighbor = std::numeric_limits<uint32_t>::max();
+
+/// Moves that save less than this are rounding noise, and could cycle.
+const float minimumGain = 1e-3f;
+
+/// Stretches shorter than this aren't worth a thread.
+const size_t minimumStretchLength = 1000;
+
+/**
+ * The most stretches a round cuts the path into. It doesn't depend on the
+ * pool, so the path comes out the same with or without one, and 16 keeps
+ * a few apiece for up to four threads.
+ */
+const size_t maximumStretchCount = 16;
+
+/// How many points' neighbors to find between looks at the clock.
+const size_t neighborChunkLength = 4096;
+
+/**
+ * The most of the time budget that finding neighbors may take, so there's
+ * always time left to search with them.
+ */
+const double maximumSetupShare = 0.5;
+
+/**
+ * The path being improved. Points are referred to by their index in the
+ * original path, and places in the path by position.
+ */
+struct Tour {
+	vector<float> xs;
+
+	vector<float> ys;
+
+	/// The point at each position.
+	vector<uint32_t> order;
+
+	/// The position of each point.
+	vector<uint32_t> positions;
+
+	/// Each point's closest neighbors, closest first, @c neighborCount apiece.
+	vector<uint32_t> neighbors;
+
+	size_t neighborCount;
+
+	/// The stretch each point is in this round.
+	vector<uint32_t> stretches;
+
+	/// Whether each point is waiting to be looked at.
+	vector<uint8_t> isQueued;
+
+	inline float distance(uint32_t a, uint32_t b) const
+	{
+		const float dx = xs[a] - xs[b], dy = ys[a] - ys[b];
+		return std::sqrt(dx * dx + dy * dy);
+	}
+
+	/// The length of the edge from position @c i to position @c i + 1.
+	inline float edgeAfter(size_t i) const
+		{ return distance(order[i], order[i + 1]); }
+};
+
+/**
+ * Improves the stretch of the path from position @c first to position
+ * @c last, inclusive. Both ends stay put, unless @c last is the end of the
+ * whole path, which is free to change.
+ *
+ * Stretches of the same round only share their ends, which never move, so
+ * each can be searched on its own thread.
+ */
+class StretchSearch {
+  public:
+	StretchSearch(Tour &tour, uint32_t stretch, size_t first, size_t last,
+				  Clock::time_point deadline)
+		: tour(tour), stretch(stretch), first(first), last(last),
+		  lastMovable((last + 1 == tour.order.size()) ? last : last - 1),
+		  deadline(deadline)
+	{
+	}
+
+	/// Make moves until none help or time runs out, and return the total savings.
+	double run()
+	{
+		for (size_t i = first + 1; i <= lastMovable; i++) {
+			enqueue(tour.order[i]);
+		}
+		double totalGain = 0.0;
+		size_t movesSinceClockCheck = 0;
+		while (!queue.empty()) {
+			if (++movesSinceClockCheck == 256) {
+				movesSinceClockCheck = 0;
+				if (Clock::now() >= deadline) {
+					break;
+				}
+			}
+			const uint32_t point = queue.front();
+			queue.pop_front();
+			tour.isQueued[point] = 0;
+			float gain = tryTwoOpt(point);
+			if (0.0f == gain) {
+				gain = tryOrOpt(point);
+			}
+			if (gain > 0.0f) {
+				totalGain += gain;
+				enqueue(point);
+			}
+		}
+		// Leave the flags clear for the next round.
+		for (uint32_t point : queue) {
+			tour.isQueued[point] = 0;
+		}
+		return totalGain;
+	}
+
+  private:
+	Tour &tour;
+
+	const uint32_t stretch;
+
+	const size_t first;
+
+	const size_t last;
+
+	/// The last position a move may change.
+	const size_t lastMovable;
+
+	const Clock::time_point deadline;
+
+	/// The points to look at, with don't-look bits in @c tour.isQueued.
+	std::deque<uint32_t> queue;
+
+	/// Look at @c point again, if it's one this stretch may move.
+	inline void enqueue(uint32_t point)
+	{
+		const size_t position = tour.positions[point];
+		if ((position > first) && (position <= lastMovable) && !tour.isQueued[point]) {
+			tour.isQueued[point] = 1;
+			queue.push_back(point);
+		}
+	}
+
+	/// Whether @c point is in this stretch, ends included.
+	inline bool contains(uint32_t point) const
+	{
+		// The ends are shared with the neighboring stretches, but never move.
+		return (tour.stretches[point] == stretch) || (point == tour.order[first])
+			|| (point == tour.order[last]);
+	}
+
+	/// Whether there's an edge after position @c i.
+	inline bool hasEdgeAfter(size_t i) const
+		{ return i + 1 < tour.order.size(); }
+
+	/// Reverse the points from position @c i to @c j, inclusive.
+	void reverse(size_t i, size_t j)
+	{
+		std::reverse(tour.order.begin() + i, tour.order.begin() + j + 1);
+		updatePositions(i, j);
+	}
+
+	void updatePositions(size_t i, size_t j)
+	{
+		for (size_t k = i; k <= j; k++) {
+			tour.positions[tour.order[k]] = static_cast<uint32_t>(k);
+		}
+	}
+
+	/**
+	 * Try each 2-opt move that makes an edge from @c a to one of its
+	 * neighbors, and make the best one.
+	 *
+	 * @return How much shorter the path got, or 0 if nothing helped.
+	 */
+	float tryTwoOpt(uint32_t a)
+	{
+		const size_t p = tour.positions[a];
+		// A new edge only helps if it's shorter than the one it replaces.
+		float longestEdge = tour.distance(a, tour.order[p - 1]);
+		if (hasEdgeAfter(p)) {
+			longestEdge = std::max(longestEdge, tour.edgeAfter(p));
+		}
+		float bestGain = minimumGain;
+		size_t bestFirst = 0, bestLast = 0;
+		const uint32_t *neighbors = &tour.neighbors[a * tour.neighborCount];
+		for (size_t k = 0; k < tour.neighborCount; k++) {
+			const uint32_t c = neighbors[k];
+			if (noNeighbor == c) {
+				break;
+			}
+			const float newEdge = tour.distance(a, c);
+			if (newEdge >= longestEdge) {
+				break;
+			}
+			if (!contains(c)) {
+				continue;
+			}
+			const size_t q = tour.positions[c];
+			const size_t i = std::min(p, q), j = std::max(p, q);
+			if (j - i > TourOptimizer::maximumMoveLength) {
+				continue;
+			}
+			// Reverse (i, j] to link i to j, and i + 1 to whatever followed j.
+			if ((i + 1 < j) && (j <= lastMovable)) {
+				float gain = tour.edgeAfter(i) - newEdge;
+				if (hasEdgeAfter(j)) {
+					gain += tour.edgeAfter(j) - tour.distance(tour.order[i + 1], tour.order[j + 1]);
+				}
+				if (gain > bestGain) {
+					bestGain = gain;
+					bestFirst = i + 1;
+					bestLast = j;
+				}
+			}
+			// Or reverse [i, j) to link i to j, and whatever preceded i to j - 1.
+			if ((i > first) && (i + 1 < j)) {
+				const float gain = tour.edgeAfter(i - 1) + tour.edgeAfter(j - 1) - newEdge
+								   - tour.distance(tour.order[i - 1], tour.order[j - 1]);
+				if (gain > bestGain) {
+					bestGain = gain;
+					bestFirst = i;
+					bestLast = j - 1;
+				}
+			}
+		}
+		if (0 == bestLast) {
+			return 0.0f;
+		}
+		reverse(bestFirst, bestLast);
+		// Only the points on the changed edges have anything new to try.
+		enqueue(tour.order[bestFirst - 1]);
+		enqueue(tour.order[bestFirst]);
+		enqueue(tour.order[bestLast]);
+		if (hasEdgeAfter(bestLast)) {
+			enqueue(tour.order[bestLast + 1]);
+		}
+		return bestGain;
+	}
+
+	/**
+	 * Try moving each run of 1 to 3 points that @c a is at either end of to
+	 * between one of @c a's neighbors and the point before or after it, and
+	 * make the best move.
+	 *
+	 * @return How much shorter the path got, or 0 if nothing helped.
+	 */
+	float tryOrOpt(uint32_t a)
+	{
+		const size_t p = tour.positions[a];
+		float bestGain = minimumGain;
+		size_t bestRunFirst = 0, bestRunLast = 0, bestGap = 0;
+		bool bestIsReversed = false;
+		for (size_t runLength = 1; runLength <= 3; runLength++) {
+			for (int aIsFirst = 1; aIsFirst >= 0; aIsFirst--) {
+				if ((1 == runLength) && !aIsFirst) {
+					break;
+				}
+				if (!aIsFirst && (p < first + runLength)) {
+					continue;
+				}
+				const size_t runFirst = aIsFirst ? p : p + 1 - runLength;
+				const size_t runLast = runFirst + runLength - 1;
+				if ((runFirst <= first) || (runLast > lastMovable)) {
+					continue;
+				}
+				const uint32_t b = tour.order[aIsFirst ? runLast : runFirst];
+				// What taking the run out saves.
+				float removalGain = tour.edgeAfter(runFirst - 1);
+				if (hasEdgeAfter(runLast)) {
+					removalGain += tour.edgeAfter(runLast)
+								   - tour.distance(tour.order[runFirst - 1], tour.order[runLast + 1]);
+				}
+				const uint32_t *neighbors = &tour.neighbors[a * tour.neighborCount];
+				for (size_t k = 0; k < tour.neighborCount; k++) {
+					const uint32_t c = neighbors[k];
+					if (noNeighbor == c) {
+						break;
+					}
+					const float newEdge = tour.distance(a, c);
+					if (newEdge >= removalGain) {
+						break;
+					}
+					if (!contains(c)) {
+						continue;
+					}
+					const size_t q = tour.positions[c];
+					if ((q >= runFirst) && (q <= runLast)) {
+						continue;
+					}
+					// Put it in the gap after c, with a next to c, or in the gap
+					// before c.
+					for (int cIsBefore = 1; cIsBefore >= 0; cIsBefore--) {
+						if (!cIsBefore && (q == first)) {
+							continue;
+						}
+						const size_t gap = cIsBefore ? q : q - 1;
+						// The gap has to stay put when the run is taken out, and
+						// be this stretch's to change.
+						if ((gap + 1 == runFirst) || (gap == runLast)
+							|| ((gap + 1 > last) && hasEdgeAfter(gap))) {
+							continue;
+						}
+						const size_t span = (gap < runFirst) ? runLast - gap : gap - runFirst + 1;
+						if (span > TourOptimizer::maximumMoveLength) {
+							continue;
+						}
+						float insertionCost = newEdge;
+						if (cIsBefore) {
+							if (hasEdgeAfter(gap)) {
+								insertionCost += tour.distance(b, tour.order[gap + 1])
+												 - tour.edgeAfter(gap);
+							}
+						} else {
+							insertionCost += tour.distance(tour.order[gap], b) - tour.edgeAfter(gap);
+						}
+						const float gain = removalGain - insertionCost;
+						if (gain > bestGain) {
+							bestGain = gain;
+							bestRunFirst = runFirst;
+							bestRunLast = runLast;
+							bestGap = gap;
+							// The run goes in forward if a ends up on the same end.
+							bestIsReversed = (aIsFirst != cIsBefore);
+						}
+					}
+				}
+			}
+		}
+		if (0 == bestRunLast) {
+			return 0.0f;
+		}
+
+		// Remember who's on the edges that change before moving anything.
+		const size_t runLength = bestRunLast - bestRunFirst + 1;
+		uint32_t touched[6] = {
+			tour.order[bestRunFirst - 1], tour.order[bestRunFirst],
+			tour.order[bestRunLast], tour.order[bestGap], noNeighbor, noNeighbor,
+		};
+		if (hasEdgeAfter(bestRunLast)) {
+			touched[4] = tour.order[bestRunLast + 1];
+		}
+		if (hasEdgeAfter(bestGap)) {
+			touched[5] = tour.order[bestGap + 1];
+		}
+		auto order = tour.order.begin();
+		size_t runStart, spanFirst, spanLast;
+		if (bestGap < bestRunFirst) {
+			std::rotate(order + bestGap + 1, order + bestRunFirst, order + bestRunLast + 1);
+			runStart = bestGap + 1;
+			spanFirst = bestGap + 1;
+			spanLast = bestRunLast;
+		} else {
+			std::rotate(order + bestRunFirst, order + bestRunLast + 1, order + bestGap + 1);
+			runStart = bestGap + 1 - runLength;
+			spanFirst = bestRunFirst;
+			spanLast = bestGap;
+		}
+		if (bestIsReversed) {
+			std::reverse(order + runStart, order + runStart + runLength);
+		}
+		updatePositions(spanFirst, spanLast);
+		for (uint32_t point : touched) {
+			if (noNeighbor != point) {
+				enqueue(point);
+			}
+		}
+		return bestGain;
+	}
+};
+
+}
+
+namespace etchasketch {
+namespace salesman {
+
+constexpr size_t TourOptimizer::maximumMoveLength;
+
+TourOptimizer::TourOptimizer()
+	: threadPool(nullptr), timeBudget(1.0), neighborCount(8),
+	  initialLength(0.0), finalLength(0.0)
+{
+}
+
+double
+TourOptimizer::pathLength(const vector<KDPoint<2>> &path)
+{
+	double length = 0.0;
+	for (size_t i = 1; i < path.size(); i++) {
+		length += std::sqrt(static_cast<double>(path[i].distanceTo(path[i - 1])));
+	}
+	return length;
+}
+
+void
+TourOptimizer::optimize(vector<KDPoint<2>> &path)
+{
+	const Clock::time_point deadline = Clock::now()
+		+ std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(timeBudget));
+	initialLength = pathLength(path);
+	finalLength = initialLength;
+	const size_t pointCount = path.size();
+	if ((pointCount < 4) || (0 == neighborCount) || (timeBudget <= 0.0)) {
+		return;
+	}
+	const Clock::time_point setupDeadline = Clock::now()
+		+ std::chrono::duration_cast<Clock::duration>(
+			std::chrono::duration<double>(timeBudget * maximumSetupShare));
+
+	Tour tour;
+	tour.xs.resize(pointCount);
+	tour.ys.resize(pointCount);
+	tour.order.resize(pointCount);
+	tour.positions.resize(pointCount);
+	tour.stretches.resize(pointCount);
+	tour.isQueued.assign(pointCount, 0);
+	PointLookup indexForPoint;
+	indexForPoint.reserve(pointCount);
+	for (size_t i = 0; i < pointCount; i++) {
+		tour.xs[i] = static_cast<float>(path[i][0]);
+		tour.ys[i] = static_cast<float>(path[i][1]);
+		tour.order[i] = static_cast<uint32_t>(i);
+		tour.positions[i] = static_cast<uint32_t>(i);
+		indexForPoint.add(path[i], static_cast<uint32_t>(i));
+	}
+	indexForPoint.sort();
+
+	// Find everyone's neighbors, a chunk at a time, until the setup share of
+	// the budget runs out. Points left without neighbors still move when
+	// their neighbors do; they just don't start any moves.
+	const size_t chunkCount = (pointCount + neighborChunkLength - 1) / neighborChunkLength;
+	tour.neighborCount = neighborCount;
+	tour.neighbors.assign(pointCount * neighborCount, noNeighbor);
+	vector<uint8_t> isChunkSkipped(chunkCount, 0);
+	const KDTree<2> tree(path);
+	auto findNeighbors = [&](size_t chunk) {
+		if (Clock::now() >= setupDeadline) {
+			isChunkSkipped[chunk] = 1;
+			return;
+		}
+		vector<KDPoint<2>> nearest;
+		const size_t chunkEnd = std::min(pointCount, (chunk + 1) * neighborChunkLength);
+		for (size_t i = chunk * neighborChunkLength; i < chunkEnd; i++) {
+			tree.findKNearest(path[i], neighborCount + 1, nearest);
+			uint32_t *neighbors = &tour.neighbors[i * neighborCount];
+			size_t found = 0;
+			for (const KDPoint<2> &neighbor : nearest) {
+				const uint32_t index = indexForPoint.find(neighbor);
+				if ((index != i) && (found < neighborCount)) {
+					neighbors[found++] = index;
+				}
+			}
+		}
+	};
+	if (threadPool) {
+		threadPool->parallelFor(chunkCount, findNeighbors);
+	} else {
+		for (size_t chunk = 0; chunk < chunkCount; chunk++) {
+			findNeighbors(chunk);
+		}
+	}
+	size_t skippedPointCount = 0;
+	for (size_t chunk = 0; chunk < chunkCount; chunk++) {
+		if (isChunkSkipped[chunk]) {
+			skippedPointCount += std::min(pointCount, (chunk + 1) * neighborChunkLength)
+								 - chunk * neighborChunkLength;
+		}
+	}
+	if (0 != skippedPointCount) {
+		EASLog("Ran out of time to find neighbors for %zu of %zu points; they won't start any moves",
+			   skippedPointCount, pointCount);
+	}
+
+	// Improve the stretches in parallel, moving the cuts half a stretch each
+	// round, until a round with the cuts in each place finds nothing.
+	const size_t stretchCount = std::max(static_cast<size_t>(1),
+										 std::min(maximumStretchCount,
+												  pointCount / minimumStretchLength));
+	const size_t stretchLength = (pointCount + stretchCount - 1) / stretchCount;
+	size_t idleRounds = 0;
+	bool didSearchWholePath = false;
+	for (size_t round = 0; Clock::now() < deadline; round++) {
+		vector<size_t> cuts(1, 0);
+		for (size_t cut = (round % 2) ? stretchLength / 2 : stretchLength;
+			 cut + 1 < pointCount; cut += stretchLength) {
+			if (cut > cuts.back()) {
+				cuts.push_back(cut);
+			}
+		}
+		cuts.push_back(pointCount - 1);
+		for (size_t stretch = 0; stretch + 1 < cuts.size(); stretch++) {
+			for (size_t i = cuts[stretch]; i < cuts[stretch + 1]; i++) {
+				tour.stretches[tour.order[i]] = static_cast<uint32_t>(stretch);
+			}
+		}
+		tour.stretches[tour.order[pointCount - 1]] = static_cast<uint32_t>(cuts.size() - 2);
+
+		vector<double> gains(cuts.size() - 1, 0.0);
+		auto searchStretch = [&](size_t stretch) {
+			StretchSearch search(tour, static_cast<uint32_t>(stretch),
+								 cuts[stretch], cuts[stretch + 1], deadline);
+			gains[stretch] = search.run();
+		};
+		if (threadPool && (gains.size() > 1)) {
+			threadPool->parallelFor(gains.size(), searchStretch);
+		} else {
+			for (size_t stretch = 0; stretch < gains.size(); stretch++) {
+				searchStretch(stretch);
+			}
+		}
+
+		bool didImprove = false;
+		for (double gain : gains) {
+			didImprove = didImprove || (gain > 0.0);
+		}
+		idleRounds = didImprove ? 0 : idleRounds + 1;
+		didSearchWholePath = (1 == gains.size());
+		if ((idleRounds >= 2) || (didSearchWholePath && (1 == idleRounds))) {
+			break;
+		}
+	}
+
+	// Moves that join points in different stretches are never tried above,
+	// so spend any time left on the whole path at once. That way the pool
+	// never leaves the path longer than searching without one would.
+	if (!didSearchWholePath && (Clock::now() < deadline)) {
+		std::fill(tour.stretches.begin(), tour.stretches.end(), 0);
+		StretchSearch(tour, 0, 0, pointCount - 1, deadline).run();
+	}
+
+	vector<KDPoint<2>> optimized;
+	optimized.reserve(pointCount);
+	for (uint32_t index : tour.order) {
+		optimized.push_back(path[index]);
+	}
+	path.swap(optimized);
+	finalLength = pathLength(path);
+}
+
+}
+}
@@ -0,0 +1,103 @@
+//
+//  TourOptimizer.hpp
+//  EtchASketch
+//
+
+#ifndef TourOptimizer_hpp
+#define TourOptimizer_hpp
+
+#include <stddef.h>
+#include <vector>
+#include "KDPoint.hpp"
+#include "ThreadPool.hpp"
+
+namespace etchasketch {
+namespace salesman {
+
+/**
+ * Shortens a drawing order that a salesman already came up with, by local
+ * search.
+ *
+ * Two kinds of moves are tried: 2-opt, which reverses a stretch of the path
+ * to swap two of its edges for shorter ones, and Or-opt, which picks up a
+ * run of 1 to 3 points and drops it, either way around, between two others.
+ * Only moves that make an edge to one of a point's closest few neighbors
+ * are considered, and a point is only looked at again once a move changes
+ * one of its edges, so each pass is close to linear in the number of
+ * points.
+ *
+ * To use every thread, the path is cut into contiguous stretches, and each
+ * thread improves one stretch without touching its ends. The cuts move
+ * between rounds, so nothing stays stuck at a cut for long. Once the
+ * stretches stop improving, whatever time is left goes to searching the
+ * whole path at once, for the moves that join different stretches. The
+ * cuts don't depend on the pool, so the result is the same with or
+ * without one. Moves that would reverse or shift more than
+ * @c maximumMoveLength points are skipped, since those take long and are
+ * rarely worth it.
+ *
+ * The time budget covers the setup as well as the search. Finding each
+ * point's neighbors may take at most half of it; on a path too long for
+ * that, the points left over are only moved by their neighbors' moves, and
+ * a message is logged. Building the index the neighbors come from can't
+ * be cut short, so on a very long path with a tiny budget the call can
+ * still run a little over.
+ *
+ * The first point stays first, but the path may end anywhere.
+ */
+class TourOptimizer {
+  public:
+	TourOptimizer();
+
+	/**
+	 * Use @c pool to search more than one stretch of the path at once. The
+	 * pool must outlive the optimizer's use of it. Pass @c nullptr to stay
+	 * on the calling thread, which is the default.
+	 */
+	inline void setThreadPool(etchasketch::ThreadPool *pool)
+		{ threadPool = pool; }
+
+	/// Return from @c optimize() after this many seconds, setup included. Defaults to 1.
+	inline void setTimeBudget(double seconds)
+		{ timeBudget = seconds; }
+
+	/// How many of each point's closest neighbors to try moves with. Defaults to 8.
+	inline void setNeighborCount(size_t count)
+		{ neighborCount = count; }
+
+	/**
+	 * Reorder @c path to make it shorter, until no more moves help or the
+	 * time budget runs out.
+	 */
+	void optimize(std::vector<etchasketch::KDPoint<2>> &path); // inout
+
+	/// The length of the path that was passed to the last @c optimize().
+	inline double getInitialLength() const
+		{ return initialLength; }
+
+	/// The length of the path the last @c optimize() ended up with.
+	inline double getFinalLength() const
+		{ return finalLength; }
+
+	/// The total length of the straight lines between consecutive points.
+	static double pathLength(const std::vector<etchasketch::KDPoint<2>> &path);
+
+	/// The most points one move may reverse or shift.
+	static constexpr size_t maximumMoveLength = 50000;
+
+  private:
+	etchasketch::ThreadPool *threadPool;
+
+	double timeBudget;
+
+	size_t neighborCount;
+
+	double initialLength;
+
+	double finalLength;
+};
+
+}
+}
+
+#endif /* TourOptimizer_hpp */
@@ -0,0 +1,191 @@
+//
+//  BlurImageFilterTests.mm
+//  EtchASketch
+//
+
+#import <XCTest/XCTest.h>
+#import "BlurImageFilter.hpp"
+#import "ThreadPool.hpp"
+#import <math.h>
+#import <stdlib.h>
+#import <vector>
+
+using std::vector;
+using etchasketch::GrayImage;
+using etchasketch::ThreadPool;
+using etchasketch::edgedetect::BlurImageFilter;
+using etchasketch::edgedetect::BlurMode;
+
+/// The 2-D Gaussian blur, one output pixel at a time, in double precision.
+static GrayImage *
+blurReference(const GrayImage &img, float sigma, uint32_t radius)
+{
+	const size_t kernelSize = 2 * radius + 1;
+	vector<double> kernel(kernelSize);
+	double sum = 0.0;
+	for (size_t i = 0; i < kernelSize; i++) {
+		const double offset = static_cast<double>(i) - radius;
+		kernel[i] = exp(-0.5 * (offset / sigma) * (offset / sigma));
+		sum += kernel[i];
+	}
+	for (double &weight : kernel) {
+		weight /= sum;
+	}
+
+	GrayImage *blurred = new GrayImage(img.getWidth() - 2 * radius,
+									   img.getHeight() - 2 * radius);
+	for (size_t y = 0; y < blurred->getHeight(); y++) {
+		for (size_t x = 0; x < blurred->getWidth(); x++) {
+			double value = 0.0;
+			for (size_t dy = 0; dy < kernelSize; dy++) {
+				for (size_t dx = 0; dx < kernelSize; dx++) {
+					value += kernel[dx] * kernel[dy] * img.pixelAt(x + dx, y + dy);
+				}
+			}
+			blurred->pixelAt(x, y) = static_cast<GrayImage::Pixel>(lround(value));
+		}
+	}
+	return blurred;
+}
+
+/// One box blur, across then down, rounding each average the way a true division would.
+static GrayImage *
+boxBlurReference(const GrayImage &img, uint32_t radius)
+{
+	const uint32_t boxWidth = 2 * radius + 1;
+	GrayImage across(img.getWidth() - 2 * radius, img.getHeight());
+	for (size_t y = 0; y < across.getHeight(); y++) {
+		for (size_t x = 0; x < across.getWidth(); x++) {
+			uint32_t sum = 0;
+			for (size_t dx = 0; dx < boxWidth; dx++) {
+				sum += img.pixelAt(x + dx, y);
+			}
+			across.pixelAt(x, y) = static_cast<GrayImage::Pixel>((sum + radius) / boxWidth);
+		}
+	}
+	GrayImage *blurred = new GrayImage(across.getWidth(), img.getHeight() - 2 * radius);
+	for (size_t y = 0; y < blurred->getHeight(); y++) {
+		for (size_t x = 0; x < blurred->getWidth(); x++) {
+			uint32_t sum = 0;
+			for (size_t dy = 0; dy < boxWidth; dy++) {
+				sum += across.pixelAt(x, y + dy);
+			}
+			blurred->pixelAt(x, y) = static_cast<GrayImage::Pixel>((sum + radius) / boxWidth);
+		}
+	}
+	return blurred;
+}
+
+@interface BlurImageFilterTests : XCTestCase
+
+@end
+
+@implementation BlurImageFilterTests
+
+/// Check that the two images are the same size, and no pixel differs by
+/// more than @c tolerance.
+- (void)assertImage:(const GrayImage &)actual
+		  matches:(const GrayImage &)expected
+	withTolerance:(int)tolerance {
+	XCTAssertEqual(expected.getWidth(), actual.getWidth());
+	XCTAssertEqual(expected.getHeight(), actual.getHeight());
+	for (size_t y = 0; y < expected.getHeight(); y++) {
+		for (size_t x = 0; x < expected.getWidth(); x++) {
+			XCTAssertLessThanOrEqual(abs(actual.pixelAt(x, y) - expected.pixelAt(x, y)), tolerance,
+									 @"(%zu, %zu)", x, y);
+		}
+	}
+}
+
+- (void)testGaussianMatchesReference {
+	// Odd widths, so the vector loops leave a remainder.
+	const size_t widths[] = { 203, 77 };
+	srand(0xB1A5);
+	for (const size_t width : widths) {
+		GrayImage img(width, 41);
+		for (size_t i = 0; i < img.getPixelCount(); i++) {
+			img.getData()[i] = static_cast<GrayImage::Pixel>(rand());
+		}
+		const BlurImageFilter filter(1.5f, 5);
+		GrayImage *expected = blurReference(img, 1.5f, 5);
+		GrayImage *actual = filter.apply(img);
+		[self assertImage:*actual matches:*expected withTolerance:1];
+		delete actual;
+
+		// Split into bands, it has to come out the same.
+		ThreadPool pool(4);
+		BlurImageFilter pooledFilter(1.5f, 5);
+		pooledFilter.setThreadPool(&pool);
+		actual = pooledFilter.apply(img);
+		[self assertImage:*actual matches:*expected withTolerance:1];
+		delete actual;
+		delete expected;
+	}
+}
+
+- (void)testTripleBoxKeepsFlatImagesFlat {
+	GrayImage img(203, 37);
+	memset(img.getData(), 173, img.getPixelCount());
+	const BlurImageFilter filter(3.0f, 0, BlurMode::TripleBox);
+	GrayImage *blurred = filter.apply(img);
+	XCTAssertEqual(img.getWidth() - 2 * filter.getRadius(), blurred->getWidth());
+	XCTAssertEqual(img.getHeight() - 2 * filter.getRadius(), blurred->getHeight());
+	for (size_t i = 0; i < blurred->getPixelCount(); i++) {
+		XCTAssertEqual(173, blurred->getData()[i]);
+	}
+	delete blurred;
+}
+
+- (void)testTripleBoxRoundsWideBoxesExactly {
+	// A sigma whose three boxes are all 61 wide, where a rounded-up
+	// reciprocal alone puts some averages one too high.
+	const BlurImageFilter filter(30.5f, 0, BlurMode::TripleBox);
+	XCTAssertEqual(3u * 30u, filter.getRadius());
+	GrayImage img(263, 211);
+	srand(0xB0C5);
+	for (size_t i = 0; i < img.getPixelCount(); i++) {
+		img.getData()[i] = static_cast<GrayImage::Pixel>(rand());
+	}
+	GrayImage *expected = new GrayImage(img);
+	for (int box = 0; box < 3; box++) {
+		GrayImage *next = boxBlurReference(*expected, 30);
+		delete expected;
+		expected = next;
+	}
+	GrayImage *actual = filter.apply(img);
+	[self assertImage:*actual matches:*expected withTolerance:0];
+	delete actual;
+	delete expected;
+}
+
+- (void)testTripleBoxTracksGaussian {
+	// Smooth shading, which is what the edge detector sees after a blur.
+	GrayImage img(203, 61);
+	for (size_t y = 0; y < img.getHeight(); y++) {
+		for (size_t x = 0; x < img.getWidth(); x++) {
+			img.pixelAt(x, y) = static_cast<GrayImage::Pixel>(128.0 + 60.0 * sin(x * 0.11)
+															   + 60.0 * cos(y * 0.07));
+		}
+	}
+	const float sigma = 3.0f;
+	const BlurImageFilter boxFilter(sigma, 0, BlurMode::TripleBox);
+	const BlurImageFilter gaussianFilter(sigma, BlurImageFilter::radiusForSigma(sigma));
+	GrayImage *box = boxFilter.apply(img);
+	GrayImage *gaussian = gaussianFilter.apply(img);
+
+	// Line up the pixels each came from, since they trim different amounts.
+	const size_t boxInset = boxFilter.getRadius();
+	const size_t gaussianInset = gaussianFilter.getRadius();
+	const size_t inset = std::max(boxInset, gaussianInset);
+	for (size_t y = inset; y + inset < img.getHeight(); y++) {
+		for (size_t x = inset; x + inset < img.getWidth(); x++) {
+			const int boxPixel = box->pixelAt(x - boxInset, y - boxInset);
+			const int gaussianPixel = gaussian->pixelAt(x - gaussianInset, y - gaussianInset);
+			XCTAssertLessThanOrEqual(abs(boxPixel - gaussianPixel), 2, @"(%zu, %zu)", x, y);
+		}
+	}
+	delete box;
+	delete gaussian;
+}
+
+@end
@@ -0,0 +1,116 @@
+//
+//  EdgeMaskTests.mm
+//  EtchASketch
+//
+
+#import <XCTest/XCTest.h>
+#import "EdgeMask.hpp"
+#import "Image.hpp"
+
+using etchasketch::EdgeMask;
+using etchasketch::GrayImage;
+using Word = etchasketch::EdgeMask::Word;
+
+@interface EdgeMaskTests : XCTestCase
+
+@end
+
+@implementation EdgeMaskTests
+
+- (void)testSetAndGetAcrossWordBoundaries {
+	const size_t widths[] = { 1, 63, 64, 65, 130 };
+	for (const size_t width : widths) {
+		EdgeMask mask(width, 3);
+		XCTAssertTrue(mask.isValid());
+		XCTAssertEqual((width + 63) / 64, mask.getWordsPerRow());
+		XCTAssertEqual(static_cast<size_t>(0), mask.getEdgeCount());
+
+		// Both ends of the middle row, and either side of each word boundary.
+		mask.set(0, 1);
+		mask.set(width - 1, 1);
+		for (size_t x = 63; x < width; x += 64) {
+			mask.set(x, 1);
+			if (x + 1 < width) {
+				mask.set(x + 1, 1);
+			}
+		}
+		size_t expectedCount = 0;
+		for (size_t y = 0; y < mask.getHeight(); y++) {
+			for (size_t x = 0; x < width; x++) {
+				const bool expected = (1 == y) && ((0 == x) || (width - 1 == x) ||
+												   (63 == x % 64) || (0 == x % 64));
+				XCTAssertEqual(expected, mask.get(x, y), @"(%zu, %zu) of %zu", x, y, width);
+				expectedCount += expected ? 1 : 0;
+			}
+		}
+		XCTAssertEqual(expectedCount, mask.getEdgeCount());
+
+		// Clearing only touches its own bit.
+		mask.set(width - 1, 1, false);
+		XCTAssertFalse(mask.get(width - 1, 1));
+		XCTAssertTrue(mask.get(0, 1) || (1 == width));
+		XCTAssertEqual(expectedCount - 1, mask.getEdgeCount());
+	}
+}
+
+- (void)testPaddingStaysClear {
+	EdgeMask mask(65, 2);
+	for (size_t y = 0; y < mask.getHeight(); y++) {
+		for (size_t x = 0; x < mask.getWidth(); x++) {
+			mask.set(x, y);
+		}
+	}
+	XCTAssertEqual(static_cast<size_t>(2 * 65), mask.getEdgeCount());
+	for (size_t y = 0; y < mask.getHeight(); y++) {
+		XCTAssertEqual(~static_cast<Word>(0), mask.getRow(y)[0]);
+		// Only the one pixel past the first word, none of the padding.
+		XCTAssertEqual(static_cast<Word>(1), mask.getRow(y)[1]);
+	}
+}
+
+- (void)testCopyIsIndependent {
+	EdgeMask mask(70, 4);
+	mask.set(5, 0);
+	mask.set(69, 3);
+	EdgeMask copy = mask;
+	XCTAssertEqual(mask.getWidth(), copy.getWidth());
+	XCTAssertEqual(mask.getHeight(), copy.getHeight());
+	XCTAssertEqual(mask.getWordsPerRow(), copy.getWordsPerRow());
+	XCTAssertTrue(copy.get(5, 0));
+	XCTAssertTrue(copy.get(69, 3));
+	XCTAssertEqual(static_cast<size_t>(2), copy.getEdgeCount());
+
+	copy.set(6, 0);
+	XCTAssertFalse(mask.get(6, 0));
+	mask = copy;
+	XCTAssertTrue(mask.get(6, 0));
+	XCTAssertEqual(static_cast<size_t>(3), mask.getEdgeCount());
+}
+
+- (void)testEmptyMask {
+	const EdgeMask mask;
+	XCTAssertFalse(mask.isValid());
+	XCTAssertEqual(static_cast<size_t>(0), mask.getWordsPerRow());
+	XCTAssertEqual(static_cast<size_t>(0), mask.getEdgeCount());
+}
+
+- (void)testGrayImageRows {
+	GrayImage img(67, 5);
+	XCTAssertEqual(static_cast<size_t>(67), img.getStride());
+	for (size_t y = 0; y < img.getHeight(); y++) {
+		for (size_t x = 0; x < img.getWidth(); x++) {
+			XCTAssertEqual(0, img.pixelAt(x, y));
+			img.pixelAt(x, y) = static_cast<GrayImage::Pixel>(x + 7 * y);
+		}
+	}
+	XCTAssertEqual(img.getRow(2) + 3, &img.pixelAt(3, 2));
+
+	GrayImage copy = img;
+	img.pixelAt(3, 2) = 0;
+	XCTAssertEqual(static_cast<GrayImage::Pixel>(3 + 7 * 2), copy.pixelAt(3, 2));
+	img = copy;
+	XCTAssertEqual(0, memcmp(img.getData(), copy.getData(), copy.getPixelCount()));
+	XCTAssertNotEqual(img.getData(), copy.getData());
+}
+
+@end
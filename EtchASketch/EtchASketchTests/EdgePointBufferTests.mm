@@ -0,0 +1,51 @@
+//
+//  EdgePointBufferTests.mm
+//  EtchASketch
+//
+
+#import <XCTest/XCTest.h>
+#import "EdgePointBuffer.hpp"
+
+using etchasketch::EdgePointBuffer;
+
+@interface EdgePointBufferTests : XCTestCase
+
+@end
+
+@implementation EdgePointBufferTests
+
+- (void)testInsertKeepsRowMajorOrder {
+	EdgePointBuffer points;
+	points.append(5, 1);
+	points.append(2, 3);
+	points.append(7, 3);
+	XCTAssertTrue(points.insert(0, 0));
+	XCTAssertTrue(points.insert(4, 3));
+	XCTAssertFalse(points.insert(7, 3));
+	XCTAssertEqual(static_cast<size_t>(5), points.size());
+
+	const size_t expectedX[] = { 0, 5, 2, 4, 7 };
+	const size_t expectedY[] = { 0, 1, 3, 3, 3 };
+	for (size_t i = 0; i < points.size(); i++) {
+		XCTAssertEqual(expectedX[i], points.getX(i));
+		XCTAssertEqual(expectedY[i], points.getY(i));
+		XCTAssertTrue(points.contains(expectedX[i], expectedY[i]));
+	}
+	XCTAssertFalse(points.contains(3, 3));
+	XCTAssertFalse(points.contains(5, 2));
+}
+
+- (void)testAppendRejectsOutOfOrderPoints {
+	EdgePointBuffer points;
+	points.append(4, 2);
+	XCTAssertThrows(points.append(4, 2));
+	XCTAssertThrows(points.append(9, 1));
+	XCTAssertThrows(points.append(EdgePointBuffer::maxCoordinate + 1, 3));
+	XCTAssertNoThrow(points.append(0, 3));
+
+	EdgePointBuffer earlier;
+	earlier.append(1, 1);
+	XCTAssertThrows(points.append(earlier));
+}
+
+@end
@@ -0,0 +1,118 @@
+//
+//  GrayscaleConverterTests.mm
+//  EtchASketch
+//
+
+#import <XCTest/XCTest.h>
+#import "GrayscaleConverter.hpp"
+#import "ThreadPool.hpp"
+#import <stdlib.h>
+#import <algorithm>
+#import <vector>
+
+using std::vector;
+using etchasketch::GrayImage;
+using etchasketch::GrayscaleConverter;
+using etchasketch::Image;
+using etchasketch::LuminanceModel;
+using etchasketch::ThreadPool;
+
+/// The fixed-point formula each model is documented to follow.
+static GrayImage::Pixel
+grayReference(LuminanceModel model, Image::Pixel color)
+{
+	const uint32_t red   = (color >> 24) & 0xFF;
+	const uint32_t green = (color >> 16) & 0xFF;
+	const uint32_t blue  = (color >>  8) & 0xFF;
+	switch (model) {
+		case LuminanceModel::Average:
+			return static_cast<GrayImage::Pixel>((red + green + blue) / 3);
+		case LuminanceModel::Rec601:
+			return static_cast<GrayImage::Pixel>((4899 * red + 9617 * green + 1868 * blue
+												  + 8192) >> 14);
+		case LuminanceModel::Rec709:
+			return static_cast<GrayImage::Pixel>((3483 * red + 11718 * green + 1183 * blue
+												  + 8192) >> 14);
+	}
+	return 0;
+}
+
+@interface GrayscaleConverterTests : XCTestCase
+
+@end
+
+@implementation GrayscaleConverterTests
+
+- (void)testConvertRowMatchesFormula {
+	const LuminanceModel models[] = {
+		LuminanceModel::Average, LuminanceModel::Rec601, LuminanceModel::Rec709,
+	};
+	// Odd lengths leave a remainder after every vector loop, and the
+	// offsets keep the rows off any vector alignment.
+	const size_t counts[] = { 1, 7, 15, 33, 203 };
+	const size_t maxOffset = 3;
+	vector<Image::Pixel> src(203 + maxOffset);
+	srand(0x6A7);
+	for (Image::Pixel &color : src) {
+		color = (static_cast<Image::Pixel>(rand()) << 16) ^ static_cast<Image::Pixel>(rand());
+	}
+	// Make sure the extremes are in there.
+	src[0] = 0xFFFFFFFF;
+	src[1] = 0x000000FF;
+
+	for (const LuminanceModel model : models) {
+		const GrayscaleConverter converter(model);
+		for (const size_t count : counts) {
+			for (size_t offset = 0; offset <= maxOffset; offset++) {
+				vector<GrayImage::Pixel> dst(count + maxOffset + 1, 0xA5);
+				converter.convertRow(src.data() + offset, dst.data() + offset, count);
+				for (size_t i = 0; i < count; i++) {
+					XCTAssertEqual(grayReference(model, src[offset + i]), dst[offset + i],
+								   @"%s, %zu pixels at +%zu, pixel %zu",
+								   converter.getKernelName(), count, offset, i);
+				}
+				// Nothing past the end is touched.
+				XCTAssertEqual(0xA5, dst[offset + count]);
+			}
+		}
+	}
+}
+
+- (void)testAverageIsTheMean {
+	// Every possible channel sum, with some alpha that has to be ignored.
+	const GrayscaleConverter converter(LuminanceModel::Average);
+	vector<Image::Pixel> src;
+	for (uint32_t sum = 0; sum <= 3 * 255; sum++) {
+		const uint32_t red = std::min(sum, 255u);
+		const uint32_t green = std::min(sum - red, 255u);
+		const uint32_t blue = sum - red - green;
+		src.push_back((red << 24) | (green << 16) | (blue << 8) | (sum & 0xFF));
+	}
+	vector<GrayImage::Pixel> dst(src.size());
+	converter.convertRow(src.data(), dst.data(), src.size());
+	for (uint32_t sum = 0; sum <= 3 * 255; sum++) {
+		XCTAssertEqual(sum / 3, dst[sum]);
+	}
+}
+
+- (void)testConvertMatchesConvertRow {
+	Image img(203, 37);
+	srand(0xC0DE);
+	for (size_t i = 0; i < img.getPixelCount(); i++) {
+		img.getData()[i] = (static_cast<Image::Pixel>(rand()) << 16)
+						   ^ static_cast<Image::Pixel>(rand());
+	}
+	ThreadPool pool(4);
+	GrayscaleConverter converter(LuminanceModel::Rec709);
+	converter.setThreadPool(&pool);
+	GrayImage gray(img.getWidth(), img.getHeight());
+	converter.convert(img, gray);
+	for (size_t y = 0; y < img.getHeight(); y++) {
+		for (size_t x = 0; x < img.getWidth(); x++) {
+			XCTAssertEqual(grayReference(LuminanceModel::Rec709, img.pixelAt(x, y)),
+						   gray.pixelAt(x, y));
+		}
+	}
+}
+
+@end
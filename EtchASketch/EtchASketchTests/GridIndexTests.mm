@@ -0,0 +1,114 @@
+//
+//  GridIndexTests.mm
+//  EtchASketch
+//
+
+#import <XCTest/XCTest.h>
+#import "GridIndex.hpp"
+#import "KDTree.hpp"
+#import <algorithm>
+#import <vector>
+
+using std::vector;
+using etchasketch::GridIndex;
+using etchasketch::KDPoint;
+using etchasketch::KDTree;
+
+@interface GridIndexTests : XCTestCase
+
+@end
+
+@implementation GridIndexTests
+
+- (void)testEmptyIndex {
+	GridIndex grid;
+	KDPoint<2> nn(7, 7);
+	XCTAssertEqual(static_cast<size_t>(0), grid.size());
+	XCTAssertFalse(grid.contains(KDPoint<2>(0, 0)));
+	XCTAssertFalse(grid.remove(KDPoint<2>(0, 0)));
+	XCTAssertFalse(grid.findNearestNeighbor(KDPoint<2>(0, 0), nn));
+	XCTAssert(KDPoint<2>(7, 7) == nn);
+	// Inserting into an empty index builds it.
+	XCTAssertTrue(grid.insert(KDPoint<2>(1, 1)));
+	XCTAssertTrue(grid.findNearestNeighbor(KDPoint<2>(0, 0), nn));
+	XCTAssert(KDPoint<2>(1, 1) == nn);
+}
+
+- (void)testRemoveAndInsert {
+	vector<KDPoint<2>> points;
+	points.push_back(KDPoint<2>(0, 0));
+	points.push_back(KDPoint<2>(1, 1));
+	points.push_back(KDPoint<2>(2, 2));
+	points.push_back(KDPoint<2>(2, 2)); // Duplicates are dropped.
+	GridIndex grid(points, 1);
+	XCTAssertEqual(static_cast<size_t>(3), grid.size());
+	XCTAssertTrue(grid.remove(KDPoint<2>(1, 1)));
+	XCTAssertFalse(grid.remove(KDPoint<2>(1, 1)));
+	XCTAssertFalse(grid.contains(KDPoint<2>(1, 1)));
+	XCTAssertEqual(static_cast<size_t>(2), grid.size());
+	// Bring it back, then add one off the grid.
+	XCTAssertTrue(grid.insert(KDPoint<2>(1, 1)));
+	XCTAssertFalse(grid.insert(KDPoint<2>(1, 1)));
+	XCTAssertTrue(grid.insert(KDPoint<2>(-5, 9)));
+	XCTAssertTrue(grid.contains(KDPoint<2>(-5, 9)));
+	XCTAssertTrue(grid.contains(KDPoint<2>(1, 1)));
+	XCTAssertEqual(static_cast<size_t>(4), grid.size());
+}
+
+- (void)testMatchesKDTree {
+	vector<KDPoint<2>> points;
+	srand(0x8BADF00D);
+	for (size_t i = 0; i < 300; i++) {
+		points.push_back(KDPoint<2>(rand() % 50 - 10, rand() % 50 - 10));
+	}
+	const size_t cellSizes[] = { 0, 1, 4, 64 };
+	for (size_t cellSize : cellSizes) {
+		GridIndex grid(points, cellSize);
+		KDTree<2> kdtree(points);
+		// Mix queries with removals and insertions, on and off the grid.
+		for (int i = 0; i < 5000; i++) {
+			const KDPoint<2> point(rand() % 80 - 20, rand() % 80 - 20);
+			switch (rand() % 4) {
+				case 0:
+					XCTAssertEqual(kdtree.insert(point), grid.insert(point));
+					break;
+				case 1:
+					XCTAssertEqual(kdtree.remove(point), grid.remove(point));
+					break;
+				case 2:
+					XCTAssertEqual(kdtree.contains(point), grid.contains(point));
+					break;
+				default: {
+					KDPoint<2> expected, actual;
+					float expectedDist = -1.0f, actualDist = -1.0f;
+					XCTAssertEqual(kdtree.findNearestNeighbor(point, expected, &expectedDist),
+								   grid.findNearestNeighbor(point, actual, &actualDist));
+					XCTAssert(expected == actual);
+					XCTAssertEqual(expectedDist, actualDist);
+					break;
+				}
+			}
+			XCTAssertEqual(kdtree.size(), grid.size());
+		}
+	}
+}
+
+- (void)testTourPerformance {
+	// Generate random (reproducible) points.
+	vector<KDPoint<2>> points;
+	srand(0x8BADF00D);
+	for (size_t i = 0; i < 500000; i++) {
+		points.push_back(KDPoint<2>(rand() % 4096, rand() % 4096));
+	}
+	// Walk a nearest neighbor tour.
+	[self measureBlock:^{
+		GridIndex grid(points);
+		KDPoint<2> current = points[0];
+		grid.remove(current);
+		while (grid.findNearestNeighbor(current, current)) {
+			grid.remove(current);
+		}
+	}];
+}
+
+@end
@@ -8,6 +8,9 @@
 
 #import <XCTest/XCTest.h>
 #import "KDTree.hpp"
+#import <math.h>
+#import <algorithm>
+#import <set>
 #import <vector>
 
 using std::vector;
@@ -23,8 +26,75 @@ public:
 	{
 		return kdtree->smallerDimVal(first, second, curDim);
 	}
+	
+	const vector<KDPoint<2>> &wrapPoints(KDTree<2> *kdtree)
+	{
+		return kdtree->points;
+	}
 };
 
+/// Outlines of overlapping circles on a 512x512 canvas, one point per pixel,
+/// laid out roughly the way an edge detector's output is.
+static vector<KDPoint<2>>
+sketchEdgePoints()
+{
+	const int size = 512;
+	const size_t circleCount = 400;
+	srand(0x5EED);
+	std::set<KDPoint<2>> outline;
+	for (size_t i = 0; i < circleCount; i++) {
+		const float centerX = rand() % size, centerY = rand() % size;
+		const float radius = 4 + rand() % 60;
+		// Step by about a pixel along the circumference.
+		const size_t steps = static_cast<size_t>(2.0f * M_PI * radius);
+		for (size_t step = 0; step < steps; step++) {
+			const float angle = 2.0f * M_PI * step / steps;
+			const int x = static_cast<int>(lroundf(centerX + radius * cosf(angle)));
+			const int y = static_cast<int>(lroundf(centerY + radius * sinf(angle)));
+			if ((0 <= x) && (x < size) && (0 <= y) && (y < size)) {
+				outline.insert(KDPoint<2>(x, y));
+			}
+		}
+	}
+	return vector<KDPoint<2>>(outline.begin(), outline.end());
+}
+
+/// Whether @c a is closer to @c query than @c b, breaking ties with operator<.
+static bool
+isCloser(const KDPoint<2> &query, const KDPoint<2> &a, const KDPoint<2> &b)
+{
+	const float aDist = query.distanceTo(a), bDist = query.distanceTo(b);
+	return (aDist < bDist) || ((aDist == bDist) && (a < b));
+}
+
+/// Find the k nearest neighbors by checking every point.
+static void
+bruteForceKNearest(const vector<KDPoint<2>> &points, const KDPoint<2> &query,
+				   size_t k, vector<KDPoint<2>> &nearest)
+{
+	nearest = points;
+	k = std::min(k, nearest.size());
+	std::partial_sort(nearest.begin(), nearest.begin() + k, nearest.end(),
+					  [&query](const KDPoint<2> &a, const KDPoint<2> &b) {
+		return isCloser(query, a, b);
+	});
+	nearest.resize(k);
+}
+
+/// Find the points within a radius by checking every point.
+static void
+bruteForceWithinRadius(const vector<KDPoint<2>> &points,
+					   const KDPoint<2> &query, float radius,
+					   vector<KDPoint<2>> &found)
+{
+	found.clear();
+	for (const KDPoint<2> &point : points) {
+		if (query.distanceTo(point) <= radius * radius) {
+			found.push_back(point);
+		}
+	}
+}
+
 @interface KDTreeTests : XCTestCase
 
 @property (nonatomic) etchasketch::KDTree<2> *kdtree;
@@ -72,6 +142,54 @@ public:
 	delete points;
 }
 
+- (void)testFindKNearestSketchPerformance {
+	const vector<KDPoint<2>> points = sketchEdgePoints();
+	XCTAssertFalse(points.empty());
+	const KDTree<2> kdtree(points);
+	__block vector<KDPoint<2>> nearest;
+	[self measureBlock:^{
+		for (const KDPoint<2> &point : points) {
+			kdtree.findKNearest(point, 8, nearest);
+		}
+	}];
+}
+
+- (void)testBruteForceKNearestSketchPerformance {
+	const vector<KDPoint<2>> points = sketchEdgePoints();
+	XCTAssertFalse(points.empty());
+	__block vector<KDPoint<2>> nearest;
+	[self measureBlock:^{
+		// Only a sample; every point would take far too long.
+		for (size_t i = 0; i < points.size(); i += 64) {
+			bruteForceKNearest(points, points[i], 8, nearest);
+		}
+	}];
+}
+
+- (void)testFindWithinRadiusSketchPerformance {
+	const vector<KDPoint<2>> points = sketchEdgePoints();
+	XCTAssertFalse(points.empty());
+	const KDTree<2> kdtree(points);
+	__block vector<KDPoint<2>> found;
+	[self measureBlock:^{
+		for (const KDPoint<2> &point : points) {
+			kdtree.findWithinRadius(point, 4.0f, found);
+		}
+	}];
+}
+
+- (void)testBruteForceWithinRadiusSketchPerformance {
+	const vector<KDPoint<2>> points = sketchEdgePoints();
+	XCTAssertFalse(points.empty());
+	__block vector<KDPoint<2>> found;
+	[self measureBlock:^{
+		// Only a sample; every point would take far too long.
+		for (size_t i = 0; i < points.size(); i += 64) {
+			bruteForceWithinRadius(points, points[i], 4.0f, found);
+		}
+	}];
+}
+
 - (void)testSmallerDimVal {
 	KDPoint<2> neg(-1, -1), both(-1, 1), pos(1, 1);
 	// Test expected results.
@@ -111,45 +229,131 @@ public:
 	points.push_back(pt_2_2);
 	KDTree<2> kdtree(points);
 	cout << kdtree << endl;
-	const KDPoint<2> *nn;
+	KDPoint<2> nn;
+	float squaredDistance = -1.0f;
 	// Test normal find nearest neighbor
 	KDTree<2> kdtree1;
 	kdtree1.insert(pt_1_1);
 	kdtree1.insert(pt_2_2);
-	nn = kdtree1.findNearestNeighbor(pt_0_0);
-	XCTAssert(nullptr != nn);
-	XCTAssert(pt_1_1 == *nn);
+	XCTAssertTrue(kdtree1.findNearestNeighbor(pt_0_0, nn, &squaredDistance));
+	XCTAssert(pt_1_1 == nn);
+	XCTAssertEqual(2.0f, squaredDistance);
 	// Test tie for nearest neighbor.
 	KDTree<2> kdtree2;
 	kdtree2.insert(pt_0_0);
 	kdtree2.insert(pt_2_2);
-	nn = kdtree2.findNearestNeighbor(pt_1_1);
-	XCTAssert(nullptr != nn);
-	XCTAssert(pt_0_0 == *nn);
+	XCTAssertTrue(kdtree2.findNearestNeighbor(pt_1_1, nn));
+	XCTAssert(pt_0_0 == nn);
 	// Test nn of point that's in the tree.
 	KDTree<2> kdtree3;
 	kdtree3.insert(pt_0_0);
 	kdtree3.insert(pt_1_1);
 	kdtree3.insert(pt_2_2);
-	nn = kdtree3.findNearestNeighbor(pt_2_2);
-	XCTAssert(nullptr != nn);
-	XCTAssertEqual(pt_2_2, *nn);
+	XCTAssertTrue(kdtree3.findNearestNeighbor(pt_2_2, nn, &squaredDistance));
+	XCTAssertEqual(pt_2_2, nn);
+	XCTAssertEqual(0.0f, squaredDistance);
 	
 	// Test nn of empty tree.
 	KDTree<2> kdtree4;
-	nn = kdtree4.findNearestNeighbor(pt_0_0);
-	XCTAssert(nullptr == nn);
+	nn = pt_2_2;
+	XCTAssertFalse(kdtree4.findNearestNeighbor(pt_0_0, nn));
+	XCTAssert(pt_2_2 == nn);
 	// Test nn of tree with a single point.
 	KDTree<2> kdtree5;
 	kdtree5.insert(pt_1_1);
 	// Should return the only point in the tree.
-	nn = kdtree5.findNearestNeighbor(pt_2_2);
-	XCTAssert(nullptr != nn);
-	XCTAssertEqual(pt_1_1, *nn);
+	XCTAssertTrue(kdtree5.findNearestNeighbor(pt_2_2, nn));
+	XCTAssertEqual(pt_1_1, nn);
 	// Test finding NN of the only point in the tree.
-	nn = kdtree5.findNearestNeighbor(pt_1_1);
-	XCTAssert(nullptr != nn);
-	XCTAssert(pt_1_1 == *nn);
+	XCTAssertTrue(kdtree5.findNearestNeighbor(pt_1_1, nn));
+	XCTAssert(pt_1_1 == nn);
+}
+
+- (void)testFindKNearestMatchesBruteForce {
+	vector<KDPoint<2>> points;
+	srand(0x8BADF00D);
+	for (size_t i = 0; i < 2000; i++) {
+		points.push_back(KDPoint<2>(rand() % 100, rand() % 100));
+	}
+	std::sort(points.begin(), points.end());
+	points.erase(std::unique(points.begin(), points.end()), points.end());
+	KDTree<2> kdtree(points);
+	// Remove a few so the search has to skip them.
+	for (size_t i = 0; i < points.size(); i += 7) {
+		kdtree.remove(points[i]);
+	}
+	vector<KDPoint<2>> remaining;
+	for (const KDPoint<2> &point : points) {
+		if (kdtree.contains(point)) {
+			remaining.push_back(point);
+		}
+	}
+	
+	vector<KDPoint<2>> nearest, expected;
+	const size_t ks[] = { 0, 1, 8, 50, remaining.size() + 5 };
+	for (int i = 0; i < 20; i++) {
+		const KDPoint<2> query(rand() % 120 - 10, rand() % 120 - 10);
+		for (size_t k : ks) {
+			kdtree.findKNearest(query, k, nearest);
+			bruteForceKNearest(remaining, query, k, expected);
+			XCTAssert(expected == nearest);
+		}
+	}
+	// An empty tree has no neighbors.
+	KDTree<2> empty;
+	empty.findKNearest(KDPoint<2>(0, 0), 4, nearest);
+	XCTAssertTrue(nearest.empty());
+}
+
+- (void)testFindWithinRadiusMatchesBruteForce {
+	vector<KDPoint<2>> points;
+	srand(0x8BADF00D);
+	for (size_t i = 0; i < 2000; i++) {
+		points.push_back(KDPoint<2>(rand() % 100, rand() % 100));
+	}
+	std::sort(points.begin(), points.end());
+	points.erase(std::unique(points.begin(), points.end()), points.end());
+	KDTree<2> kdtree(points);
+	// Add one after construction so the tail gets searched too.
+	const KDPoint<2> extra(200, 200);
+	kdtree.insert(extra);
+	points.push_back(extra);
+	
+	vector<KDPoint<2>> found, expected;
+	const float radii[] = { 0.0f, 1.0f, 5.0f, 12.5f, 500.0f };
+	for (int i = 0; i < 20; i++) {
+		const KDPoint<2> query(rand() % 120 - 10, rand() % 120 - 10);
+		for (float radius : radii) {
+			kdtree.findWithinRadius(query, radius, found);
+			bruteForceWithinRadius(points, query, radius, expected);
+			std::sort(found.begin(), found.end());
+			std::sort(expected.begin(), expected.end());
+			XCTAssert(expected == found);
+		}
+	}
+	// Points exactly on the circle count.
+	kdtree.findWithinRadius(KDPoint<2>(200, 195), 5.0f, found);
+	XCTAssertEqual(static_cast<size_t>(1), found.size());
+}
+
+- (void)testLayout {
+	// (0, -2) < (1, 0) < (3, 4) in x, so (1, 0) is the root in the middle.
+	const vector<KDPoint<2>> &points = self.wrapper.wrapPoints(self.kdtree);
+	XCTAssertEqual(static_cast<size_t>(3), points.size());
+	XCTAssert(KDPoint<2>(0, -2) == points[0]);
+	XCTAssert(KDPoint<2>(1, 0) == points[1]);
+	XCTAssert(KDPoint<2>(3, 4) == points[2]);
+	// Four points split on x at index 1, then the right side on y at index 2.
+	vector<KDPoint<2>> morePoints;
+	morePoints.push_back(KDPoint<2>(4, 0));
+	morePoints.push_back(KDPoint<2>(3, 1));
+	morePoints.push_back(KDPoint<2>(2, 3));
+	morePoints.push_back(KDPoint<2>(1, 2));
+	KDTree<2> kdtree(morePoints);
+	const vector<KDPoint<2>> &layout = self.wrapper.wrapPoints(&kdtree);
+	XCTAssert(KDPoint<2>(2, 3) == layout[1]);
+	XCTAssert(KDPoint<2>(4, 0) == layout[2]);
+	XCTAssert(KDPoint<2>(3, 1) == layout[3]);
 }
 
 - (void)testContains {
@@ -204,4 +408,31 @@ public:
 	XCTAssertFalse(kdtree2.remove(pt_2_2));
 }
 
+- (void)testRemoveMostOfTree {
+	// Build a 10x10 grid, then remove all but its last row.
+	vector<KDPoint<2>> points;
+	for (int y = 0; y < 10; y++) {
+		for (int x = 0; x < 10; x++) {
+			points.push_back(KDPoint<2>(x, y));
+		}
+	}
+	KDTree<2> kdtree(points);
+	for (int y = 0; y < 9; y++) {
+		for (int x = 0; x < 10; x++) {
+			XCTAssertTrue(kdtree.remove(KDPoint<2>(x, y)));
+		}
+	}
+	XCTAssertEqual(static_cast<size_t>(10), kdtree.size());
+	XCTAssertFalse(kdtree.contains(KDPoint<2>(3, 3)));
+	XCTAssertTrue(kdtree.contains(KDPoint<2>(3, 9)));
+	// The removed points mustn't turn up as neighbors.
+	KDPoint<2> nn;
+	XCTAssertTrue(kdtree.findNearestNeighbor(KDPoint<2>(3, 0), nn));
+	XCTAssert(KDPoint<2>(3, 9) == nn);
+	// Bring one back.
+	XCTAssertTrue(kdtree.insert(KDPoint<2>(3, 1)));
+	XCTAssertTrue(kdtree.findNearestNeighbor(KDPoint<2>(3, 0), nn));
+	XCTAssert(KDPoint<2>(3, 1) == nn);
+}
+
 @end
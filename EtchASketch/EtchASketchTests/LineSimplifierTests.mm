@@ -0,0 +1,112 @@
+//
+//  LineSimplifierTests.mm
+//  EtchASketch
+//
+
+#import <XCTest/XCTest.h>
+#import "LineSimplifier.hpp"
+#import <math.h>
+#import <vector>
+
+using std::vector;
+using etchasketch::KDPoint;
+using etchasketch::LineSimplifier;
+
+@interface LineSimplifierTests : XCTestCase
+
+@end
+
+@implementation LineSimplifierTests
+
+- (void)testStraightLineKeepsEndpoints {
+	vector<KDPoint<2>> line;
+	for (int i = 0; i <= 1000; i++) {
+		line.push_back(KDPoint<2>(i, 2 * i));
+	}
+	LineSimplifier().simplifyLine(line);
+	XCTAssertEqual(static_cast<size_t>(2), line.size());
+	XCTAssert(KDPoint<2>(0, 0) == line.front());
+	XCTAssert(KDPoint<2>(1000, 2000) == line.back());
+}
+
+- (void)testCornersStay {
+	// Out along the top, down the side, and back along the bottom.
+	vector<KDPoint<2>> line;
+	for (int x = 0; x < 500; x++) {
+		line.push_back(KDPoint<2>(x, 0));
+	}
+	for (int y = 0; y < 500; y++) {
+		line.push_back(KDPoint<2>(500, y));
+	}
+	for (int x = 500; x >= 0; x--) {
+		line.push_back(KDPoint<2>(x, 500));
+	}
+	LineSimplifier().simplifyLine(line);
+	const vector<KDPoint<2>> expected = {
+		KDPoint<2>(0, 0), KDPoint<2>(500, 0), KDPoint<2>(500, 500), KDPoint<2>(0, 500),
+	};
+	XCTAssert(expected == line);
+}
+
+- (void)testClosedLoopKeepsItsShape {
+	// A loop that comes back to where it started, around a square.
+	vector<KDPoint<2>> line;
+	for (int i = 0; i < 100; i++) {
+		line.push_back(KDPoint<2>(i, 0));
+	}
+	for (int i = 0; i < 100; i++) {
+		line.push_back(KDPoint<2>(100, i));
+	}
+	for (int i = 100; i > 0; i--) {
+		line.push_back(KDPoint<2>(i, 100));
+	}
+	for (int i = 100; i >= 0; i--) {
+		line.push_back(KDPoint<2>(0, i));
+	}
+	LineSimplifier().simplifyLine(line);
+	XCTAssertGreaterThanOrEqual(line.size(), static_cast<size_t>(5));
+	XCTAssert(KDPoint<2>(0, 0) == line.front());
+	XCTAssert(KDPoint<2>(0, 0) == line.back());
+}
+
+- (void)testThreadPoolKeepsTheSamePoints {
+	// A wobbly spiral, long enough to be split between threads.
+	vector<KDPoint<2>> line;
+	for (int i = 0; i < 500000; i++) {
+		const double angle = i * 1e-4;
+		const double radius = 100.0 + (i * 1e-3) + ((i % 7) * 0.5);
+		line.push_back(KDPoint<2>(static_cast<int>(radius * cos(angle)),
+								  static_cast<int>(radius * sin(angle))));
+	}
+	vector<KDPoint<2>> alone = line;
+	LineSimplifier().simplifyLine(alone);
+
+	etchasketch::ThreadPool pool(4);
+	LineSimplifier pooled;
+	pooled.setThreadPool(&pool);
+	pooled.simplifyLine(line);
+	XCTAssert(alone == line);
+}
+
+- (void)testJumpsKeepTheirEnds {
+	// Two pieces in nearly a straight line, with a jump between them. As one
+	// line, it would be simplified down to its ends.
+	vector<KDPoint<2>> line;
+	for (int x = 0; x <= 100; x++) {
+		line.push_back(KDPoint<2>(x, 0));
+	}
+	for (int x = 200; x <= 300; x++) {
+		line.push_back(KDPoint<2>(x, 3));
+	}
+	etchasketch::ThreadPool pool(4);
+	LineSimplifier simplifier;
+	simplifier.setThreadPool(&pool);
+	simplifier.setJumpLength(10.0f);
+	simplifier.simplifyLine(line);
+	const vector<KDPoint<2>> expected = {
+		KDPoint<2>(0, 0), KDPoint<2>(100, 0), KDPoint<2>(200, 3), KDPoint<2>(300, 3),
+	};
+	XCTAssert(expected == line);
+}
+
+@end
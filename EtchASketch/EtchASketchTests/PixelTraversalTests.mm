@@ -0,0 +1,220 @@
+//
+//  PixelTraversalTests.mm
+//  EtchASketch
+//
+
+#import <XCTest/XCTest.h>
+#import "EtchASketch.hpp"
+#import "PixelTraversal.hpp"
+#import "SobelEdgeDetector.hpp"
+#import "BlurImageFilter.hpp"
+#import <vector>
+
+using std::vector;
+using etchasketch::Image;
+using etchasketch::ImageFlow;
+using etchasketch::ThreadPool;
+using etchasketch::edgedetect::BlurImageFilter;
+using etchasketch::edgedetect::BlurMode;
+using etchasketch::edgedetect::RowEdgeDetector;
+using etchasketch::edgedetect::RowFilter;
+using etchasketch::edgedetect::SobelEdgeDetector;
+using namespace etchasketch::traversal;
+
+/// 4K UHD.
+static const size_t imageWidth = 3840;
+static const size_t imageHeight = 2160;
+
+@interface PixelTraversalTests : XCTestCase
+
+@property (nonatomic) Image *image;
+
+@end
+
+@implementation PixelTraversalTests
+
+- (void)setImage:(Image *)image {
+	delete _image;
+	_image = image;
+}
+
+- (void)setUp {
+	[super setUp];
+	// Generate a random (reproducible) 4K image.
+	vector<Image::Pixel> pixels(imageWidth * imageHeight);
+	srand(0x8BADF00D);
+	for (size_t i = 0; i < pixels.size(); i++) {
+		pixels[i] = static_cast<Image::Pixel>(rand()) | 0xFF;
+	}
+	self.image = new Image(imageWidth, imageHeight, pixels.data());
+}
+
+- (void)tearDown {
+	self.image = nullptr;
+	[super tearDown];
+}
+
+- (void)testForEachPixelVisitsRowMajor {
+	size_t expectedX = 0, expectedY = 0, visited = 0;
+	forEachPixel(3, 2, [&](size_t x, size_t y) {
+		XCTAssertEqual(expectedX, x);
+		XCTAssertEqual(expectedY, y);
+		expectedX = (expectedX + 1) % 3;
+		expectedY += (expectedX == 0);
+		visited++;
+	});
+	XCTAssertEqual(static_cast<size_t>(6), visited);
+}
+
+- (void)testForEachTileCoversImage {
+	// Pick a size that isn't a multiple of the tile size.
+	const size_t width = l1TileSize * 2 + 5, height = l1TileSize + 1;
+	vector<int> hits(width * height, 0);
+	forEachPixelTiled(width, height, l1TileSize, [&](size_t x, size_t y) {
+		hits[x + y * width]++;
+	});
+	for (size_t i = 0; i < hits.size(); i++) {
+		XCTAssertEqual(1, hits[i]);
+	}
+}
+
+- (void)testForEachRowBandCoversRowsOnce {
+	ThreadPool pool(4);
+	const size_t firstRow = 3, lastRow = 1000;
+	vector<int> hits(lastRow, 0);
+	forEachRowBand(&pool, firstRow, lastRow, [&](size_t bandFirst, size_t bandLast) {
+		for (size_t y = bandFirst; y < bandLast; y++) {
+			hits[y]++;
+		}
+	});
+	for (size_t y = 0; y < lastRow; y++) {
+		XCTAssertEqual((y < firstRow) ? 0 : 1, hits[y]);
+	}
+}
+
+- (void)testThreadCountDoesNotChangeEdges {
+	ImageFlow *serial = new ImageFlow(*self.image);
+	serial->setThreadCount(1);
+	serial->convertToGrayscale();
+	serial->detectEdges();
+	ImageFlow *parallel = new ImageFlow(*self.image);
+	parallel->setThreadCount(4);
+	parallel->convertToGrayscale();
+	parallel->detectEdges();
+	const etchasketch::EdgeMask &expected = serial->getEdgeDetectedImage();
+	const etchasketch::EdgeMask &actual = parallel->getEdgeDetectedImage();
+	XCTAssertEqual(expected.getWidth(), actual.getWidth());
+	XCTAssertEqual(expected.getHeight(), actual.getHeight());
+	for (size_t y = 0; y < expected.getHeight(); y++) {
+		XCTAssertEqual(0, memcmp(expected.getRow(y), actual.getRow(y),
+								 expected.getWordsPerRow() * sizeof(etchasketch::EdgeMask::Word)));
+	}
+	delete parallel;
+	delete serial;
+}
+
+- (void)testStreamedStagesMatchWholeImages {
+	ImageFlow *flow = new ImageFlow(*self.image);
+	flow->convertToGrayscale();
+	const etchasketch::GrayImage &gray = flow->getGrayscaleImage();
+	const BlurMode modes[] = { BlurMode::Gaussian, BlurMode::TripleBox };
+	for (const BlurMode mode : modes) {
+		BlurImageFilter filter(1.0f, BlurImageFilter::radiusForSigma(1.0f), mode);
+		SobelEdgeDetector detector;
+		etchasketch::GrayImage *blurred = filter.apply(gray);
+		etchasketch::EdgeMask *expected = detector.detectEdges(*blurred);
+
+		RowFilter *rowFilter = filter.newRowFilter(gray.getWidth());
+		RowEdgeDetector *rowDetector = detector.newRowDetector(blurred->getWidth(),
+															   blurred->getHeight());
+		XCTAssertEqual(blurred->getWidth(), rowFilter->getOutputWidth());
+		XCTAssertEqual(expected->getWidth(), rowDetector->getMaskWidth());
+		XCTAssertEqual(expected->getHeight(), rowDetector->getMaskHeight());
+		size_t y = 0;
+		for (size_t inputRow = 0; inputRow < gray.getHeight(); inputRow++) {
+			const etchasketch::GrayImage::Pixel *row = rowFilter->pushRow(gray.getRow(inputRow));
+			const etchasketch::EdgeMask::Word *maskRow = row ? rowDetector->pushRow(row) : nullptr;
+			if (maskRow) {
+				XCTAssertEqual(0, memcmp(expected->getRow(y), maskRow,
+										 expected->getWordsPerRow() * sizeof(etchasketch::EdgeMask::Word)));
+				y++;
+			}
+		}
+		// Sobel never writes the last row of its mask.
+		XCTAssertEqual(expected->getHeight() - 1, y);
+
+		delete rowDetector;
+		delete rowFilter;
+		delete expected;
+		delete blurred;
+	}
+	delete flow;
+}
+
+/// The baseline: x in the outer loop, as the stages used to do it.
+- (void)testColumnMajorTraversalPerformance {
+	const Image *img = self.image;
+	[self measureBlock:^{
+		uint64_t sum = 0;
+		for (size_t x = 0; x < img->getWidth(); x++) {
+			for (size_t y = 0; y < img->getHeight(); y++) {
+				sum += img->pixelAt(x, y) >> 8;
+			}
+		}
+		XCTAssertNotEqual(static_cast<uint64_t>(0), sum);
+	}];
+}
+
+- (void)testRowMajorTraversalPerformance {
+	const Image *img = self.image;
+	[self measureBlock:^{
+		uint64_t sum = 0;
+		forEachPixel(img->getWidth(), img->getHeight(), [&](size_t x, size_t y) {
+			sum += img->pixelAt(x, y) >> 8;
+		});
+		XCTAssertNotEqual(static_cast<uint64_t>(0), sum);
+	}];
+}
+
+- (void)testGrayscale4KPerformance {
+	ImageFlow *flow = new ImageFlow(*self.image);
+	[self measureBlock:^{
+		flow->convertToGrayscale();
+	}];
+	delete flow;
+}
+
+- (void)testSobel4KPerformance {
+	ImageFlow *flow = new ImageFlow(*self.image);
+	flow->convertToGrayscale();
+	const SobelEdgeDetector *detector = new SobelEdgeDetector();
+	[self measureBlock:^{
+		delete detector->detectEdges(flow->getGrayscaleImage());
+	}];
+	delete detector;
+	delete flow;
+}
+
+- (void)testGaussianBlur4KPerformance {
+	ImageFlow *flow = new ImageFlow(*self.image);
+	flow->convertToGrayscale();
+	const BlurImageFilter *filter = new BlurImageFilter();
+	[self measureBlock:^{
+		delete filter->apply(flow->getGrayscaleImage());
+	}];
+	delete filter;
+	delete flow;
+}
+
+- (void)testTripleBoxBlur4KPerformance {
+	ImageFlow *flow = new ImageFlow(*self.image);
+	flow->convertToGrayscale();
+	const BlurImageFilter *filter = new BlurImageFilter(8.0f, 0, BlurMode::TripleBox);
+	[self measureBlock:^{
+		delete filter->apply(flow->getGrayscaleImage());
+	}];
+	delete filter;
+	delete flow;
+}
+
+@end
@@ -0,0 +1,299 @@
+//
+//  SalesmanTests.mm
+//  EtchASketch
+//
+
+#import <XCTest/XCTest.h>
+#import "BitmapSalesman.hpp"
+#import "BobAndWeaveSalesman.hpp"
+#import "ChainSalesman.hpp"
+#import "EdgePointBuffer.hpp"
+#import "HilbertSalesman.hpp"
+#import "NearestNeighborSalesman.hpp"
+#import "SpanningTreeSalesman.hpp"
+#import "ThreadPool.hpp"
+#import "TourOptimizer.hpp"
+#import <algorithm>
+#import <chrono>
+#import <cmath>
+#import <random>
+#import <vector>
+
+using std::vector;
+using etchasketch::EdgePointBuffer;
+using etchasketch::KDPoint;
+using namespace etchasketch::salesman;
+
+@interface SalesmanTests : XCTestCase
+
+@property (nonatomic) EdgePointBuffer *points;
+
+@end
+
+@implementation SalesmanTests
+
+- (void)setPoints:(EdgePointBuffer *)points {
+	delete _points;
+	_points = points;
+}
+
+- (void)setUp {
+	[super setUp];
+	// Scatter some random (reproducible) short strokes, the way edges look.
+	const size_t width = 300, height = 200;
+	vector<bool> isEdge(width * height, false);
+	isEdge[0] = true; // The start point.
+	srand(0x8BADF00D);
+	for (int stroke = 0; stroke < 60; stroke++) {
+		int x = rand() % width, y = rand() % height;
+		for (int step = 0; step < 40; step++) {
+			x += rand() % 3 - 1;
+			y += rand() % 3 - 1;
+			if ((x < 0) || (y < 0) || (x >= width) || (y >= height)) {
+				break;
+			}
+			isEdge[x + y * width] = true;
+		}
+	}
+	EdgePointBuffer *points = new EdgePointBuffer();
+	for (size_t y = 0; y < height; y++) {
+		for (size_t x = 0; x < width; x++) {
+			if (isEdge[x + y * width]) {
+				points->append(x, y);
+			}
+		}
+	}
+	self.points = points;
+}
+
+- (void)tearDown {
+	self.points = nullptr;
+	[super tearDown];
+}
+
+- (void)testNeighborIndexesGiveSameTour {
+	const KDPoint<2> start(0, 0);
+	NearestNeighborSalesman kdTreeSalesman(*self.points, start, NeighborIndex::KDTree);
+	NearestNeighborSalesman gridSalesman(*self.points, start, NeighborIndex::Grid);
+	kdTreeSalesman.orderPoints();
+	gridSalesman.orderPoints();
+	XCTAssertEqual(self.points->size(), kdTreeSalesman.Salesman::getOrderedPoints().size());
+	XCTAssert(kdTreeSalesman.Salesman::getOrderedPoints()
+			  == gridSalesman.Salesman::getOrderedPoints());
+}
+
+- (void)testTiledNearestNeighborStaysClose {
+	const KDPoint<2> start(0, 0);
+	NearestNeighborSalesman whole(*self.points, start);
+	whole.orderPoints();
+	etchasketch::ThreadPool pool(4);
+	NearestNeighborSalesman tiled(*self.points, start);
+	tiled.setThreadPool(&pool);
+	tiled.setPointsPerTile(100);
+	tiled.orderPoints();
+	NearestNeighborSalesman tiledInline(*self.points, start);
+	tiledInline.setPointsPerTile(100);
+	tiledInline.orderPoints();
+	NearestNeighborSalesman tiledKDTree(*self.points, start, NeighborIndex::KDTree);
+	tiledKDTree.setThreadPool(&pool);
+	tiledKDTree.setPointsPerTile(100);
+	tiledKDTree.orderPoints();
+	vector<KDPoint<2>> ordered = tiled.Salesman::getOrderedPoints();
+	XCTAssert(ordered == tiledInline.Salesman::getOrderedPoints());
+	XCTAssert(ordered == tiledKDTree.Salesman::getOrderedPoints());
+	XCTAssert(start == ordered.front());
+	XCTAssertLessThan(TourOptimizer::pathLength(ordered),
+					  1.05 * TourOptimizer::pathLength(whole.Salesman::getOrderedPoints()));
+	vector<KDPoint<2>> points = self.points->copyAsKDPoints();
+	std::sort(points.begin(), points.end());
+	std::sort(ordered.begin(), ordered.end());
+	XCTAssert(points == ordered);
+}
+
+- (void)testBitmapSalesmanMatchesNearestNeighbor {
+	const KDPoint<2> start(0, 0);
+	NearestNeighborSalesman expected(*self.points, start);
+	BitmapSalesman actual(*self.points, start);
+	expected.orderPoints();
+	actual.orderPoints();
+	XCTAssert(expected.Salesman::getOrderedPoints() == actual.getOrderedPoints());
+}
+
+- (void)testChainSalesmanDrawsEveryPointOnce {
+	const KDPoint<2> start(0, 0);
+	ChainSalesman salesman(*self.points, start);
+	salesman.orderPoints();
+	vector<KDPoint<2>> ordered = salesman.getOrderedPoints();
+	XCTAssertEqual(self.points->size(), ordered.size());
+	XCTAssert(start == ordered.front());
+	// Only moving to a new chain jumps more than a pixel.
+	size_t jumps = 0;
+	for (size_t i = 1; i < ordered.size(); i++) {
+		if (ordered[i].distanceTo(ordered[i - 1]) > 2.0f) {
+			jumps++;
+		}
+	}
+	XCTAssertLessThan(jumps, salesman.getChainCount());
+	// With no repeats, and nothing that isn't an edge point, every point
+	// must be there.
+	for (const KDPoint<2> &point : ordered) {
+		XCTAssertTrue(self.points->contains(point[0], point[1]));
+	}
+	std::sort(ordered.begin(), ordered.end());
+	XCTAssert(std::unique(ordered.begin(), ordered.end()) == ordered.end());
+}
+
+- (void)testSpanningTreeSalesmanIsWithinTwiceTheTree {
+	const KDPoint<2> start(0, 0);
+	etchasketch::ThreadPool pool(4);
+	SpanningTreeSalesman salesman(*self.points, start);
+	salesman.setThreadPool(&pool);
+	salesman.orderPoints();
+	vector<KDPoint<2>> ordered = salesman.getOrderedPoints();
+	XCTAssert(start == ordered.front());
+	XCTAssertLessThanOrEqual(TourOptimizer::pathLength(ordered), 2.0 * salesman.getTreeLength());
+
+	// Prim's algorithm, the slow way, for the length of the tree.
+	const vector<KDPoint<2>> points = self.points->copyAsKDPoints();
+	vector<double> distances(points.size(), INFINITY);
+	vector<bool> isInTree(points.size(), false);
+	double treeLength = 0.0;
+	distances[0] = 0.0;
+	for (size_t added = 0; added < points.size(); added++) {
+		size_t closest = points.size();
+		for (size_t i = 0; i < points.size(); i++) {
+			if (!isInTree[i] && ((closest == points.size()) || (distances[i] < distances[closest]))) {
+				closest = i;
+			}
+		}
+		isInTree[closest] = true;
+		treeLength += distances[closest];
+		for (size_t i = 0; i < points.size(); i++) {
+			distances[i] = std::min(distances[i],
+									sqrt(static_cast<double>(points[closest].distanceTo(points[i]))));
+		}
+	}
+	XCTAssertEqualWithAccuracy(treeLength, salesman.getTreeLength(), 1e-6);
+
+	vector<KDPoint<2>> sortedPoints = points;
+	std::sort(sortedPoints.begin(), sortedPoints.end());
+	std::sort(ordered.begin(), ordered.end());
+	XCTAssert(sortedPoints == ordered);
+}
+
+- (void)testHilbertSalesmanFollowsTheCurve {
+	// Through a solid square, the curve only ever takes one step.
+	EdgePointBuffer square;
+	for (size_t y = 0; y < 16; y++) {
+		for (size_t x = 0; x < 16; x++) {
+			square.append(x, y);
+		}
+	}
+	HilbertSalesman squareSalesman(square, KDPoint<2>(0, 0));
+	squareSalesman.orderPoints();
+	const vector<KDPoint<2>> &squareOrder = squareSalesman.getOrderedPoints();
+	XCTAssertEqual(square.size(), squareOrder.size());
+	XCTAssert(KDPoint<2>(0, 0) == squareOrder.front());
+	for (size_t i = 1; i < squareOrder.size(); i++) {
+		XCTAssertEqual(1.0f, squareOrder[i].distanceTo(squareOrder[i - 1]));
+	}
+
+	const KDPoint<2> start(0, 0);
+	HilbertSalesman salesman(*self.points, start);
+	salesman.orderPoints();
+	vector<KDPoint<2>> ordered = salesman.getOrderedPoints();
+	XCTAssert(start == ordered.front());
+	vector<KDPoint<2>> points = self.points->copyAsKDPoints();
+	std::sort(points.begin(), points.end());
+	std::sort(ordered.begin(), ordered.end());
+	XCTAssert(points == ordered);
+}
+
+- (void)testBobAndWeaveMatchesWindowAverages {
+	etchasketch::GrayImage image(203, 37);
+	srand(0xFEEDFACE);
+	for (size_t i = 0; i < image.getWidth() * image.getHeight(); i++) {
+		image.getData()[i] = static_cast<etchasketch::GrayImage::Pixel>(rand());
+	}
+	etchasketch::ThreadPool pool(4);
+	BobAndWeaveSalesman salesman(image);
+	salesman.setThreadPool(&pool);
+	salesman.orderPoints();
+	const vector<KDPoint<2>> &ordered = salesman.getOrderedPoints();
+
+	// Average each window the slow way. Lines are 4 pixels apart, and each
+	// window covers the pixel and the ones above and left of it.
+	const int width = static_cast<int>(image.getWidth());
+	const int height = static_cast<int>(image.getHeight());
+	vector<KDPoint<2>> expected;
+	for (int line = 0; 4 * line < height; line++) {
+		const int y = 4 * line;
+		for (int i = 0; i < width; i++) {
+			const int x = (0 == line % 2) ? i : (width - 1 - i);
+			uint32_t total = 0, count = 0;
+			for (int wy = std::max(y - 1, 0); wy < std::min(y + 1, height); wy++) {
+				for (int wx = std::max(x - 1, 0); wx < std::min(x + 1, width); wx++) {
+					total += image.getData()[wx + wy * width];
+					count++;
+				}
+			}
+			const double average = static_cast<double>(total) / count / 255.0;
+			const int dy = static_cast<int>(sin(x) * average * 4 / 2 * 4.0f);
+			expected.push_back(KDPoint<2>(x, std::min(std::max(y + dy, 0), height - 1)));
+		}
+	}
+	XCTAssert(expected == ordered);
+}
+
+- (void)testTourOptimizerShortensPath {
+	const KDPoint<2> start(0, 0);
+	NearestNeighborSalesman salesman(*self.points, start);
+	salesman.orderPoints();
+	const vector<KDPoint<2>> &greedy = salesman.Salesman::getOrderedPoints();
+	vector<KDPoint<2>> optimized = greedy;
+	etchasketch::ThreadPool pool(4);
+	TourOptimizer optimizer;
+	optimizer.setThreadPool(&pool);
+	optimizer.setTimeBudget(10.0);
+	optimizer.optimize(optimized);
+	XCTAssertEqualWithAccuracy(TourOptimizer::pathLength(greedy), optimizer.getInitialLength(), 1e-6);
+	XCTAssertEqualWithAccuracy(TourOptimizer::pathLength(optimized), optimizer.getFinalLength(), 1e-6);
+	XCTAssertLessThan(optimizer.getFinalLength(), optimizer.getInitialLength());
+	// The pool only makes it faster, not worse.
+	vector<KDPoint<2>> optimizedAlone = greedy;
+	TourOptimizer optimizerAlone;
+	optimizerAlone.setTimeBudget(10.0);
+	optimizerAlone.optimize(optimizedAlone);
+	XCTAssertLessThanOrEqual(optimizer.getFinalLength(), optimizerAlone.getFinalLength());
+	// Same points, same start.
+	XCTAssert(start == optimized.front());
+	vector<KDPoint<2>> sortedGreedy = greedy;
+	std::sort(sortedGreedy.begin(), sortedGreedy.end());
+	std::sort(optimized.begin(), optimized.end());
+	XCTAssert(sortedGreedy == optimized);
+}
+
+- (void)testTourOptimizerKeepsToItsBudget {
+	// Too many points to find every neighbor of in the time, drawn in a
+	// random (reproducible) order so there's plenty to improve.
+	vector<KDPoint<2>> path;
+	for (int y = 0; y < 1000; y += 2) {
+		for (int x = 0; x < 1000; x += 2) {
+			path.push_back(KDPoint<2>(x, y));
+		}
+	}
+	std::shuffle(path.begin() + 1, path.end(), std::mt19937(0x8BADF00D));
+	// Enough that building the k-d tree, which can't be cut short, leaves
+	// time for some neighbors even on a slow machine.
+	const double budget = 1.0;
+	TourOptimizer optimizer;
+	optimizer.setTimeBudget(budget);
+	const auto start = std::chrono::steady_clock::now();
+	optimizer.optimize(path);
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	XCTAssertLessThan(elapsed.count(), budget + 0.25);
+	XCTAssertLessThan(optimizer.getFinalLength(), optimizer.getInitialLength());
+	XCTAssertEqual(static_cast<size_t>(500 * 500), path.size());
+}
+
+@end
@@ -0,0 +1,83 @@
+//
+//  SobelEdgeDetectorTests.mm
+//  EtchASketch
+//
+
+#import <XCTest/XCTest.h>
+#import "EtchASketch.hpp"
+#import "SobelEdgeDetector.hpp"
+
+using etchasketch::EdgeMask;
+using etchasketch::GrayImage;
+using etchasketch::edgedetect::SobelEdgeDetector;
+
+/// The float thresholding the detector originally used, for comparison.
+static bool
+isEdgeReference(const GrayImage &img, size_t x, size_t y)
+{
+	static const float sobelX[3][3] = {
+		{ -1.0f, -2.0f, -1.0f },
+		{  0.0f,  0.0f,  0.0f },
+		{  1.0f,  2.0f,  1.0f }
+	};
+	static const float sobelY[3][3] = {
+		{ 1.0f, 0.0f, -1.0f },
+		{ 2.0f, 0.0f, -2.0f },
+		{ 1.0f, 0.0f, -1.0f }
+	};
+	float sumX = 0.0f, sumY = 0.0f;
+	for (int dy = -1; dy <= 1; dy++) {
+		for (int dx = -1; dx <= 1; dx++) {
+			const float intensity = img.pixelAt(x + dx, y + dy) / 255.0f;
+			sumX += sobelX[dy+1][dx+1] * intensity;
+			sumY += sobelY[dy+1][dx+1] * intensity;
+		}
+	}
+	return (sumX >= 0.6f || sumY >= 0.4f);
+}
+
+@interface SobelEdgeDetectorTests : XCTestCase
+
+@end
+
+@implementation SobelEdgeDetectorTests
+
+- (void)assertMatchesReference:(const GrayImage &)img {
+	const SobelEdgeDetector detector;
+	const EdgeMask *mask = detector.detectEdges(img);
+	XCTAssertEqual(img.getWidth() - 1, mask->getWidth());
+	XCTAssertEqual(img.getHeight() - 1, mask->getHeight());
+	for (size_t y = 0; y < mask->getHeight(); y++) {
+		for (size_t x = 0; x < mask->getWidth(); x++) {
+			// The last row and column are never marked.
+			const bool expected = (x + 2 < img.getWidth()) &&
+								  (y + 2 < img.getHeight()) &&
+								  isEdgeReference(img, x + 1, y + 1);
+			XCTAssertEqual(expected, mask->get(x, y), @"(%zu, %zu)", x, y);
+		}
+	}
+	delete mask;
+}
+
+- (void)testMatchesReferenceOnNoise {
+	// An odd width, so the vector loops leave a remainder.
+	GrayImage img(203, 37);
+	srand(0x5EB0);
+	for (size_t i = 0; i < img.getPixelCount(); i++) {
+		img.getData()[i] = static_cast<GrayImage::Pixel>(rand());
+	}
+	[self assertMatchesReference:img];
+}
+
+- (void)testMatchesReferenceOnThresholdTies {
+	// Multiples of 17 and 51 land gradients exactly on the thresholds.
+	GrayImage img(131, 29);
+	srand(0x71E5);
+	for (size_t i = 0; i < img.getPixelCount(); i++) {
+		img.getData()[i] = static_cast<GrayImage::Pixel>((rand() % 2) * 102 +
+														 (rand() % 3) * 17);
+	}
+	[self assertMatchesReference:img];
+}
+
+@end
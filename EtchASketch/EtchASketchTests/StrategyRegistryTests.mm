@@ -0,0 +1,84 @@
+//
+//  StrategyRegistryTests.mm
+//  EtchASketch
+//
+
+#import <XCTest/XCTest.h>
+#import "EdgeDetector.hpp"
+#import "ImageFlow.hpp"
+#import "Salesman.hpp"
+#import "StrategyRegistry.hpp"
+#import <math.h>
+#import <string>
+
+using std::string;
+using etchasketch::StrategyParameters;
+using etchasketch::StrategyRegistry;
+
+@interface StrategyRegistryTests : XCTestCase
+
+@end
+
+@implementation StrategyRegistryTests
+
+- (void)testParseSpec {
+	string name;
+	StrategyParameters parameters;
+	XCTAssertTrue(etchasketch::parseStrategySpec("hilbert", name, parameters));
+	XCTAssert("hilbert" == name);
+	XCTAssertTrue(parameters.empty());
+
+	XCTAssertTrue(etchasketch::parseStrategySpec("nearest-neighbor:pointsPerTile=4096,kdTree=1",
+												 name, parameters));
+	XCTAssert("nearest-neighbor" == name);
+	XCTAssertEqual(static_cast<size_t>(2), parameters.size());
+	XCTAssertEqual(4096.0, parameters["pointsPerTile"]);
+	XCTAssertEqual(1.0, parameters["kdTree"]);
+
+	XCTAssertFalse(etchasketch::parseStrategySpec("chain:kdTree", name, parameters));
+	XCTAssertFalse(etchasketch::parseStrategySpec("chain:kdTree=yes", name, parameters));
+	XCTAssertFalse(etchasketch::parseStrategySpec("chain:=1", name, parameters));
+	XCTAssertFalse(etchasketch::parseStrategySpec("chain:", name, parameters));
+}
+
+- (void)testResolveParameters {
+	typedef StrategyRegistry<int> Registry;
+	Registry registry;
+	registry.add({ "first", "The first", { { "size", 3.0, 1.0, 10.0, "How big" } }, 1 });
+	registry.add({ "second", "The second", {}, 2 });
+	registry.add({ "first", "The first, again", { { "size", 5.0, 1.0, 10.0, "How big" } }, 3 });
+	XCTAssertEqual(static_cast<size_t>(2), registry.getEntries().size());
+	XCTAssertTrue(nullptr == registry.find("third"));
+	const Registry::Entry *first = registry.find("first");
+	XCTAssertEqual(3, first->factory);
+
+	StrategyParameters resolved;
+	XCTAssertTrue(Registry::resolveParameters(*first, StrategyParameters(), resolved));
+	XCTAssertEqual(5.0, resolved["size"]);
+	XCTAssertTrue(Registry::resolveParameters(*first, { { "size", 7.0 } }, resolved));
+	XCTAssertEqual(7.0, resolved["size"]);
+	XCTAssertTrue(Registry::resolveParameters(*first, { { "size", 10.0 } }, resolved));
+	XCTAssertFalse(Registry::resolveParameters(*first, { { "size", 0.5 } }, resolved));
+	XCTAssertFalse(Registry::resolveParameters(*first, { { "size", 11.0 } }, resolved));
+	XCTAssertFalse(Registry::resolveParameters(*first, { { "size", NAN } }, resolved));
+	XCTAssertFalse(Registry::resolveParameters(*registry.find("second"), { { "size", 7.0 } },
+											   resolved));
+}
+
+- (void)testImageFlowRefusesUnknownStrategies {
+	etchasketch::ImageFlow flow(etchasketch::Image(4, 4));
+	XCTAssertTrue(flow.setEdgeDetector("sobel"));
+	XCTAssertFalse(flow.setEdgeDetector("canny"));
+	XCTAssertTrue(flow.setSalesmanStrategy("tiled-nearest-neighbor", { { "pointsPerTile", 64.0 } }));
+	XCTAssertFalse(flow.setSalesmanStrategy("hilbert", { { "pointsPerTile", 64.0 } }));
+	XCTAssertFalse(flow.setSalesmanStrategy("greedy"));
+	XCTAssertFalse(flow.setSalesmanStrategy("tiled-nearest-neighbor", { { "pointsPerTile", -5.0 } }));
+	XCTAssertFalse(flow.setSalesmanStrategy("tiled-nearest-neighbor", { { "pointsPerTile", 0.0 } }));
+	XCTAssertFalse(flow.setSalesmanStrategy("nearest-neighbor", { { "pointsPerTile", 1e30 } }));
+	XCTAssertFalse(flow.setSalesmanStrategy("nearest-neighbor", { { "kdTree", 2.0 } }));
+	for (const auto &entry : etchasketch::salesman::salesmen().getEntries()) {
+		XCTAssertTrue(flow.setSalesmanStrategy(entry.name));
+	}
+}
+
+@end
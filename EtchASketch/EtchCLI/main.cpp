@@ -19,14 +19,48 @@ using std::cout;
 using std::endl;
 using std::string;
 
+/// Print the strategies in a registry, with their parameters.
+template<typename Factory>
+static void
+printStrategies(const etchasketch::StrategyRegistry<Factory> &registry)
+{
+    for (const auto &entry : registry.getEntries()) {
+        cout << "      " << entry.name << ": " << entry.description << endl;
+        for (const etchasketch::StrategyParameter &parameter : entry.parameters) {
+            cout << "        " << parameter.name << " (" << parameter.minValue << " to "
+                 << parameter.maxValue << ", default " << parameter.defaultValue
+                 << "): " << parameter.description << endl;
+        }
+    }
+}
+
 /// Print usage and exit.
 static void __attribute__((noreturn))
 usage(void)
 {
-    cout << "Usage: etch -i /path/to/input/image.etch -w 800 -h 600" << endl;
+    cout << "Usage: etch -i /path/to/input/image.etch -w 800 -h 600" << endl
+         << "            [-e detector] [-s salesman] [-b blur] [-t seconds]" << endl
+         << "  -e  How to detect edges. Defaults to sobel." << endl;
+    printStrategies(etchasketch::edgedetect::edgeDetectors());
+    cout << "  -s  How to order the points. Defaults to nearest-neighbor." << endl;
+    printStrategies(etchasketch::salesman::salesmen());
+    cout << "      Give parameters after the name, like "
+            "tiled-nearest-neighbor:pointsPerTile=4096,kdTree=1" << endl
+         << "  -b  The sigma of the blur before edge detection, or 0 for none. Defaults to 1." << endl
+         << "  -t  Seconds to spend shortening the path. Defaults to 0." << endl;
     exit(1);
 }
 
+/// Parse a strategy spec given for @c option, or print usage and exit.
+static void
+parseStrategyArg(char option, string &name, etchasketch::StrategyParameters &parameters)
+{
+    if (!etchasketch::parseStrategySpec(optarg, name, parameters)) {
+        cout << "Bad parameters for -" << option << ": " << optarg << endl;
+        usage();
+    }
+}
+
 static void
 validateArgs(const string &inFile, long imgWidth, long imgHeight)
 {
@@ -54,8 +88,12 @@ main(int argc, char * const argv[])
     // Parse arguments.
     string inFile;
     long imgWidth = -1, imgHeight = -1;
+    string detectorName = "sobel", salesmanName = "nearest-neighbor";
+    etchasketch::StrategyParameters detectorParameters, salesmanParameters;
+    float blurSigma = -1.0f; // Negative leaves the default.
+    double tourSeconds = 0.0;
     int ch;
-    while ((ch = getopt(argc, argv, "i:w:h:")) != -1) {
+    while ((ch = getopt(argc, argv, "i:w:h:e:s:b:t:")) != -1) {
         switch (ch) {
         case 'i':
             inFile = string(optarg);
@@ -66,6 +104,18 @@ main(int argc, char * const argv[])
         case 'h':
             imgHeight = strtol(optarg, nullptr, 0);
             break;
+        case 'e':
+            parseStrategyArg(ch, detectorName, detectorParameters);
+            break;
+        case 's':
+            parseStrategyArg(ch, salesmanName, salesmanParameters);
+            break;
+        case 'b':
+            blurSigma = strtof(optarg, nullptr);
+            break;
+        case 't':
+            tourSeconds = strtod(optarg, nullptr);
+            break;
         case '?':
         default:
             usage();
@@ -98,6 +148,18 @@ main(int argc, char * const argv[])
 
     // Create an ImageFlow.
     etchasketch::ImageFlow inputImgFlow = etchasketch::ImageFlow(inputImg);
+    if (!inputImgFlow.setEdgeDetector(detectorName, detectorParameters)) {
+        cout << "Unknown edge detector, or a bad parameter for it: " << detectorName << endl;
+        usage();
+    }
+    if (!inputImgFlow.setSalesmanStrategy(salesmanName, salesmanParameters)) {
+        cout << "Unknown salesman, or a bad parameter for it: " << salesmanName << endl;
+        usage();
+    }
+    if (blurSigma >= 0.0f) {
+        inputImgFlow.setBlur(blurSigma);
+    }
+    inputImgFlow.setTourOptimizationTime(tourSeconds);
 	inputImgFlow.setOutputSize(motor_max_loc[0], motor_max_loc[1]);
     inputImgFlow.performAllComputationSteps();
     std::vector<etchasketch::KDPoint<2>> points = inputImgFlow.getFinalPoints();
@@ -24,6 +24,12 @@ NS_ASSUME_NONNULL_BEGIN
  */
 - (instancetype)initWithCPPImage:(const etchasketch::Image *)image;
 
+/**
+ * @Note: Takes ownership of the C++ image instance, which is deleted along
+ * with the EASImage.
+ */
+- (instancetype)initWithOwnedCPPImage:(const etchasketch::Image *)image;
+
 @end
 NS_ASSUME_NONNULL_END
 
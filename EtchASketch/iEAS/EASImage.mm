@@ -94,6 +94,14 @@ NS_ASSUME_NONNULL_END
 	return self;
 }
 
+- (instancetype)initWithOwnedCPPImage:(const etchasketch::Image *)image {
+	self = [self initWithCPPImage:image];
+	if (self) {
+		self.shouldFreeCPPImage = YES;
+	}
+	return self;
+}
+
 - (void)dealloc {
 	if (self.shouldFreeCPPImage) {
 		delete self.image;
@@ -113,10 +121,13 @@ NS_ASSUME_NONNULL_END
 	size_t bytesPerRow = width * bytesPerPixel;
 	CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
 	CGBitmapInfo bitmapInfo = kCGBitmapByteOrder32Host | kCGImageAlphaNoneSkipLast;
-	// Create the data provider.
-	const void *data = (const void *)self.image->getData();
+	// Create the data provider. The pixels are copied, so the CGImage stays
+	// valid after the C++ image goes away.
+	const UInt8 *data = (const UInt8 *)self.image->getData();
 	size_t size = self.image->getPixelCount() * sizeof(etchasketch::Image::Pixel);
-	CGDataProviderRef provider = CGDataProviderCreateWithData(nullptr, data, size, nullptr);
+	CFDataRef pixelData = CFDataCreate(kCFAllocatorDefault, data, (CFIndex)size);
+	CGDataProviderRef provider = CGDataProviderCreateWithCFData(pixelData);
+	CFRelease(pixelData);
 	// Create the image.
 	CGImageRef image = CGImageCreate(width, height, bitsPerComponent, bitsPerPixel, bytesPerRow, colorSpace, bitmapInfo, provider, nullptr, false, kCGRenderingIntentPerceptual);
 	// Free up the used objects.
@@ -239,8 +239,8 @@ NS_ASSUME_NONNULL_END
 - (UIImage *)grayscaleImage {
 	UIImage * __block grayImage = nil;
 	dispatch_sync(self.processingQueue, ^{
-		const etchasketch::Image & grayscaleImage = self.imageFlow->getGrayscaleImage();
-		EASImage *easImage = [[EASImage alloc] initWithCPPImage:&grayscaleImage];
+		const etchasketch::Image *grayscaleImage = self.imageFlow->copyGrayscaleImageAsRGBA();
+		EASImage *easImage = [[EASImage alloc] initWithOwnedCPPImage:grayscaleImage];
 		grayImage = [easImage UIImage];
 	});
 	return grayImage;
@@ -249,8 +249,8 @@ NS_ASSUME_NONNULL_END
 - (UIImage *)detectedEdgesImage {
 	UIImage * __block edgeImage = nil;
 	dispatch_sync(self.processingQueue, ^{
-		const etchasketch::Image & detectedEdgesImage = self.imageFlow->getEdgeDetectedImage();
-		EASImage *easImage = [[EASImage alloc] initWithCPPImage:&detectedEdgesImage];
+		const etchasketch::Image *detectedEdgesImage = self.imageFlow->copyEdgeDetectedImageAsRGBA();
+		EASImage *easImage = [[EASImage alloc] initWithOwnedCPPImage:detectedEdgesImage];
 		edgeImage = [easImage UIImage];
 	});
 	return edgeImage;